@@ -50,7 +50,9 @@ bool Database::createTables() {
             average_pitch REAL,
             chord_progression TEXT,
             date_added INTEGER,
-            date_analyzed INTEGER
+            date_analyzed INTEGER,
+            content_hash INTEGER DEFAULT 0,
+            analysis_level INTEGER DEFAULT 2
         );
 
         CREATE INDEX IF NOT EXISTS idx_key ON midi_files(detected_key);
@@ -60,7 +62,43 @@ bool Database::createTables() {
         CREATE INDEX IF NOT EXISTS idx_path ON midi_files(file_path);
     )";
 
-    return executeSQL(sql);
+    if (!executeSQL(sql) || !migrateTables()) {
+        return false;
+    }
+
+    return executeSQL("CREATE INDEX IF NOT EXISTS idx_content_hash ON midi_files(content_hash)");
+}
+
+bool Database::migrateTables() {
+    // Columns added since the first schema. Rows from before analysis
+    // levels were always analysed in full.
+    static const std::pair<const char*, const char*> addedColumns[] = {
+        {"content_hash", "INTEGER DEFAULT 0"},
+        {"analysis_level", "INTEGER DEFAULT 2"},
+    };
+
+    const char* sql = "SELECT 1 FROM pragma_table_info('midi_files') WHERE name = ?";
+
+    for (const auto& column : addedColumns) {
+        sqlite3_stmt* stmt;
+        int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+
+        if (rc != SQLITE_OK) {
+            lastError = "Failed to prepare statement: " + std::string(sqlite3_errmsg(db));
+            return false;
+        }
+
+        sqlite3_bind_text(stmt, 1, column.first, -1, SQLITE_STATIC);
+        bool hasColumn = sqlite3_step(stmt) == SQLITE_ROW;
+        sqlite3_finalize(stmt);
+
+        if (!hasColumn &&
+            !executeSQL(std::string("ALTER TABLE midi_files ADD COLUMN ") + column.first + " " + column.second)) {
+            return false;
+        }
+    }
+
+    return true;
 }
 
 bool Database::executeSQL(const std::string& sql) {
@@ -82,8 +120,8 @@ bool Database::addFile(const MIDIFileEntry& entry) {
             file_path, file_name, file_size, last_modified,
             detected_key, detected_scale, confidence, tempo, duration,
             total_notes, average_pitch, chord_progression,
-            date_added, date_analyzed
-        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
+            date_added, date_analyzed, content_hash, analysis_level
+        ) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)
     )";
 
     sqlite3_stmt* stmt;
@@ -108,6 +146,8 @@ bool Database::addFile(const MIDIFileEntry& entry) {
     sqlite3_bind_text(stmt, 12, entry.chordProgression.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_int64(stmt, 13, entry.dateAdded);
     sqlite3_bind_int64(stmt, 14, entry.dateAnalyzed);
+    sqlite3_bind_int64(stmt, 15, static_cast<sqlite3_int64>(entry.contentHash));
+    sqlite3_bind_int(stmt, 16, static_cast<int>(entry.analysisLevel));
 
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -126,7 +166,8 @@ bool Database::updateFile(const MIDIFileEntry& entry) {
             file_name = ?, file_size = ?, last_modified = ?,
             detected_key = ?, detected_scale = ?, confidence = ?,
             tempo = ?, duration = ?, total_notes = ?,
-            average_pitch = ?, chord_progression = ?, date_analyzed = ?
+            average_pitch = ?, chord_progression = ?, date_analyzed = ?,
+            content_hash = ?, analysis_level = ?
         WHERE file_path = ?
     )";
 
@@ -150,7 +191,9 @@ bool Database::updateFile(const MIDIFileEntry& entry) {
     sqlite3_bind_double(stmt, 10, entry.averagePitch);
     sqlite3_bind_text(stmt, 11, entry.chordProgression.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_int64(stmt, 12, entry.dateAnalyzed);
-    sqlite3_bind_text(stmt, 13, entry.filePath.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64(stmt, 13, static_cast<sqlite3_int64>(entry.contentHash));
+    sqlite3_bind_int(stmt, 14, static_cast<int>(entry.analysisLevel));
+    sqlite3_bind_text(stmt, 15, entry.filePath.c_str(), -1, SQLITE_TRANSIENT);
 
     rc = sqlite3_step(stmt);
     sqlite3_finalize(stmt);
@@ -277,6 +320,79 @@ std::vector<MIDIFileEntry> Database::getAllFiles() {
     return files;
 }
 
+std::vector<MIDIFileEntry> Database::getUnanalyzedFiles() {
+    const char* sql = "SELECT * FROM midi_files WHERE date_analyzed = 0 ORDER BY file_name";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+
+    std::vector<MIDIFileEntry> files;
+
+    if (rc != SQLITE_OK) {
+        return files;
+    }
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        files.push_back(parseRow(stmt));
+    }
+
+    sqlite3_finalize(stmt);
+
+    return files;
+}
+
+std::vector<MIDIFileEntry> Database::getFilesBelowLevel(AnalysisLevel level) {
+    const char* sql = "SELECT * FROM midi_files WHERE date_analyzed > 0 AND analysis_level < ? ORDER BY file_name";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+
+    std::vector<MIDIFileEntry> files;
+
+    if (rc != SQLITE_OK) {
+        return files;
+    }
+
+    sqlite3_bind_int(stmt, 1, static_cast<int>(level));
+
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        files.push_back(parseRow(stmt));
+    }
+
+    sqlite3_finalize(stmt);
+
+    return files;
+}
+
+bool Database::findByContentHash(uint64_t contentHash, MIDIFileEntry& entry) {
+    // Zero marks rows stored without a hash
+    if (contentHash == 0) {
+        return false;
+    }
+
+    const char* sql = "SELECT * FROM midi_files WHERE content_hash = ? AND date_analyzed > 0 "
+                      "ORDER BY analysis_level DESC LIMIT 1";
+
+    sqlite3_stmt* stmt;
+    int rc = sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr);
+
+    if (rc != SQLITE_OK) {
+        return false;
+    }
+
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(contentHash));
+
+    bool found = false;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        entry = parseRow(stmt);
+        found = true;
+    }
+
+    sqlite3_finalize(stmt);
+
+    return found;
+}
+
 std::vector<MIDIFileEntry> Database::search(const SearchCriteria& criteria) {
     std::string sql = buildSearchQuery(criteria);
 
@@ -290,6 +406,18 @@ std::vector<MIDIFileEntry> Database::search(const SearchCriteria& criteria) {
         return files;
     }
 
+    if (!criteria.chordFilter.empty()) {
+        // Matched literally: LIKE wildcards in the name are escaped
+        std::string chord;
+        for (char c : criteria.chordFilter) {
+            if (c == '\\' || c == '%' || c == '_') {
+                chord += '\\';
+            }
+            chord += c;
+        }
+        sqlite3_bind_text(stmt, 1, chord.c_str(), -1, SQLITE_TRANSIENT);
+    }
+
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         files.push_back(parseRow(stmt));
     }
@@ -322,6 +450,11 @@ std::string Database::buildSearchQuery(const SearchCriteria& criteria) {
         query << " AND file_path LIKE '%" << criteria.pathFilter << "%'";
     }
 
+    if (!criteria.chordFilter.empty()) {
+        // The progression is stored as "C, Am, F, G"; the chord is bound in search()
+        query << " AND ', ' || chord_progression || ', ' LIKE '%, ' || ? || ', %' ESCAPE '\\'";
+    }
+
     query << " ORDER BY file_name";
 
     return query.str();
@@ -434,6 +567,10 @@ MIDIFileEntry Database::parseRow(sqlite3_stmt* stmt) {
 
     entry.dateAdded = sqlite3_column_int64(stmt, 13);
     entry.dateAnalyzed = sqlite3_column_int64(stmt, 14);
+    entry.contentHash = static_cast<uint64_t>(sqlite3_column_int64(stmt, 15));
+    int level = sqlite3_column_int(stmt, 16);
+    entry.analysisLevel = level >= 0 && level <= static_cast<int>(AnalysisLevel::Full)
+                              ? static_cast<AnalysisLevel>(level) : AnalysisLevel::KeyOnly;
 
     return entry;
 }
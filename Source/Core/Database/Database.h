@@ -15,6 +15,7 @@ struct MIDIFileEntry {
     std::string fileName;
     int64_t fileSize;
     int64_t lastModified;
+    uint64_t contentHash;   // 0 if unknown
 
     // Musical properties
     std::string detectedKey;
@@ -27,14 +28,16 @@ struct MIDIFileEntry {
     int totalNotes;
     double averagePitch;
     std::string chordProgression;
+    AnalysisLevel analysisLevel;    // Depth the properties above were computed to
 
     // Timestamps
     int64_t dateAdded;
     int64_t dateAnalyzed;
 
-    MIDIFileEntry() : id(-1), fileSize(0), lastModified(0), confidence(0.0),
+    MIDIFileEntry() : id(-1), fileSize(0), lastModified(0), contentHash(0), confidence(0.0),
                      tempo(120.0), duration(0.0), totalNotes(0),
-                     averagePitch(0.0), dateAdded(0), dateAnalyzed(0) {}
+                     averagePitch(0.0), analysisLevel(AnalysisLevel::KeyOnly),
+                     dateAdded(0), dateAnalyzed(0) {}
 };
 
 // Search/filter criteria
@@ -48,6 +51,8 @@ struct SearchCriteria {
     double minDuration;
     double maxDuration;
     std::string pathFilter;          // Search in specific directory
+    std::string chordFilter;         // Chord name in the progression, e.g. "Am7";
+                                     // only matches files analysed at Full
 
     SearchCriteria() : minConfidence(0.0), maxConfidence(1.0),
                       minTempo(0.0), maxTempo(999.0),
@@ -76,6 +81,13 @@ public:
     MIDIFileEntry getFile(int id);
     MIDIFileEntry getFile(const std::string& filePath);
     std::vector<MIDIFileEntry> getAllFiles();
+    std::vector<MIDIFileEntry> getUnanalyzedFiles();
+
+    // Analysed files whose stored analysis is shallower than level
+    std::vector<MIDIFileEntry> getFilesBelowLevel(AnalysisLevel level);
+
+    // Any analyzed file with identical content (e.g. a copy in another pack)
+    bool findByContentHash(uint64_t contentHash, MIDIFileEntry& entry);
     std::vector<MIDIFileEntry> search(const SearchCriteria& criteria);
 
     // Statistics
@@ -96,6 +108,7 @@ private:
 
     // Internal helpers
     bool createTables();
+    bool migrateTables();
     bool executeSQL(const std::string& sql);
     MIDIFileEntry parseRow(sqlite3_stmt* stmt);
     std::string buildSearchQuery(const SearchCriteria& criteria);
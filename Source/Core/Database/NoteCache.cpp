@@ -0,0 +1,585 @@
+#include "NoteCache.h"
+#include "../MIDIParser/ContentHash.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+
+namespace fs = std::filesystem;
+
+namespace MIDIScaleDetector {
+
+namespace {
+    constexpr uint8_t kMagic[3] = {'M', 'X', 'N'};
+    constexpr uint8_t kVersion = 4;
+    constexpr size_t kTrailerSize = 8;     // Content hash of everything before it
+
+    void putVarint(std::vector<uint8_t>& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    void putSigned(std::vector<uint8_t>& out, int64_t value) {
+        // Zigzag so small negative numbers stay short
+        putVarint(out, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+    }
+
+    void putFixed64(std::vector<uint8_t>& out, uint64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+    }
+
+    void putDouble(std::vector<uint8_t>& out, double value) {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        putFixed64(out, bits);
+    }
+
+    void putString(std::vector<uint8_t>& out, const std::string& value) {
+        putVarint(out, value.size());
+        out.insert(out.end(), value.begin(), value.end());
+    }
+
+    void putScale(std::vector<uint8_t>& out, const Scale& scale) {
+        out.push_back(static_cast<uint8_t>(scale.root));
+        putVarint(out, static_cast<uint64_t>(scale.type));
+        putDouble(out, scale.confidence);
+        putVarint(out, scale.mask);
+    }
+
+    void putChord(std::vector<uint8_t>& out, const Chord& chord) {
+        out.push_back(static_cast<uint8_t>(chord.root));
+        out.push_back(static_cast<uint8_t>(chord.quality));
+        out.push_back(static_cast<uint8_t>(chord.bass));
+        putDouble(out, chord.startTime);
+        putDouble(out, chord.endTime);
+    }
+
+    // Bounds-checked reads; any overrun leaves ok false and returns zeros
+    struct Reader {
+        const uint8_t* position;
+        const uint8_t* end;
+        bool ok;
+
+        uint8_t byte() {
+            if (position >= end) {
+                ok = false;
+                return 0;
+            }
+            return *position++;
+        }
+
+        uint64_t varint() {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                uint8_t next = byte();
+                value |= static_cast<uint64_t>(next & 0x7F) << shift;
+                if ((next & 0x80) == 0) {
+                    return value;
+                }
+            }
+            ok = false;
+            return 0;
+        }
+
+        int64_t signedVarint() {
+            uint64_t value = varint();
+            return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+        }
+
+        uint64_t fixed64() {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; ++i) {
+                value |= static_cast<uint64_t>(byte()) << (8 * i);
+            }
+            return value;
+        }
+
+        double real() {
+            uint64_t bits = fixed64();
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            return value;
+        }
+
+        // Element count, checked against the bytes left so corrupt input
+        // can't trigger a huge allocation
+        size_t count(size_t minimumElementSize) {
+            uint64_t value = varint();
+            if (value > static_cast<uint64_t>(end - position) / minimumElementSize) {
+                ok = false;
+                return 0;
+            }
+            return static_cast<size_t>(value);
+        }
+
+        std::string string() {
+            size_t length = count(1);
+            std::string value(reinterpret_cast<const char*>(position), length);
+            position += length;
+            return value;
+        }
+
+        uint32_t tick(uint32_t& previous) {
+            uint64_t value = previous + varint();
+            if (value > UINT32_MAX) {
+                ok = false;
+                return 0;
+            }
+            previous = static_cast<uint32_t>(value);
+            return previous;
+        }
+
+        Scale scale() {
+            Scale value;
+            value.root = static_cast<NoteName>(byte() % 12);
+            uint64_t type = varint();
+            value.type = type <= static_cast<uint64_t>(ScaleType::Unknown)
+                ? static_cast<ScaleType>(type) : ScaleType::Unknown;
+            value.confidence = real();
+            value.mask = static_cast<PitchClassMask>(varint() & 0x0FFF);
+            return value;
+        }
+
+        Chord chord() {
+            Chord value;
+            value.root = static_cast<NoteName>(byte() % 12);
+            uint8_t quality = byte();
+            value.quality = quality < kChordTemplates.size() ? static_cast<ChordQuality>(quality)
+                                                             : ChordQuality::Major;
+            value.bass = static_cast<NoteName>(byte() % 12);
+            value.startTime = real();
+            value.endTime = real();
+            return value;
+        }
+    };
+}
+
+void NoteCacheEntry::assign(const MIDIFile& midiFile, int64_t modifiedTime, int64_t size) {
+    filePath = midiFile.filePath;
+    lastModified = modifiedTime;
+    fileSize = size;
+    contentHash = midiFile.contentHash;
+    format = midiFile.header.format;
+    trackCount = static_cast<uint16_t>(midiFile.tracks.size());
+    tempo = midiFile.tempo;
+    duration = midiFile.getDuration();
+
+    tempoMap = midiFile.tempoMap;
+    keySignatures = midiFile.keySignatures;
+    timeSignatures = midiFile.timeSignatures;
+
+    if (!midiFile.notes.empty()) {
+        notes = midiFile.notes;
+    } else {
+        notes.build(midiFile.tracks, midiFile.tempoMap);
+    }
+
+    controlEvents.clear();
+    for (const auto& track : midiFile.tracks) {
+        for (const auto& event : track.events) {
+            if (event.type == EventType::ProgramChange || event.type == EventType::ControlChange) {
+                controlEvents.push_back(event);
+            }
+        }
+    }
+    std::stable_sort(controlEvents.begin(), controlEvents.end(),
+                     [](const MIDIEvent& a, const MIDIEvent& b) { return a.tick < b.tick; });
+
+    hasAnalysis = false;
+    analysis = HarmonicAnalysis();
+}
+
+void NoteCacheEntry::restore(MIDIFile& midiFile) const {
+    midiFile.header.format = format;
+    midiFile.header.trackCount = trackCount;
+    midiFile.header.division = tempoMap.division;
+    midiFile.tempoMap = tempoMap;
+    midiFile.keySignatures = keySignatures;
+    midiFile.timeSignatures = timeSignatures;
+    midiFile.notes = notes;
+    midiFile.tempo = tempo;
+    midiFile.filePath = filePath;
+    midiFile.contentHash = contentHash;
+    midiFile.source.reset();
+
+    midiFile.tracks.resize(1);
+    MIDITrack& track = midiFile.tracks.front();
+    track.clear();
+    track.events.assign(controlEvents.begin(), controlEvents.end());
+}
+
+NoteCache::NoteCache() : cacheDirectory(""), lastError("") {}
+
+bool NoteCache::setDirectory(const std::string& directory) {
+    std::error_code error;
+    fs::create_directories(directory, error);
+    if (error || !fs::is_directory(directory, error)) {
+        lastError = "Cannot create note cache directory: " + directory;
+        return false;
+    }
+    cacheDirectory = directory;
+    return true;
+}
+
+std::string NoteCache::getEntryPath(const std::string& filePath) const {
+    // Hashing the path gives a flat directory with fixed-length names
+    uint64_t pathHash = hashContent(reinterpret_cast<const uint8_t*>(filePath.data()), filePath.size());
+    char name[17];
+    for (int i = 0; i < 16; ++i) {
+        name[i] = "0123456789abcdef"[(pathHash >> (60 - 4 * i)) & 0xF];
+    }
+    name[16] = '\0';
+    return (fs::path(cacheDirectory) / (std::string(name) + kExtension)).string();
+}
+
+bool NoteCache::store(const NoteCacheEntry& entry) {
+    if (cacheDirectory.empty()) {
+        lastError = "Note cache directory is not set";
+        return false;
+    }
+
+    encode(entry);
+
+    // Write beside the target and rename so readers never see half a file
+    std::string path = getEntryPath(entry.filePath);
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream stream(temporaryPath, std::ios::binary | std::ios::trunc);
+        stream.write(reinterpret_cast<const char*>(buffer.data()), static_cast<std::streamsize>(buffer.size()));
+        if (!stream) {
+            lastError = "Failed to write note cache entry: " + temporaryPath;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    fs::rename(temporaryPath, path, error);
+    if (error) {
+        fs::remove(temporaryPath, error);
+        lastError = "Failed to write note cache entry: " + path;
+        return false;
+    }
+    return true;
+}
+
+bool NoteCache::load(const std::string& filePath, int64_t lastModified, NoteCacheEntry& entry,
+                     uint64_t contentHash) {
+    if (cacheDirectory.empty()) {
+        lastError = "Note cache directory is not set";
+        return false;
+    }
+
+    std::string path = getEntryPath(filePath);
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (!stream) {
+        lastError = "No note cache entry for " + filePath;
+        return false;
+    }
+
+    std::streamoff size = stream.tellg();
+    if (size <= 0) {
+        lastError = "Corrupt note cache entry: " + path;
+        return false;
+    }
+    buffer.resize(static_cast<size_t>(size));
+    stream.seekg(0);
+    if (!stream.read(reinterpret_cast<char*>(buffer.data()), size)) {
+        lastError = "Failed to read note cache entry: " + path;
+        return false;
+    }
+
+    if (!decode(entry)) {
+        return false;
+    }
+
+    // Different file at the same hash-named slot, or the source has changed
+    if (entry.filePath != filePath || entry.lastModified != lastModified ||
+        (contentHash != 0 && entry.contentHash != contentHash)) {
+        lastError = "Stale note cache entry for " + filePath;
+        return false;
+    }
+    return true;
+}
+
+bool NoteCache::remove(const std::string& filePath) {
+    std::error_code error;
+    return fs::remove(getEntryPath(filePath), error);
+}
+
+void NoteCache::clear() {
+    if (cacheDirectory.empty()) {
+        return;
+    }
+
+    std::error_code error;
+    for (const auto& item : fs::directory_iterator(cacheDirectory, error)) {
+        if (item.path().extension() == kExtension) {
+            std::error_code removeError;
+            fs::remove(item.path(), removeError);
+        }
+    }
+}
+
+void NoteCache::encode(const NoteCacheEntry& entry) {
+    std::vector<uint8_t>& out = buffer;
+    out.assign(std::begin(kMagic), std::end(kMagic));
+    out.push_back(kVersion);
+
+    putString(out, entry.filePath);
+    putSigned(out, entry.lastModified);
+    putSigned(out, entry.fileSize);
+    putFixed64(out, entry.contentHash);
+    putVarint(out, entry.format);
+    putVarint(out, entry.trackCount);
+    putDouble(out, entry.tempo);
+    putDouble(out, entry.duration);
+
+    // Tempo map as stored after finalize(): sorted, unique ticks
+    putVarint(out, entry.tempoMap.division);
+    putVarint(out, entry.tempoMap.changes.size());
+    uint32_t previous = 0;
+    for (const auto& change : entry.tempoMap.changes) {
+        putVarint(out, change.tick - previous);
+        putVarint(out, change.microsecondsPerQuarter);
+        previous = change.tick;
+    }
+
+    putVarint(out, entry.keySignatures.size());
+    previous = 0;
+    for (const auto& signature : entry.keySignatures) {
+        putVarint(out, signature.tick - previous);
+        putSigned(out, signature.sharpsFlats);
+        out.push_back(signature.minor ? 1 : 0);
+        previous = signature.tick;
+    }
+
+    putVarint(out, entry.timeSignatures.size());
+    previous = 0;
+    for (const auto& signature : entry.timeSignatures) {
+        putVarint(out, signature.tick - previous);
+        out.push_back(signature.numerator);
+        out.push_back(signature.denominator);
+        out.push_back(signature.clocksPerClick);
+        out.push_back(signature.thirtySecondsPerQuarter);
+        previous = signature.tick;
+    }
+
+    putVarint(out, entry.controlEvents.size());
+    previous = 0;
+    for (const auto& event : entry.controlEvents) {
+        putVarint(out, event.tick - previous);
+        out.push_back(static_cast<uint8_t>(event.type));
+        out.push_back(event.channel);
+        out.push_back(event.note);
+        out.push_back(event.velocity);
+        previous = event.tick;
+    }
+
+    // Rows are in start order, so starts delta-encode to small values
+    const NoteTable& notes = entry.notes;
+    putVarint(out, notes.size());
+    previous = 0;
+    for (size_t i = 0; i < notes.size(); ++i) {
+        putVarint(out, notes.startTick[i] - previous);
+        putVarint(out, notes.endTick[i] - notes.startTick[i]);
+        out.push_back(notes.pitch[i]);
+        out.push_back(notes.channel[i]);
+        out.push_back(notes.velocity[i]);
+        previous = notes.startTick[i];
+    }
+
+    out.push_back(entry.hasAnalysis ? 1 : 0);
+    if (entry.hasAnalysis) {
+        const HarmonicAnalysis& analysis = entry.analysis;
+        putScale(out, analysis.primaryScale);
+        putVarint(out, analysis.alternativeScales.size());
+        for (const auto& scale : analysis.alternativeScales) {
+            putScale(out, scale);
+        }
+        for (double weight : analysis.noteWeights) {
+            putDouble(out, weight);
+        }
+        putVarint(out, analysis.chordProgression.size());
+        for (const auto& chord : analysis.chordProgression) {
+            putString(out, chord);
+        }
+        putVarint(out, analysis.chords.size());
+        for (const auto& chord : analysis.chords) {
+            putChord(out, chord);
+        }
+        putVarint(out, analysis.keyChanges.size());
+        for (const auto& change : analysis.keyChanges) {
+            putDouble(out, change.first);
+            putScale(out, change.second);
+        }
+        putSigned(out, analysis.totalNotes);
+        putDouble(out, analysis.averagePitch);
+        // Sparse: only the pitches that occur
+        size_t usedPitches = static_cast<size_t>(std::count_if(analysis.noteDistribution.begin(),
+            analysis.noteDistribution.end(), [](uint32_t notesAtPitch) { return notesAtPitch > 0; }));
+        putVarint(out, usedPitches);
+        for (size_t pitch = 0; pitch < analysis.noteDistribution.size(); ++pitch) {
+            if (analysis.noteDistribution[pitch] > 0) {
+                putSigned(out, static_cast<int64_t>(pitch));
+                putSigned(out, analysis.noteDistribution[pitch]);
+            }
+        }
+        out.push_back(analysis.usedDeclaredKey ? 1 : 0);
+        out.push_back(static_cast<uint8_t>(analysis.level));
+    }
+
+    putFixed64(out, hashContent(out.data(), out.size()));
+}
+
+bool NoteCache::decode(NoteCacheEntry& entry) {
+    const size_t size = buffer.size();
+    if (size < sizeof(kMagic) + 1 + kTrailerSize ||
+        std::memcmp(buffer.data(), kMagic, sizeof(kMagic)) != 0 || buffer[sizeof(kMagic)] != kVersion) {
+        lastError = "Not a note cache entry, or an older version";
+        return false;
+    }
+
+    Reader trailer{buffer.data() + size - kTrailerSize, buffer.data() + size, true};
+    if (trailer.fixed64() != hashContent(buffer.data(), size - kTrailerSize)) {
+        lastError = "Corrupt note cache entry";
+        return false;
+    }
+
+    Reader in{buffer.data() + sizeof(kMagic) + 1, buffer.data() + size - kTrailerSize, true};
+
+    entry.filePath = in.string();
+    entry.lastModified = in.signedVarint();
+    entry.fileSize = in.signedVarint();
+    entry.contentHash = in.fixed64();
+    entry.format = static_cast<uint16_t>(in.varint());
+    entry.trackCount = static_cast<uint16_t>(in.varint());
+    entry.tempo = in.real();
+    entry.duration = in.real();
+
+    // Re-finalizing rebuilds the cumulative seconds
+    entry.tempoMap.reset(static_cast<uint16_t>(in.varint()));
+    size_t count = in.count(2);
+    uint32_t previous = 0;
+    for (size_t i = 0; i < count && in.ok; ++i) {
+        uint32_t tick = in.tick(previous);
+        entry.tempoMap.addChange(tick, static_cast<uint32_t>(in.varint()));
+    }
+    entry.tempoMap.finalize();
+
+    entry.keySignatures.resize(in.count(3));
+    previous = 0;
+    for (auto& signature : entry.keySignatures) {
+        signature.tick = in.tick(previous);
+        signature.time = entry.tempoMap.ticksToSeconds(signature.tick);
+        signature.sharpsFlats = static_cast<int8_t>(in.signedVarint());
+        signature.minor = in.byte() != 0;
+    }
+
+    entry.timeSignatures.resize(in.count(5));
+    previous = 0;
+    for (auto& signature : entry.timeSignatures) {
+        signature.tick = in.tick(previous);
+        signature.time = entry.tempoMap.ticksToSeconds(signature.tick);
+        signature.numerator = in.byte();
+        signature.denominator = in.byte();
+        signature.clocksPerClick = in.byte();
+        signature.thirtySecondsPerQuarter = in.byte();
+    }
+
+    entry.controlEvents.resize(in.count(5));
+    previous = 0;
+    size_t segment = 0;
+    for (auto& event : entry.controlEvents) {
+        event.tick = in.tick(previous);
+        event.timestamp = static_cast<float>(entry.tempoMap.ticksToSeconds(event.tick, segment));
+        uint8_t type = in.byte();
+        event.type = type < static_cast<uint8_t>(EventType::Unknown)
+            ? static_cast<EventType>(type) : EventType::Unknown;
+        event.channel = in.byte();
+        event.note = in.byte();
+        event.velocity = in.byte();
+    }
+
+    NoteTable& notes = entry.notes;
+    notes.clear();
+    const size_t noteCount = in.count(5);
+    notes.reserve(noteCount);
+    notes.startTime.resize(noteCount);
+    notes.endTime.resize(noteCount);
+    previous = 0;
+    segment = 0;
+    for (size_t i = 0; i < noteCount && in.ok; ++i) {
+        uint32_t start = in.tick(previous);
+        uint64_t end = start + in.varint();
+        if (end > UINT32_MAX) {
+            in.ok = false;
+            break;
+        }
+        notes.startTick.push_back(start);
+        notes.endTick.push_back(static_cast<uint32_t>(end));
+        notes.pitch.push_back(in.byte());
+        notes.channel.push_back(in.byte());
+        notes.velocity.push_back(in.byte());
+        notes.startTime[i] = entry.tempoMap.ticksToSeconds(start, segment);
+        notes.endTime[i] = entry.tempoMap.ticksToSeconds(static_cast<uint32_t>(end));
+    }
+
+    entry.hasAnalysis = in.byte() != 0;
+    entry.analysis = HarmonicAnalysis();
+    if (entry.hasAnalysis && in.ok) {
+        HarmonicAnalysis& analysis = entry.analysis;
+        analysis.primaryScale = in.scale();
+        analysis.alternativeScales.resize(in.count(11));
+        for (auto& scale : analysis.alternativeScales) {
+            scale = in.scale();
+        }
+        for (double& weight : analysis.noteWeights) {
+            weight = in.real();
+        }
+        analysis.chordProgression.resize(in.count(1));
+        for (auto& chord : analysis.chordProgression) {
+            chord = in.string();
+        }
+        analysis.chords.resize(in.count(19));
+        for (auto& chord : analysis.chords) {
+            chord = in.chord();
+        }
+        analysis.keyChanges.resize(in.count(19));
+        for (auto& change : analysis.keyChanges) {
+            change.first = in.real();
+            change.second = in.scale();
+        }
+        analysis.totalNotes = static_cast<int>(in.signedVarint());
+        analysis.averagePitch = in.real();
+        count = in.count(2);
+        for (size_t i = 0; i < count && in.ok; ++i) {
+            int64_t pitch = in.signedVarint();
+            int64_t notesAtPitch = in.signedVarint();
+            if (pitch < 0 || pitch >= 128 || notesAtPitch < 0 || notesAtPitch > UINT32_MAX) {
+                in.ok = false;
+                break;
+            }
+            analysis.noteDistribution[static_cast<size_t>(pitch)] = static_cast<uint32_t>(notesAtPitch);
+        }
+        analysis.usedDeclaredKey = in.byte() != 0;
+        uint8_t level = in.byte();
+        if (level > static_cast<uint8_t>(AnalysisLevel::Full)) {
+            in.ok = false;
+        }
+        analysis.level = static_cast<AnalysisLevel>(level);
+    }
+
+    if (!in.ok || notes.size() != noteCount || in.position != in.end) {
+        lastError = "Corrupt note cache entry";
+        return false;
+    }
+    return true;
+}
+
+} // namespace MIDIScaleDetector
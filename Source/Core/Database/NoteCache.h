@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "../MIDIParser/MIDIParser.h"
+#include "../ScaleDetector/ScaleDetector.h"
+
+namespace MIDIScaleDetector {
+
+// Everything needed to show and analyze a file again without decoding it
+struct NoteCacheEntry {
+    // Key: the entry is only valid for this path at this modification time
+    std::string filePath;
+    int64_t lastModified;
+    int64_t fileSize;
+    uint64_t contentHash;   // 0 if unknown
+
+    uint16_t format;
+    uint16_t trackCount;
+    double tempo;           // BPM of the first tempo event
+    double duration;        // MIDIFile::getDuration() of the source
+
+    NoteTable notes;
+    TempoMap tempoMap;
+    std::vector<KeySignature> keySignatures;
+    std::vector<TimeSignature> timeSignatures;
+    std::vector<MIDIEvent> controlEvents;   // Program and control changes, tick order
+
+    bool hasAnalysis;
+    HarmonicAnalysis analysis;
+
+    NoteCacheEntry() : lastModified(0), fileSize(0), contentHash(0), format(0), trackCount(0),
+                       tempo(120.0), duration(0.0), hasAnalysis(false) {}
+
+    // Copy the cacheable parts of a parsed file. The note table is built
+    // here if the parser didn't.
+    void assign(const MIDIFile& midiFile, int64_t modifiedTime, int64_t size);
+
+    // Rebuild a MIDIFile that analyzes like the source: notes, tempo map,
+    // signatures and one track of the control events. Its getDuration()
+    // only covers those events; use duration instead.
+    void restore(MIDIFile& midiFile) const;
+};
+
+// Per-file binary sidecar cache (".mxn") so reopening a file is one small
+// read instead of a full decode. Each entry lives in its own file named
+// after a hash of the source path; the path, modification time and content
+// hash stored inside decide whether it still applies.
+//
+// Notes are stored as varint start deltas and durations, which keeps a
+// typical loop to a few bytes per note. Note times are recomputed from the
+// tempo map on load.
+class NoteCache {
+public:
+    static constexpr const char* kExtension = ".mxn";
+
+    NoteCache();
+
+    // Directory for sidecar files, created if missing
+    bool setDirectory(const std::string& directory);
+    const std::string& getDirectory() const { return cacheDirectory; }
+
+    // Write an entry, replacing any previous one for the same path
+    bool store(const NoteCacheEntry& entry);
+
+    // Read the entry for filePath. Fails when there is none, or when it was
+    // written for a different modification time or (if given) content hash.
+    bool load(const std::string& filePath, int64_t lastModified, NoteCacheEntry& entry,
+              uint64_t contentHash = 0);
+
+    bool remove(const std::string& filePath);
+
+    // Delete every sidecar in the directory
+    void clear();
+
+    // Sidecar location for a source path
+    std::string getEntryPath(const std::string& filePath) const;
+
+    std::string getLastError() const { return lastError; }
+
+private:
+    std::string cacheDirectory;
+    std::string lastError;
+    std::vector<uint8_t> buffer;    // Reused for encoding and reading
+
+    void encode(const NoteCacheEntry& entry);
+    bool decode(NoteCacheEntry& entry);
+};
+
+} // namespace MIDIScaleDetector
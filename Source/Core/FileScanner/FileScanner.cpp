@@ -9,19 +9,25 @@ namespace fs = std::filesystem;
 namespace MIDIScaleDetector {
 
 FileScanner::FileScanner(Database& database)
-    : db(database), scanning(false), shouldStop(false) {}
+    : db(database), streamingThreshold(32 * 1024 * 1024), scanLevel(AnalysisLevel::Full),
+      scanning(false), shouldStop(false) {
+    // Analysis runs over the paired note table and needs nothing else
+    parser.setBuildNoteTable(true);
+    parser.setParseOptions(ParseNotesOnly);
+
+    // Files that declare a key the notes agree with skip the template sweep
+    detector.setUseDeclaredKey(true);
+}
 
 FileScanner::~FileScanner() {
     stopScan();
 }
 
 bool FileScanner::startScan(const ScannerConfig& config, ProgressCallback callback) {
-    if (scanning.load()) {
+    if (!beginJob()) {
         return false;
     }
 
-    scanning = true;
-    shouldStop = false;
     lastStats = ScanStats();
 
     auto startTime = std::chrono::high_resolution_clock::now();
@@ -32,7 +38,7 @@ bool FileScanner::startScan(const ScannerConfig& config, ProgressCallback callba
     for (const auto& searchPath : config.searchPaths) {
         if (shouldStop.load()) break;
 
-        scanDirectory(searchPath, config.recursive, allFiles);
+        scanDirectory(searchPath, config.recursive, config.scanArchives, allFiles);
     }
 
     // Filter out excluded paths
@@ -70,7 +76,9 @@ bool FileScanner::startScan(const ScannerConfig& config, ProgressCallback callba
         }
 
         if (needsScan) {
-            if (analyzeAndStore(filePath)) {
+            bool stored = config.deferAnalysis ? probeAndStore(filePath)
+                                               : analyzeAndStore(filePath);
+            if (stored) {
                 if (db.fileExists(filePath)) {
                     lastStats.updatedFiles++;
                 } else {
@@ -93,6 +101,15 @@ bool FileScanner::startScan(const ScannerConfig& config, ProgressCallback callba
     return true;
 }
 
+bool FileScanner::beginJob() {
+    bool idle = false;
+    if (!scanning.compare_exchange_strong(idle, true)) {
+        return false;
+    }
+    shouldStop = false;
+    return true;
+}
+
 void FileScanner::stopScan() {
     shouldStop = true;
 
@@ -122,7 +139,7 @@ bool FileScanner::rescanAll(ProgressCallback callback) {
         }
 
         // Check if file still exists
-        if (!fs::exists(entry.filePath)) {
+        if (!fileExists(entry.filePath)) {
             db.removeFile(entry.filePath);
             continue;
         }
@@ -134,29 +151,124 @@ bool FileScanner::rescanAll(ProgressCallback callback) {
     return true;
 }
 
-void FileScanner::scanDirectory(const std::string& path, bool recursive,
+bool FileScanner::analyzePending(ProgressCallback callback) {
+    if (!beginJob()) {
+        return false;
+    }
+
+    auto pendingFiles = db.getUnanalyzedFiles();
+
+    int processed = 0;
+    int total = pendingFiles.size();
+
+    for (const auto& entry : pendingFiles) {
+        if (shouldStop.load()) break;
+
+        if (callback) {
+            callback(processed++, total, entry.filePath);
+        }
+
+        analyzeAndStore(entry.filePath);
+    }
+
+    scanning = false;
+    return true;
+}
+
+void FileScanner::queueUpgrade(const std::string& filePath, AnalysisLevel level) {
+    std::lock_guard<std::mutex> lock(upgradeMutex);
+    upgradeQueue.emplace_back(filePath, level);
+}
+
+bool FileScanner::upgradeFile(const std::string& filePath, AnalysisLevel level) {
+    level = reachableLevel(filePath, level);
+    MIDIFileEntry existing = db.getFile(filePath);
+    if (existing.id >= 0 && existing.dateAnalyzed > 0 && existing.analysisLevel >= level) {
+        return true;
+    }
+
+    return analyzeAndStore(filePath, level);
+}
+
+bool FileScanner::analyzeUpgrades(AnalysisLevel level, ProgressCallback callback) {
+    if (!beginJob()) {
+        return false;
+    }
+
+    // Files the user is waiting on come first
+    while (!shouldStop.load()) {
+        std::pair<std::string, AnalysisLevel> request;
+        {
+            std::lock_guard<std::mutex> lock(upgradeMutex);
+            if (upgradeQueue.empty()) {
+                break;
+            }
+            request = std::move(upgradeQueue.front());
+            upgradeQueue.pop_front();
+        }
+        upgradeFile(request.first, request.second);
+    }
+
+    // Streamed files already as deep as streaming goes would only be streamed again
+    auto shallowFiles = db.getFilesBelowLevel(level);
+    shallowFiles.erase(std::remove_if(shallowFiles.begin(), shallowFiles.end(),
+                                      [&](const MIDIFileEntry& entry) {
+                                          return entry.analysisLevel >= reachableLevel(entry.filePath, level);
+                                      }),
+                       shallowFiles.end());
+
+    int processed = 0;
+    int total = shallowFiles.size();
+
+    for (const auto& entry : shallowFiles) {
+        if (shouldStop.load()) break;
+
+        if (callback) {
+            callback(processed++, total, entry.filePath);
+        }
+
+        analyzeAndStore(entry.filePath, level);
+    }
+
+    scanning = false;
+    return true;
+}
+
+void FileScanner::scanDirectory(const std::string& path, bool recursive, bool scanArchives,
                                std::vector<std::string>& foundFiles) {
 
+    // A search path may name an archive directly
+    if (scanArchives && fs::is_regular_file(path) && isArchive(path)) {
+        scanArchive(path, foundFiles);
+        return;
+    }
+
     if (!fs::exists(path) || !fs::is_directory(path)) {
         return;
     }
 
+    auto visit = [&](const fs::directory_entry& entry) {
+        if (!entry.is_regular_file()) {
+            return;
+        }
+        std::string filePath = entry.path().string();
+        if (isMIDIFile(filePath)) {
+            foundFiles.push_back(filePath);
+        } else if (scanArchives && isArchive(filePath)) {
+            scanArchive(filePath, foundFiles);
+        }
+    };
+
     try {
         if (recursive) {
             for (const auto& entry : fs::recursive_directory_iterator(path)) {
                 if (shouldStop.load()) break;
-
-                if (entry.is_regular_file() && isMIDIFile(entry.path().string())) {
-                    foundFiles.push_back(entry.path().string());
-                }
+                visit(entry);
             }
         } else {
             for (const auto& entry : fs::directory_iterator(path)) {
                 if (shouldStop.load()) break;
-
-                if (entry.is_regular_file() && isMIDIFile(entry.path().string())) {
-                    foundFiles.push_back(entry.path().string());
-                }
+                visit(entry);
             }
         }
     } catch (const fs::filesystem_error& e) {
@@ -164,6 +276,19 @@ void FileScanner::scanDirectory(const std::string& path, bool recursive,
     }
 }
 
+void FileScanner::scanArchive(const std::string& archivePath, std::vector<std::string>& foundFiles) {
+    // Only the central directory is read here; entries are inflated when analyzed
+    if (!archive.open(archivePath)) {
+        return;
+    }
+
+    for (const auto& entry : archive.getEntries()) {
+        if (isMIDIFile(entry.name)) {
+            foundFiles.push_back(ZipArchive::makePath(archivePath, entry.name));
+        }
+    }
+}
+
 bool FileScanner::isMIDIFile(const std::string& filePath) {
     fs::path path(filePath);
     std::string ext = path.extension().string();
@@ -173,6 +298,24 @@ bool FileScanner::isMIDIFile(const std::string& filePath) {
     return ext == ".mid" || ext == ".midi";
 }
 
+bool FileScanner::isArchive(const std::string& filePath) {
+    fs::path path(filePath);
+    std::string ext = path.extension().string();
+
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+
+    return ext == ".zip";
+}
+
+bool FileScanner::fileExists(const std::string& filePath) {
+    std::string archivePath;
+    std::string entryName;
+    if (ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        return findArchiveEntry(filePath) != nullptr;
+    }
+    return fs::exists(filePath);
+}
+
 bool FileScanner::isExcluded(const std::string& filePath,
                             const std::vector<std::string>& excludePaths) {
 
@@ -186,8 +329,15 @@ bool FileScanner::isExcluded(const std::string& filePath,
 }
 
 int64_t FileScanner::getFileModifiedTime(const std::string& filePath) {
+    // Entries take the archive's time - the whole pack changes together
+    std::string archivePath;
+    std::string entryName;
+    if (!ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        archivePath = filePath;
+    }
+
     try {
-        auto ftime = fs::last_write_time(filePath);
+        auto ftime = fs::last_write_time(archivePath);
         auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
             ftime - fs::file_time_type::clock::now() + std::chrono::system_clock::now()
         );
@@ -198,6 +348,13 @@ int64_t FileScanner::getFileModifiedTime(const std::string& filePath) {
 }
 
 int64_t FileScanner::getFileSize(const std::string& filePath) {
+    std::string archivePath;
+    std::string entryName;
+    if (ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        const ZipEntry* entry = findArchiveEntry(filePath);
+        return entry != nullptr ? entry->uncompressedSize : 0;
+    }
+
     try {
         return fs::file_size(filePath);
     } catch (...) {
@@ -205,21 +362,116 @@ int64_t FileScanner::getFileSize(const std::string& filePath) {
     }
 }
 
+const ZipEntry* FileScanner::findArchiveEntry(const std::string& filePath) {
+    std::string archivePath;
+    std::string entryName;
+    if (!ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        return nullptr;
+    }
+
+    // Scan order keeps an archive's entries together, so one open serves them all
+    if (archive.getPath() != archivePath && !archive.open(archivePath)) {
+        return nullptr;
+    }
+    return archive.findEntry(entryName);
+}
+
+std::shared_ptr<const MappedFile> FileScanner::openArchiveEntry(const std::string& filePath) {
+    // Inflated straight into the buffer the parser decodes from
+    std::vector<uint8_t> buffer;
+    const ZipEntry* entry = findArchiveEntry(filePath);
+    if (entry == nullptr || !archive.extract(*entry, buffer)) {
+        return nullptr;
+    }
+    return MappedFile::fromBuffer(std::move(buffer));
+}
+
+bool FileScanner::isStreamed(const std::string& filePath) {
+    std::string archivePath;
+    std::string entryName;
+    return !ZipArchive::splitPath(filePath, archivePath, entryName) &&
+           getFileSize(filePath) >= streamingThreshold;
+}
+
+AnalysisLevel FileScanner::reachableLevel(const std::string& filePath, AnalysisLevel level) {
+    // Chords and key changes need the whole note list, which streaming never builds
+    if (level > AnalysisLevel::KeyAndAlternatives && isStreamed(filePath)) {
+        return AnalysisLevel::KeyAndAlternatives;
+    }
+    return level;
+}
+
 bool FileScanner::analyzeAndStore(const std::string& filePath) {
-    // Parse MIDI file
-    MIDIFile midiFile;
-    if (!parser.parse(filePath, midiFile)) {
+    return analyzeAndStore(filePath, scanLevel);
+}
+
+bool FileScanner::analyzeAndStore(const std::string& filePath, AnalysisLevel level) {
+    detector.setAnalysisLevel(level);
+
+    // Huge files would need gigabytes as events - fold them into histograms
+    if (isStreamed(filePath)) {
+        return streamAndStore(filePath);
+    }
+
+    std::string archivePath;
+    std::string entryName;
+    bool inArchive = ZipArchive::splitPath(filePath, archivePath, entryName);
+
+    // Parse MIDI file into the recycled scratch file
+    bool parsed = inArchive ? parser.parse(openArchiveEntry(filePath), scratchFile)
+                            : parser.parse(filePath, scratchFile);
+    if (!parsed) {
+        return false;
+    }
+
+    MIDIFileEntry entry;
+    MIDIFileEntry duplicate;
+
+    if (db.findByContentHash(scratchFile.contentHash, duplicate) && duplicate.analysisLevel >= level) {
+        // Same bytes already analyzed under another name - reuse the result
+        entry = createEntry(filePath, duplicate);
+    } else {
+        // Analyze scale
+        detector.analyze(scratchFile, analysisContext, scratchAnalysis);
+
+        // Create database entry
+        entry = createEntry(filePath, scratchFile, scratchAnalysis);
+    }
+
+    // Release the mapping; the vectors keep their capacity for the next file
+    scratchFile.releaseSource();
+
+    return storeEntry(entry);
+}
+
+bool FileScanner::streamAndStore(const std::string& filePath) {
+    if (!detector.analyzeStream(filePath, streamingParser, scratchAnalysis)) {
         return false;
     }
 
-    // Analyze scale
-    HarmonicAnalysis analysis = detector.analyze(midiFile);
+    return storeEntry(createEntry(filePath, streamingParser, scratchAnalysis));
+}
+
+bool FileScanner::probeAndStore(const std::string& filePath) {
+    // Listing info only - key and chords are filled in by analyzePending()
+    MIDIProbe probe;
+    std::string archivePath;
+    std::string entryName;
+    if (ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        auto source = openArchiveEntry(filePath);
+        if (!source || !parser.probe(source->data(), source->size(), probe)) {
+            return false;
+        }
+    } else if (!parser.probe(filePath, probe)) {
+        return false;
+    }
 
-    // Create database entry
-    MIDIFileEntry entry = createEntry(filePath, midiFile, analysis);
+    return storeEntry(createEntry(filePath, probe));
+}
 
+bool FileScanner::storeEntry(const MIDIFileEntry& entry) {
     // Store or update
-    if (db.fileExists(filePath)) {
+    if (db.fileExists(entry.filePath)) {
         return db.updateFile(entry);
     } else {
         return db.addFile(entry);
@@ -244,6 +496,7 @@ MIDIFileEntry FileScanner::createEntry(const std::string& filePath,
     entry.confidence = analysis.primaryScale.confidence;
     entry.tempo = midiFile.tempo;
     entry.duration = midiFile.getDuration();
+    entry.contentHash = midiFile.contentHash;
 
     // Additional metadata
     entry.totalNotes = analysis.totalNotes;
@@ -256,6 +509,7 @@ MIDIFileEntry FileScanner::createEntry(const std::string& filePath,
         oss << analysis.chordProgression[i];
     }
     entry.chordProgression = oss.str();
+    entry.analysisLevel = analysis.level;
 
     // Timestamps
     auto now = std::chrono::system_clock::now();
@@ -265,4 +519,58 @@ MIDIFileEntry FileScanner::createEntry(const std::string& filePath,
     return entry;
 }
 
+MIDIFileEntry FileScanner::createEntry(const std::string& filePath,
+                                      const StreamingParser& stream,
+                                      const HarmonicAnalysis& analysis) {
+    // Same fields as a loaded file, with tempo and length from the stream.
+    // Streamed files are not hashed, so they never share analysis.
+    MIDIFile summary;
+    summary.tempo = stream.getTempo();
+    MIDIFileEntry entry = createEntry(filePath, summary, analysis);
+    entry.duration = stream.getDuration();
+
+    return entry;
+}
+
+MIDIFileEntry FileScanner::createEntry(const std::string& filePath, const MIDIFileEntry& duplicate) {
+    // Musical properties and hash come from the identical file
+    MIDIFileEntry entry = duplicate;
+
+    fs::path path(filePath);
+
+    entry.id = -1;
+    entry.filePath = filePath;
+    entry.fileName = path.filename().string();
+    entry.fileSize = getFileSize(filePath);
+    entry.lastModified = getFileModifiedTime(filePath);
+
+    auto now = std::chrono::system_clock::now();
+    entry.dateAdded = std::chrono::system_clock::to_time_t(now);
+    entry.dateAnalyzed = entry.dateAdded;
+
+    return entry;
+}
+
+MIDIFileEntry FileScanner::createEntry(const std::string& filePath, const MIDIProbe& probe) {
+    MIDIFileEntry entry;
+
+    fs::path path(filePath);
+
+    entry.filePath = filePath;
+    entry.fileName = path.filename().string();
+    entry.fileSize = getFileSize(filePath);
+    entry.lastModified = getFileModifiedTime(filePath);
+
+    entry.tempo = probe.tempo;
+    entry.duration = probe.duration;
+    entry.totalNotes = static_cast<int>(probe.noteCount);
+    entry.contentHash = probe.contentHash;
+
+    // Not analyzed yet (dateAnalyzed stays 0)
+    auto now = std::chrono::system_clock::now();
+    entry.dateAdded = std::chrono::system_clock::to_time_t(now);
+
+    return entry;
+}
+
 } // namespace MIDIScaleDetector
@@ -5,8 +5,11 @@
 #include <functional>
 #include <thread>
 #include <atomic>
+#include <deque>
+#include <mutex>
 #include "../Database/Database.h"
 #include "../MIDIParser/MIDIParser.h"
+#include "../MIDIParser/ZipArchive.h"
 #include "../ScaleDetector/ScaleDetector.h"
 
 namespace MIDIScaleDetector {
@@ -20,9 +23,12 @@ struct ScannerConfig {
     std::vector<std::string> excludePaths;
     bool recursive;
     bool rescanModified;
+    bool deferAnalysis;     // Index probe info only; run analyzePending() later
+    bool scanArchives;      // Treat .zip files as folders ("pack.zip!/inner/file.mid")
     int maxThreads;
 
-    ScannerConfig() : recursive(true), rescanModified(true), maxThreads(4) {}
+    ScannerConfig() : recursive(true), rescanModified(true), deferAnalysis(false),
+                      scanArchives(true), maxThreads(4) {}
 };
 
 // Scanner statistics
@@ -61,30 +67,90 @@ public:
     // Rescan all files in database
     bool rescanAll(ProgressCallback callback = nullptr);
 
+    // Run full analysis on files indexed with deferAnalysis. Counts as a
+    // scan: false if one is already running, and stopScan() interrupts it.
+    bool analyzePending(ProgressCallback callback = nullptr);
+
+    // Files at least this large are analyzed by streaming instead of loading
+    void setStreamingThreshold(int64_t bytes) { streamingThreshold = bytes; }
+
+    // Depth of the analysis a scan stores (default Full, which chord filters
+    // need). A shallower level only suits callers that queue upgrades for
+    // the files they open or search by chord and run analyzeUpgrades().
+    void setAnalysisLevel(AnalysisLevel level) { scanLevel = level; }
+    AnalysisLevel getAnalysisLevel() const { return scanLevel; }
+
+    // Ask for a file to be analyzed to at least level, e.g. when the user
+    // opens it. Safe to call from any thread; the request is served first
+    // by the next analyzeUpgrades().
+    void queueUpgrade(const std::string& filePath, AnalysisLevel level);
+
+    // Reanalyze one file if its stored analysis is shallower than level.
+    // Streamed files stop at KeyAndAlternatives, the most streaming reaches.
+    bool upgradeFile(const std::string& filePath, AnalysisLevel level);
+
+    // Serve queued requests, then bring every analyzed file up to level, or
+    // as close as streaming gets for files over the streaming threshold.
+    // Meant for a background thread. Counts as a scan: false if one is
+    // already running, and stopScan() interrupts it.
+    bool analyzeUpgrades(AnalysisLevel level, ProgressCallback callback = nullptr);
+
 private:
     Database& db;
     MIDIParser parser;
+    MIDIFile scratchFile;   // Reused by every parse so event storage is recycled
+    StreamingParser streamingParser;
+    int64_t streamingThreshold;
+    ZipArchive archive;     // Last archive read, kept open for its remaining entries
     ScaleDetector detector;
+    AnalysisContext analysisContext;    // Analysis scratch, reused for every file
+    HarmonicAnalysis scratchAnalysis;
+    AnalysisLevel scanLevel;
+
+    std::mutex upgradeMutex;
+    std::deque<std::pair<std::string, AnalysisLevel>> upgradeQueue;
 
     std::atomic<bool> scanning;
     std::atomic<bool> shouldStop;
     ScanStats lastStats;
 
     // Internal scan methods
-    void scanDirectory(const std::string& path, bool recursive,
+    void scanDirectory(const std::string& path, bool recursive, bool scanArchives,
                       std::vector<std::string>& foundFiles);
+    void scanArchive(const std::string& archivePath, std::vector<std::string>& foundFiles);
+
+    // Claim the scanner for a scan or analysis pass; false if one is running
+    bool beginJob();
 
     bool isMIDIFile(const std::string& filePath);
+    bool isArchive(const std::string& filePath);
+    bool fileExists(const std::string& filePath);
     bool isExcluded(const std::string& filePath, const std::vector<std::string>& excludePaths);
 
     int64_t getFileModifiedTime(const std::string& filePath);
     int64_t getFileSize(const std::string& filePath);
 
+    const ZipEntry* findArchiveEntry(const std::string& filePath);
+    std::shared_ptr<const MappedFile> openArchiveEntry(const std::string& filePath);
+
+    // Files analyzed by streaming, and the deepest level they can reach
+    bool isStreamed(const std::string& filePath);
+    AnalysisLevel reachableLevel(const std::string& filePath, AnalysisLevel level);
+
     bool analyzeAndStore(const std::string& filePath);
+    bool analyzeAndStore(const std::string& filePath, AnalysisLevel level);
+    bool streamAndStore(const std::string& filePath);
+    bool probeAndStore(const std::string& filePath);
+    bool storeEntry(const MIDIFileEntry& entry);
 
     MIDIFileEntry createEntry(const std::string& filePath,
                              const MIDIFile& midiFile,
                              const HarmonicAnalysis& analysis);
+    MIDIFileEntry createEntry(const std::string& filePath,
+                             const StreamingParser& stream,
+                             const HarmonicAnalysis& analysis);
+    MIDIFileEntry createEntry(const std::string& filePath, const MIDIFileEntry& duplicate);
+    MIDIFileEntry createEntry(const std::string& filePath, const MIDIProbe& probe);
 };
 
 } // namespace MIDIScaleDetector
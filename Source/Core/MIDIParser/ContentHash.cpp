@@ -0,0 +1,103 @@
+#include "ContentHash.h"
+
+namespace MIDIScaleDetector {
+
+namespace {
+    constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+    constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+    constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+    inline uint64_t rotl(uint64_t value, int bits) {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    // Unaligned little-endian loads
+    inline uint64_t read64(const uint8_t* p) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; --i) {
+            value = (value << 8) | p[i];
+        }
+        return value;
+    }
+
+    inline uint32_t read32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    inline uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * kPrime2;
+        acc = rotl(acc, 31);
+        return acc * kPrime1;
+    }
+
+    inline uint64_t mergeRound(uint64_t acc, uint64_t value) {
+        acc ^= round(0, value);
+        return acc * kPrime1 + kPrime4;
+    }
+}
+
+uint64_t hashContent(const uint8_t* data, size_t size, uint64_t seed) {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    uint64_t hash;
+
+    if (size >= 32) {
+        // Four independent lanes over 32-byte stripes
+        uint64_t v1 = seed + kPrime1 + kPrime2;
+        uint64_t v2 = seed + kPrime2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - kPrime1;
+
+        const uint8_t* limit = end - 32;
+        do {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        hash = mergeRound(hash, v1);
+        hash = mergeRound(hash, v2);
+        hash = mergeRound(hash, v3);
+        hash = mergeRound(hash, v4);
+    } else {
+        hash = seed + kPrime5;
+    }
+
+    hash += static_cast<uint64_t>(size);
+
+    // Tail: 8, 4, then 1 byte at a time
+    while (p + 8 <= end) {
+        hash ^= round(0, read64(p));
+        hash = rotl(hash, 27) * kPrime1 + kPrime4;
+        p += 8;
+    }
+
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(read32(p)) * kPrime1;
+        hash = rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+
+    while (p < end) {
+        hash ^= static_cast<uint64_t>(*p) * kPrime5;
+        hash = rotl(hash, 11) * kPrime1;
+        p++;
+    }
+
+    // Final avalanche
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+
+    return hash;
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace MIDIScaleDetector {
+
+// 64-bit content hash (XXH64). Used to recognise byte-identical files under
+// different names so their analysis can be shared; not cryptographic.
+uint64_t hashContent(const uint8_t* data, size_t size, uint64_t seed = 0);
+
+} // namespace MIDIScaleDetector
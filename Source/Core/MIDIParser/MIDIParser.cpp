@@ -1,7 +1,11 @@
 #include "MIDIParser.h"
-#include <fstream>
+#include "MergedEventCursor.h"
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cstring>
+#include <numeric>
+#include <thread>
 
 namespace MIDIScaleDetector {
 
@@ -9,105 +13,464 @@ namespace MIDIScaleDetector {
 std::vector<MIDIEvent> MIDIFile::getAllNoteEvents() const {
     std::vector<MIDIEvent> allEvents;
 
+    size_t eventCount = 0;
     for (const auto& track : tracks) {
-        for (const auto& event : track.events) {
-            if (event.type == EventType::NoteOn || event.type == EventType::NoteOff) {
-                allEvents.push_back(event);
-            }
-        }
+        eventCount += track.events.size();
     }
+    allEvents.reserve(eventCount);
 
-    // Sort by timestamp
-    std::sort(allEvents.begin(), allEvents.end(),
-              [](const MIDIEvent& a, const MIDIEvent& b) {
-                  return a.timestamp < b.timestamp;
-              });
+    // Tracks are merged in time order, no sort needed
+    for (MergedEventCursor cursor(*this, true); !cursor.atEnd(); cursor.next()) {
+        allEvents.push_back(cursor.current());
+    }
 
     return allEvents;
 }
 
 std::vector<MIDIEvent> MIDIFile::getNoteEventsInRange(double startTime, double endTime) const {
-    auto allEvents = getAllNoteEvents();
     std::vector<MIDIEvent> rangeEvents;
 
-    for (const auto& event : allEvents) {
-        if (event.timestamp >= startTime && event.timestamp <= endTime) {
-            rangeEvents.push_back(event);
+    MergedEventCursor cursor(*this, true);
+    for (cursor.seek(startTime); !cursor.atEnd(); cursor.next()) {
+        const MIDIEvent& event = cursor.current();
+        if (event.timestamp > endTime) {
+            break;
         }
+        rangeEvents.push_back(event);
     }
 
     return rangeEvents;
 }
 
 double MIDIFile::getDuration() const {
-    double maxTime = 0.0;
+    uint32_t maxTick = 0;
+    bool hasEvents = false;
 
+    // Events are in tick order within a track
     for (const auto& track : tracks) {
+        if (!track.events.empty()) {
+            maxTick = std::max(maxTick, track.events.back().tick);
+            hasEvents = true;
+        }
+    }
+
+    return hasEvents ? tempoMap.ticksToSeconds(maxTick) : 0.0;
+}
+
+void MIDIFile::releaseSource() {
+    for (auto& track : tracks) {
+        track.name = {};
+        track.metaEvents.clear();
+    }
+    source.reset();
+}
+
+// TempoMap implementation
+void TempoMap::reset(uint16_t timeDivision) {
+    changes.clear();
+    division = timeDivision;
+    secondsPerSMPTETick = 0.0;
+
+    if (division & 0x8000) {
+        // SMPTE: negative frame rate in the high byte, ticks per frame in the low byte
+        int framesPerSecond = -static_cast<int8_t>(division >> 8);
+        int ticksPerFrame = division & 0xFF;
+        double fps = (framesPerSecond == 29) ? 29.97 : framesPerSecond; // 29 = 30 drop-frame
+        if (fps > 0.0 && ticksPerFrame > 0) {
+            secondsPerSMPTETick = 1.0 / (fps * ticksPerFrame);
+        }
+    }
+}
+
+void TempoMap::addChange(uint32_t tick, uint32_t microsecondsPerQuarter) {
+    if (microsecondsPerQuarter == 0) {
+        return;
+    }
+    changes.push_back({tick, microsecondsPerQuarter, 0.0});
+}
+
+void TempoMap::finalize() {
+    // Tracks are read in order, so a stable sort keeps the last change at a tick last
+    std::stable_sort(changes.begin(), changes.end(),
+                     [](const TempoChange& a, const TempoChange& b) {
+                         return a.tick < b.tick;
+                     });
+
+    // Default tempo (120 BPM) applies until the first change
+    if (changes.empty() || changes.front().tick != 0) {
+        changes.insert(changes.begin(), {0, 500000, 0.0});
+    }
+
+    // Collapse changes on the same tick - the last one wins
+    size_t count = 0;
+    for (size_t i = 0; i < changes.size(); ++i) {
+        if (count > 0 && changes[count - 1].tick == changes[i].tick) {
+            changes[count - 1] = changes[i];
+        } else {
+            changes[count++] = changes[i];
+        }
+    }
+    changes.resize(count);
+
+    // Cumulative seconds at each change
+    changes[0].seconds = 0.0;
+    for (size_t i = 1; i < changes.size(); ++i) {
+        const TempoChange& previous = changes[i - 1];
+        if (secondsPerSMPTETick > 0.0) {
+            changes[i].seconds = changes[i].tick * secondsPerSMPTETick;
+        } else {
+            changes[i].seconds = previous.seconds +
+                (changes[i].tick - previous.tick) *
+                (previous.microsecondsPerQuarter / 1000000.0) / division;
+        }
+    }
+}
+
+double TempoMap::ticksToSeconds(uint32_t tick) const {
+    if (secondsPerSMPTETick > 0.0) {
+        return tick * secondsPerSMPTETick;
+    }
+    if (changes.empty()) {
+        return tick * 0.5 / division;
+    }
+
+    // Last change at or before tick
+    auto it = std::upper_bound(changes.begin(), changes.end(), tick,
+                               [](uint32_t value, const TempoChange& change) {
+                                   return value < change.tick;
+                               });
+    const TempoChange& change = *(it == changes.begin() ? it : it - 1);
+    return change.seconds +
+        (tick - change.tick) * (change.microsecondsPerQuarter / 1000000.0) / division;
+}
+
+double TempoMap::ticksToSeconds(uint32_t tick, size_t& segment) const {
+    if (secondsPerSMPTETick > 0.0 || changes.empty()) {
+        return ticksToSeconds(tick);
+    }
+
+    while (segment + 1 < changes.size() && changes[segment + 1].tick <= tick) {
+        ++segment;
+    }
+    const TempoChange& change = changes[segment];
+    return change.seconds +
+        (tick - change.tick) * (change.microsecondsPerQuarter / 1000000.0) / division;
+}
+
+// NoteTable implementation
+void NoteTable::clear() {
+    pitch.clear();
+    channel.clear();
+    velocity.clear();
+    startTick.clear();
+    endTick.clear();
+    startTime.clear();
+    endTime.clear();
+}
+
+void NoteTable::reserve(size_t count) {
+    pitch.reserve(count);
+    channel.reserve(count);
+    velocity.reserve(count);
+    startTick.reserve(count);
+    endTick.reserve(count);
+    startTime.reserve(count);
+    endTime.reserve(count);
+}
+
+void NoteTable::append(uint8_t notePitch, uint8_t noteChannel, uint8_t noteVelocity,
+                       uint32_t start, uint32_t end) {
+    pitch.push_back(notePitch);
+    channel.push_back(noteChannel);
+    velocity.push_back(noteVelocity);
+    startTick.push_back(start);
+    endTick.push_back(end);
+}
+
+void NoteTable::build(const std::vector<MIDITrack>& tracks, const TempoMap& tempoMap) {
+    clear();
+
+    size_t eventCount = 0;
+    for (const auto& track : tracks) {
+        eventCount += track.events.size();
+    }
+    reserve(eventCount / 2);
+
+    // Row of the sounding note for each channel/pitch, or -1
+    std::array<int32_t, 16 * 128> openNotes;
+    bool sorted = true;
+
+    for (const auto& track : tracks) {
+        openNotes.fill(-1);
+        uint32_t lastTick = 0;
+
         for (const auto& event : track.events) {
-            maxTime = std::max(maxTime, event.timestamp);
+            lastTick = event.tick;
+            if (event.type != EventType::NoteOn && event.type != EventType::NoteOff) {
+                continue;
+            }
+
+            int32_t& open = openNotes[(event.channel & 0x0F) * 128 + (event.note & 0x7F)];
+            if (open >= 0) {
+                // Note-off, or a retrigger of a note that is still sounding
+                endTick[open] = event.tick;
+                open = -1;
+            }
+
+            if (event.type == EventType::NoteOn) {
+                if (!startTick.empty() && event.tick < startTick.back()) {
+                    sorted = false;
+                }
+                open = static_cast<int32_t>(size());
+                append(event.note, event.channel, event.velocity, event.tick, event.tick);
+            }
+        }
+
+        // Notes never released end with their track
+        for (int32_t open : openNotes) {
+            if (open >= 0) {
+                endTick[open] = lastTick;
+            }
         }
     }
 
-    return maxTime;
+    // Tracks are individually ordered; merge them by start tick
+    if (!sorted) {
+        std::vector<uint32_t> order(size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(),
+                         [this](uint32_t a, uint32_t b) {
+                             return startTick[a] < startTick[b];
+                         });
+
+        auto permute = [&order](auto& column) {
+            auto original = column;
+            for (size_t i = 0; i < order.size(); ++i) {
+                column[i] = original[order[i]];
+            }
+        };
+        permute(pitch);
+        permute(channel);
+        permute(velocity);
+        permute(startTick);
+        permute(endTick);
+    }
+
+    // Starts ascend, so they take a linear walk over the tempo map
+    startTime.resize(size());
+    endTime.resize(size());
+    size_t segment = 0;
+    for (size_t i = 0; i < size(); ++i) {
+        startTime[i] = tempoMap.ticksToSeconds(startTick[i], segment);
+        endTime[i] = tempoMap.ticksToSeconds(endTick[i]);
+    }
+}
+
+size_t NoteTable::lowerBound(double time) const {
+    return static_cast<size_t>(
+        std::lower_bound(startTime.begin(), startTime.end(), time) - startTime.begin());
 }
 
 // MIDIParser implementation
-MIDIParser::MIDIParser() : lastError("") {}
+MIDIParser::MIDIParser()
+    : lastError(""), buildNoteTable(false), parseOptions(ParseEverything),
+      parallelThreshold(kDefaultParallelThreshold),
+      maxDecodeThreads(std::max(1u, std::thread::hardware_concurrency())) {}
 
 MIDIParser::~MIDIParser() {}
 
 bool MIDIParser::parse(const std::string& filePath, MIDIFile& midiFile) {
-    // Read entire file into memory
-    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
-    if (!file.is_open()) {
-        lastError = "Failed to open file: " + filePath;
+    // Map the file and decode straight from the mapping
+    auto source = MappedFile::open(filePath, lastError);
+    if (!source) {
         return false;
     }
 
-    std::streamsize fileSize = file.tellg();
-    file.seekg(0, std::ios::beg);
-
-    std::vector<uint8_t> buffer(fileSize);
-    if (!file.read(reinterpret_cast<char*>(buffer.data()), fileSize)) {
-        lastError = "Failed to read file: " + filePath;
+    if (!parse(std::move(source), midiFile)) {
         return false;
     }
 
     midiFile.filePath = filePath;
+    return true;
+}
 
-    // Parse header
-    size_t offset = 0;
-    if (!parseHeader(buffer.data(), buffer.size(), midiFile.header, offset)) {
+bool MIDIParser::parse(std::shared_ptr<const MappedFile> source, MIDIFile& midiFile) {
+    if (!source) {
+        lastError = "No MIDI data to parse";
         return false;
     }
 
-    // Parse tracks
-    midiFile.tracks.clear();
-    midiFile.tracks.reserve(midiFile.header.trackCount);
+    midiFile.source = std::move(source);
+    return parseBuffer(midiFile.source->data(), midiFile.source->size(), midiFile);
+}
 
-    double currentTempo = 120.0; // Default tempo
+bool MIDIParser::parse(const uint8_t* data, size_t size, MIDIFile& midiFile) {
+    midiFile.source.reset();
+    return parseBuffer(data, size, midiFile);
+}
 
-    for (uint16_t i = 0; i < midiFile.header.trackCount; ++i) {
-        MIDITrack track;
-        if (!parseTrack(buffer.data(), buffer.size(), track, offset, midiFile.header.division)) {
+size_t MIDIParser::parseBatch(const std::vector<std::string>& filePaths, const BatchCallback& callback) {
+    // Past this many retained events one oversized file would pin its
+    // storage for the rest of the batch, so start over with a fresh file
+    static constexpr size_t kMaxRetainedEvents = 1 << 20;
+
+    MIDIFile midiFile;
+    size_t parsedCount = 0;
+
+    for (size_t i = 0; i < filePaths.size(); ++i) {
+        bool parsed = parse(filePaths[i], midiFile);
+        if (parsed) {
+            parsedCount++;
+        }
+
+        if (callback && !callback(i, midiFile, parsed)) {
+            break;
+        }
+
+        size_t retainedEvents = 0;
+        for (const auto& track : midiFile.tracks) {
+            retainedEvents += track.events.capacity();
+        }
+        if (retainedEvents > kMaxRetainedEvents) {
+            midiFile = MIDIFile();
+        } else {
+            // Unmap now rather than when the next file replaces it
+            midiFile.releaseSource();
+        }
+    }
+
+    return parsedCount;
+}
+
+bool MIDIParser::probe(const std::string& filePath, MIDIProbe& result) {
+    auto source = MappedFile::open(filePath, lastError);
+    if (!source) {
+        return false;
+    }
+    return probe(source->data(), source->size(), result);
+}
+
+bool MIDIParser::probe(const uint8_t* data, size_t size, MIDIProbe& result) {
+    result = MIDIProbe();
+    result.contentHash = hashContent(data, size);
+
+    size_t offset = 0;
+    if (!parseHeader(data, size, result.header, offset)) {
+        return false;
+    }
+
+    TempoMap tempoMap;
+    tempoMap.reset(result.header.division);
+    uint32_t lastTick = 0;
+    uint32_t timeSignatureTick = UINT32_MAX;
+
+    for (uint16_t i = 0; i < result.header.trackCount; ++i) {
+        if (!probeTrack(data, size, offset, tempoMap, result, lastTick, timeSignatureTick)) {
             lastError = "Failed to parse track " + std::to_string(i);
             return false;
         }
+    }
 
-        // Extract tempo from first track if available
-        if (i == 0) {
-            for (const auto& event : track.events) {
-                if (event.type == EventType::Tempo) {
-                    currentTempo = event.value; // Simplified
-                    break;
-                }
+    const auto& changes = tempoMap.changes;
+    auto firstChange = std::min_element(changes.begin(), changes.end(),
+                                        [](const TempoChange& a, const TempoChange& b) {
+                                            return a.tick < b.tick;
+                                        });
+    result.tempo = (firstChange == changes.end()) ? 120.0 : firstChange->getBPM();
+
+    tempoMap.finalize();
+    result.duration = tempoMap.ticksToSeconds(lastTick);
+
+    return true;
+}
+
+bool MIDIParser::parseBuffer(const uint8_t* data, size_t size, MIDIFile& midiFile) {
+    midiFile.filePath.clear();
+
+    // Hash the raw bytes while they are being brought in for decoding
+    midiFile.contentHash = hashContent(data, size);
+
+    // Parse header
+    size_t offset = 0;
+    if (!parseHeader(data, size, midiFile.header, offset)) {
+        return false;
+    }
+
+    // Find every track chunk first so tracks can be decoded independently
+    if (!locateTracks(data, size, offset, midiFile.header.trackCount)) {
+        return false;
+    }
+
+    // Parse tracks - events get ticks now, timestamps once the tempo map is complete.
+    // Track slots from a previous parse are reused along with their capacity.
+    midiFile.tracks.resize(midiFile.header.trackCount);
+    midiFile.tempoMap.reset(midiFile.header.division);
+    midiFile.keySignatures.clear();
+    midiFile.timeSignatures.clear();
+    if (trackSignals.size() < midiFile.header.trackCount) {
+        trackSignals.resize(midiFile.header.trackCount);
+    }
+
+    unsigned threadCount = std::min<unsigned>(maxDecodeThreads, midiFile.header.trackCount);
+    if (threadCount > 1 && size >= parallelThreshold) {
+        size_t failedTrack = parseTracksParallel(data, midiFile, threadCount);
+        if (failedTrack < midiFile.header.trackCount) {
+            lastError = "Failed to parse track " + std::to_string(failedTrack);
+            return false;
+        }
+    } else {
+        for (uint16_t i = 0; i < midiFile.header.trackCount; ++i) {
+            MIDITrack& track = midiFile.tracks[i];
+            track.clear();
+            if (!parseTrack(data, trackRanges[i], track, trackSignals[i])) {
+                lastError = "Failed to parse track " + std::to_string(i);
+                return false;
             }
         }
+    }
+
+    // Merge in track order so same-tick changes resolve as in a serial read
+    for (uint16_t i = 0; i < midiFile.header.trackCount; ++i) {
+        const TrackSignals& signals = trackSignals[i];
+        for (const auto& change : signals.tempoChanges) {
+            midiFile.tempoMap.addChange(change.tick, change.microsecondsPerQuarter);
+        }
+        midiFile.keySignatures.insert(midiFile.keySignatures.end(),
+                                      signals.keySignatures.begin(), signals.keySignatures.end());
+        midiFile.timeSignatures.insert(midiFile.timeSignatures.end(),
+                                       signals.timeSignatures.begin(), signals.timeSignatures.end());
+    }
 
-        midiFile.tracks.push_back(track);
+    // Earliest explicit tempo event, before defaults are filled in
+    const auto& changes = midiFile.tempoMap.changes;
+    auto firstChange = std::min_element(changes.begin(), changes.end(),
+                                        [](const TempoChange& a, const TempoChange& b) {
+                                            return a.tick < b.tick;
+                                        });
+    midiFile.tempo = (firstChange == changes.end()) ? 120.0 : firstChange->getBPM();
+
+    // Tempo changes from every track apply to all tracks
+    midiFile.tempoMap.finalize();
+    for (auto& track : midiFile.tracks) {
+        applyTimestamps(track, midiFile.tempoMap);
     }
 
-    midiFile.tempo = currentTempo;
+    // Signatures may come from any track; order them like the tempo map
+    auto byTick = [](const auto& a, const auto& b) { return a.tick < b.tick; };
+    std::stable_sort(midiFile.keySignatures.begin(), midiFile.keySignatures.end(), byTick);
+    std::stable_sort(midiFile.timeSignatures.begin(), midiFile.timeSignatures.end(), byTick);
+    for (auto& signature : midiFile.keySignatures) {
+        signature.time = midiFile.tempoMap.ticksToSeconds(signature.tick);
+    }
+    for (auto& signature : midiFile.timeSignatures) {
+        signature.time = midiFile.tempoMap.ticksToSeconds(signature.tick);
+    }
+
+    if (buildNoteTable) {
+        midiFile.notes.build(midiFile.tracks, midiFile.tempoMap);
+    } else {
+        midiFile.notes.clear();
+    }
 
     return true;
 }
@@ -144,126 +507,281 @@ bool MIDIParser::parseHeader(const uint8_t* data, size_t size, MIDIHeader& heade
 
     // Time division
     header.division = read16BitValue(data, offset);
+    if (header.division == 0) {
+        lastError = "Invalid MIDI time division";
+        return false;
+    }
 
     return true;
 }
 
-bool MIDIParser::parseTrack(const uint8_t* data, size_t size, MIDITrack& track,
-                            size_t& offset, uint16_t division) {
-    if (offset + 8 > size) {
-        lastError = "Unexpected end of file while parsing track";
-        return false;
+namespace {
+    // Longest event header: 4-byte delta, status, meta type and 4-byte length
+    constexpr size_t kSafeMargin = 10;
+
+    // Byte reader over one track chunk. The unchecked variant is only used
+    // while kSafeMargin bytes remain, so no header read can leave the chunk
+    // and the per-byte tests compile away. Near the end of a chunk every read
+    // is tested. Payload skips are always tested against the chunk end.
+    template <bool Checked>
+    struct ChunkReader {
+        const uint8_t* position;
+        const uint8_t* end;
+        bool failed;
+
+        uint8_t byte() {
+            if (Checked && position >= end) {
+                failed = true;
+                return 0;
+            }
+            return *position++;
+        }
+
+        // Quantities are at most four bytes long
+        uint32_t variableLength() {
+            uint32_t value = 0;
+            for (int i = 0; i < 4; ++i) {
+                uint8_t next = byte();
+                value = (value << 7) | (next & 0x7F);
+                if ((next & 0x80) == 0) {
+                    return value;
+                }
+            }
+            failed = true;
+            return value;
+        }
+
+        void skip(uint32_t count) {
+            if (failed || count > static_cast<size_t>(end - position)) {
+                failed = true;
+                return;
+            }
+            position += count;
+        }
+    };
+}
+
+template <bool Checked>
+inline bool MIDIParser::decodeEvent(const uint8_t* data, size_t& offset, size_t end,
+                             uint8_t& runningStatus, RawEvent& event) {
+    ChunkReader<Checked> in{data + offset, data + end, false};
+
+    event.delta = in.variableLength();
+    event.status = in.byte();
+
+    if ((event.status & 0x80) == 0 && !in.failed) {
+        if (runningStatus == 0) {
+            // Stray data byte with no status to run on - drop it
+            event.status = 0;
+            offset = static_cast<size_t>(in.position - data);
+            return true;
+        }
+        // Running status: this byte is the first data byte
+        in.position--;
+        event.status = runningStatus;
     }
 
-    // Check MTrk marker
-    if (std::memcmp(data + offset, "MTrk", 4) != 0) {
-        lastError = "Invalid track: Missing MTrk marker";
-        return false;
+    if (event.status < 0xF0) {
+        runningStatus = event.status;
+        event.data1 = in.byte() & 0x7F;
+        uint8_t type = event.status & 0xF0;
+        event.data2 = (type != 0xC0 && type != 0xD0) ? (in.byte() & 0x7F) : 0;
+    } else {
+        // Meta and SysEx events cancel running status
+        runningStatus = 0;
+        event.metaType = (event.status == 0xFF) ? in.byte() : 0;
+        event.payloadLength = in.variableLength();
+        event.payloadOffset = static_cast<size_t>(in.position - data);
+        in.skip(event.payloadLength);
     }
-    offset += 4;
 
-    // Track length
-    uint32_t trackLength = read32BitValue(data, offset);
-    size_t trackEnd = offset + trackLength;
+    offset = static_cast<size_t>(in.position - data);
+    return !in.failed;
+}
 
-    if (trackEnd > size) {
-        lastError = "Track length exceeds file size";
-        return false;
+inline bool MIDIParser::readNextEvent(const uint8_t* data, size_t& offset, size_t end,
+                                      uint8_t& runningStatus, RawEvent& event) {
+    // One margin test per event picks the decoder
+    if (end - offset >= kSafeMargin) {
+        return decodeEvent<false>(data, offset, end, runningStatus, event);
     }
+    return decodeEvent<true>(data, offset, end, runningStatus, event);
+}
+
+bool MIDIParser::openTrackChunk(const uint8_t* data, size_t size, size_t& offset, size_t& trackEnd) {
+    // Chunks other than MTrk are allowed by the spec and skipped
+    for (;;) {
+        if (size - offset < 8) {
+            lastError = "Unexpected end of file while parsing track";
+            return false;
+        }
+
+        bool isTrack = std::memcmp(data + offset, "MTrk", 4) == 0;
+        offset += 4;
+
+        uint32_t chunkLength = read32BitValue(data, offset);
+        if (chunkLength > size - offset) {
+            lastError = "Track length exceeds file size";
+            return false;
+        }
+
+        if (isTrack) {
+            trackEnd = offset + chunkLength;
+            return true;
+        }
+
+        offset += chunkLength;
+    }
+}
+
+bool MIDIParser::locateTracks(const uint8_t* data, size_t size, size_t offset, uint16_t trackCount) {
+    // Chunk headers only - a cheap walk even for very large files
+    trackRanges.resize(trackCount);
+    for (uint16_t i = 0; i < trackCount; ++i) {
+        size_t trackEnd = 0;
+        if (!openTrackChunk(data, size, offset, trackEnd)) {
+            lastError = "Failed to parse track " + std::to_string(i);
+            return false;
+        }
+        trackRanges[i] = {offset, trackEnd};
+        offset = trackEnd;
+    }
+    return true;
+}
+
+size_t MIDIParser::parseTracksParallel(const uint8_t* data, MIDIFile& midiFile, unsigned threadCount) {
+    const size_t trackCount = midiFile.header.trackCount;
+    std::vector<char> failed(trackCount, 0);
+
+    // Workers claim one track at a time, so a few long tracks don't stall the rest
+    std::atomic<size_t> nextTrack(0);
+    auto worker = [&]() {
+        for (size_t i = nextTrack++; i < trackCount; i = nextTrack++) {
+            MIDITrack& track = midiFile.tracks[i];
+            track.clear();
+            failed[i] = !parseTrack(data, trackRanges[i], track, trackSignals[i]);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threadCount - 1);
+    for (unsigned i = 1; i < threadCount; ++i) {
+        workers.emplace_back(worker);
+    }
+    worker();
+    for (auto& thread : workers) {
+        thread.join();
+    }
+
+    // Report the first bad track, as a serial parse would
+    return static_cast<size_t>(std::find(failed.begin(), failed.end(), 1) - failed.begin());
+}
+
+bool MIDIParser::parseTrack(const uint8_t* data, const TrackRange& range, MIDITrack& track,
+                            TrackSignals& signals) const {
+    signals.clear();
+    size_t offset = range.begin;
+    const size_t trackEnd = range.end;
 
     uint32_t currentTick = 0;
-    double currentTime = 0.0;
-    double tempo = 120.0; // Default BPM
     uint8_t runningStatus = 0;
+    RawEvent raw{};
 
     while (offset < trackEnd) {
-        // Read delta time
-        uint32_t deltaTime = readVariableLength(data, offset);
-        currentTick += deltaTime;
-        currentTime += ticksToSeconds(deltaTime, division, tempo);
-
-        // Read event type
-        uint8_t status = read8BitValue(data, offset);
-
-        // Handle running status
-        if ((status & 0x80) == 0) {
-            offset--; // Back up, this is a data byte
-            status = runningStatus;
-        } else {
-            runningStatus = status;
+        if (!readNextEvent(data, offset, trackEnd, runningStatus, raw)) {
+            return false;
         }
-
-        uint8_t eventType = status & 0xF0;
-        uint8_t channel = status & 0x0F;
+        currentTick += raw.delta;
 
         MIDIEvent event;
         event.tick = currentTick;
-        event.timestamp = currentTime;
-        event.channel = channel;
+        event.channel = raw.status & 0x0F;
+        event.note = raw.data1;
+        event.velocity = raw.data2;
 
-        switch (eventType) {
+        switch (raw.status & 0xF0) {
             case 0x80: // Note Off
                 event.type = EventType::NoteOff;
-                event.note = read8BitValue(data, offset);
-                event.velocity = read8BitValue(data, offset);
-                track.events.push_back(event);
+                if (parseOptions & ParseNotes) {
+                    track.events.push_back(event);
+                }
                 break;
 
-            case 0x90: // Note On
-                event.type = EventType::NoteOn;
-                event.note = read8BitValue(data, offset);
-                event.velocity = read8BitValue(data, offset);
-                // Velocity 0 is actually Note Off
-                if (event.velocity == 0) {
-                    event.type = EventType::NoteOff;
+            case 0x90: // Note On - velocity 0 is actually Note Off
+                event.type = event.velocity == 0 ? EventType::NoteOff : EventType::NoteOn;
+                if (parseOptions & ParseNotes) {
+                    track.events.push_back(event);
                 }
-                track.events.push_back(event);
                 break;
 
-            case 0xB0: // Control Change
+            case 0xB0: // Control Change (controller, value)
                 event.type = EventType::ControlChange;
-                event.controller = read8BitValue(data, offset);
-                event.value = read8BitValue(data, offset);
-                track.events.push_back(event);
+                if (parseOptions & ParseControlChanges) {
+                    track.events.push_back(event);
+                }
                 break;
 
             case 0xC0: // Program Change
                 event.type = EventType::ProgramChange;
-                event.value = read8BitValue(data, offset);
-                track.events.push_back(event);
+                if (parseOptions & ParseProgramChanges) {
+                    track.events.push_back(event);
+                }
                 break;
 
-            case 0xF0: // System/Meta events
-                if (status == 0xFF) {
-                    uint8_t metaType = read8BitValue(data, offset);
-                    uint32_t metaLength = readVariableLength(data, offset);
+            case 0xF0: // System/Meta events - SysEx payloads are skipped
+                if (raw.status == 0xFF) {
+                    const uint8_t* payloadBytes = data + raw.payloadOffset;
+                    std::string_view payload(reinterpret_cast<const char*>(payloadBytes), raw.payloadLength);
 
-                    if (metaType == 0x51 && metaLength == 3) {
+                    if (raw.metaType == 0x51 && raw.payloadLength == 3) {
                         // Tempo meta event
                         uint32_t microsecondsPerQuarter =
-                            (data[offset] << 16) | (data[offset + 1] << 8) | data[offset + 2];
-                        tempo = 60000000.0 / microsecondsPerQuarter;
-                    } else if (metaType == 0x03) {
+                            (payloadBytes[0] << 16) | (payloadBytes[1] << 8) | payloadBytes[2];
+                        if (microsecondsPerQuarter != 0) {
+                            signals.tempoChanges.push_back({currentTick, microsecondsPerQuarter, 0.0});
+                        }
+                    } else if (raw.metaType == 0x59 && raw.payloadLength == 2) {
+                        // Key signature: sharps/flats count and major/minor flag
+                        int8_t sharpsFlats = static_cast<int8_t>(payloadBytes[0]);
+                        if (sharpsFlats >= -7 && sharpsFlats <= 7 && payloadBytes[1] <= 1) {
+                            KeySignature signature;
+                            signature.tick = currentTick;
+                            signature.sharpsFlats = sharpsFlats;
+                            signature.minor = payloadBytes[1] == 1;
+                            signals.keySignatures.push_back(signature);
+                        }
+                    } else if (raw.metaType == 0x58 && raw.payloadLength >= 2 && payloadBytes[0] > 0) {
+                        // Time signature: denominator is stored as a power of two
+                        TimeSignature signature;
+                        signature.tick = currentTick;
+                        signature.numerator = payloadBytes[0];
+                        signature.denominator = static_cast<uint8_t>(1u << std::min<uint8_t>(payloadBytes[1], 7));
+                        if (raw.payloadLength >= 4) {
+                            signature.clocksPerClick = payloadBytes[2];
+                            signature.thirtySecondsPerQuarter = payloadBytes[3];
+                        }
+                        signals.timeSignatures.push_back(signature);
+                    } else if (raw.metaType == 0x03) {
                         // Track name
-                        track.name = std::string(reinterpret_cast<const char*>(data + offset), metaLength);
+                        track.name = payload;
+                    } else if (raw.metaType == 0x2F) {
+                        // End of Track keeps any trailing rest in the track length
+                        track.endTick = currentTick;
                     }
 
-                    offset += metaLength;
-                } else {
-                    // SysEx - skip for now
-                    uint32_t sysexLength = readVariableLength(data, offset);
-                    offset += sysexLength;
+                    if (raw.metaType != 0x2F && (parseOptions & ParseMetaEvents)) {
+                        // Keep the payload as a view - End of Track carries nothing
+                        MIDIMetaEvent meta;
+                        meta.tick = currentTick;
+                        meta.type = raw.metaType;
+                        meta.data = payload;
+                        track.metaEvents.push_back(meta);
+                    }
                 }
                 break;
 
             default:
-                // Other event types - skip data bytes
-                if (eventType >= 0x80 && eventType < 0xF0) {
-                    offset++; // Skip one data byte
-                    if (eventType != 0xC0 && eventType != 0xD0) {
-                        offset++; // Skip second data byte for most events
-                    }
-                }
+                // Aftertouch and pitch bend are not stored
                 break;
         }
     }
@@ -271,16 +789,70 @@ bool MIDIParser::parseTrack(const uint8_t* data, size_t size, MIDITrack& track,
     return true;
 }
 
-uint32_t MIDIParser::readVariableLength(const uint8_t* data, size_t& offset) {
-    uint32_t value = 0;
-    uint8_t byte;
+bool MIDIParser::probeTrack(const uint8_t* data, size_t size, size_t& offset, TempoMap& tempoMap,
+                            MIDIProbe& result, uint32_t& lastTick, uint32_t& timeSignatureTick) {
+    size_t trackEnd = 0;
+    if (!openTrackChunk(data, size, offset, trackEnd)) {
+        return false;
+    }
 
-    do {
-        byte = data[offset++];
-        value = (value << 7) | (byte & 0x7F);
-    } while (byte & 0x80);
+    uint32_t currentTick = 0;
+    uint8_t runningStatus = 0;
+    RawEvent raw{};
 
-    return value;
+    while (offset < trackEnd) {
+        if (!readNextEvent(data, offset, trackEnd, runningStatus, raw)) {
+            lastError = "Truncated or malformed event in track";
+            return false;
+        }
+        currentTick += raw.delta;
+
+        switch (raw.status & 0xF0) {
+            case 0x90:
+                // A zero velocity is a note-off
+                if (raw.data2 != 0) {
+                    result.noteCount++;
+                }
+                lastTick = std::max(lastTick, currentTick);
+                break;
+
+            case 0x80:
+            case 0xB0:
+                lastTick = std::max(lastTick, currentTick);
+                break;
+
+            case 0xC0:
+                if (result.firstProgram < 0) {
+                    result.firstProgram = raw.data1;
+                }
+                lastTick = std::max(lastTick, currentTick);
+                break;
+
+            case 0xF0:
+                if (raw.status == 0xFF) {
+                    const uint8_t* payload = data + raw.payloadOffset;
+
+                    if (raw.metaType == 0x51 && raw.payloadLength == 3) {
+                        uint32_t microsecondsPerQuarter =
+                            (payload[0] << 16) | (payload[1] << 8) | payload[2];
+                        tempoMap.addChange(currentTick, microsecondsPerQuarter);
+                    } else if (raw.metaType == 0x58 && raw.payloadLength >= 2 && currentTick < timeSignatureTick) {
+                        // Earliest time signature wins; denominator is a power of two
+                        timeSignatureTick = currentTick;
+                        result.timeSignatureNumerator = payload[0];
+                        result.timeSignatureDenominator = static_cast<uint8_t>(1u << std::min<uint8_t>(payload[1], 7));
+                    } else if (raw.metaType == 0x03) {
+                        result.trackNames.emplace_back(reinterpret_cast<const char*>(payload), raw.payloadLength);
+                    }
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return true;
 }
 
 uint32_t MIDIParser::read32BitValue(const uint8_t* data, size_t& offset) {
@@ -296,15 +868,12 @@ uint16_t MIDIParser::read16BitValue(const uint8_t* data, size_t& offset) {
     return value;
 }
 
-uint8_t MIDIParser::read8BitValue(const uint8_t* data, size_t& offset) {
-    return data[offset++];
-}
-
-double MIDIParser::ticksToSeconds(uint32_t ticks, uint16_t division, double tempo) const {
-    // tempo is in BPM
-    double secondsPerBeat = 60.0 / tempo;
-    double secondsPerTick = secondsPerBeat / division;
-    return ticks * secondsPerTick;
+void MIDIParser::applyTimestamps(MIDITrack& track, const TempoMap& tempoMap) const {
+    // Events are in tick order, so walk the tempo map alongside them
+    size_t segment = 0;
+    for (auto& event : track.events) {
+        event.timestamp = static_cast<float>(tempoMap.ticksToSeconds(event.tick, segment));
+    }
 }
 
 } // namespace MIDIScaleDetector
@@ -2,13 +2,18 @@
 
 #include <vector>
 #include <string>
+#include <string_view>
 #include <cstdint>
 #include <map>
+#include <memory>
+#include <functional>
+#include "MappedFile.h"
+#include "ContentHash.h"
 
 namespace MIDIScaleDetector {
 
 // MIDI Event Types
-enum class EventType {
+enum class EventType : uint8_t {
     NoteOn,
     NoteOff,
     ControlChange,
@@ -19,47 +24,187 @@ enum class EventType {
     Unknown
 };
 
-// MIDI Event Structure
+// MIDI Event Structure, packed to 12 bytes. The two data bytes are shared
+// between event types: use the accessors for control and program changes.
+// Exact times come from the tempo map; timestamp is a float convenience.
 struct MIDIEvent {
     uint32_t tick;          // Time in MIDI ticks
-    double timestamp;       // Time in seconds
+    float timestamp;        // Time in seconds
     EventType type;
     uint8_t channel;
-    uint8_t note;           // MIDI note number (0-127)
-    uint8_t velocity;
-    uint8_t controller;
-    uint8_t value;
+    uint8_t note;           // First data byte: note number, controller or program
+    uint8_t velocity;       // Second data byte: velocity or controller value
 
-    MIDIEvent() : tick(0), timestamp(0.0), type(EventType::Unknown),
-                  channel(0), note(0), velocity(0), controller(0), value(0) {}
+    MIDIEvent() : tick(0), timestamp(0.0f), type(EventType::Unknown),
+                  channel(0), note(0), velocity(0) {}
+
+    uint8_t controller() const { return note; }
+    uint8_t value() const { return velocity; }
+    uint8_t program() const { return note; }
+};
+
+static_assert(sizeof(MIDIEvent) == 12, "MIDIEvent should stay packed");
+
+// Which events MIDIParser stores. Tempo is always read (it drives timing)
+// and track names are always kept; everything else can be skipped.
+enum ParseOptions : uint32_t {
+    ParseNotes            = 1 << 0,
+    ParseProgramChanges   = 1 << 1,
+    ParseControlChanges   = 1 << 2,
+    ParseMetaEvents       = 1 << 3,
+
+    ParseNotesOnly        = ParseNotes,
+    ParseNotesAndPrograms = ParseNotes | ParseProgramChanges,
+    ParseEverything       = ParseNotes | ParseProgramChanges | ParseControlChanges | ParseMetaEvents
+};
+
+// Meta event with its payload left in the source bytes
+struct MIDIMetaEvent {
+    uint32_t tick;
+    uint8_t type;           // Meta type (0x03 = track name, 0x51 = tempo, ...)
+    std::string_view data;  // View into MIDIFile::source
+
+    MIDIMetaEvent() : tick(0), type(0) {}
 };
 
 // MIDI Track
 struct MIDITrack {
-    std::string name;
+    std::string_view name;  // View into MIDIFile::source
     std::vector<MIDIEvent> events;
+    std::vector<MIDIMetaEvent> metaEvents;
     int channel;
+    uint32_t endTick;       // End of Track tick, later than the last event when a track ends on a rest
+
+    MIDITrack() : channel(-1), endTick(0) {}
 
-    MIDITrack() : channel(-1) {}
+    // Empty the track but keep vector capacity for the next parse
+    void clear() {
+        name = {};
+        events.clear();
+        metaEvents.clear();
+        channel = -1;
+        endTick = 0;
+    }
 };
 
 // MIDI File Header
 struct MIDIHeader {
     uint16_t format;        // 0, 1, or 2
     uint16_t trackCount;
-    uint16_t division;      // Ticks per quarter note
+    uint16_t division;      // Ticks per quarter note, or SMPTE frames/ticks if the top bit is set
 
     MIDIHeader() : format(0), trackCount(0), division(480) {}
+
+    bool isSMPTE() const { return (division & 0x8000) != 0; }
+};
+
+// Tempo change at an absolute tick
+struct TempoChange {
+    uint32_t tick;
+    uint32_t microsecondsPerQuarter;
+    double seconds;         // Time of the change from the start of the file
+
+    double getBPM() const { return 60000000.0 / microsecondsPerQuarter; }
+};
+
+// Key signature meta event (0x59)
+struct KeySignature {
+    uint32_t tick;
+    double time;            // Seconds, from the tempo map
+    int8_t sharpsFlats;     // -7 (seven flats) to +7 (seven sharps)
+    bool minor;
+
+    KeySignature() : tick(0), time(0.0), sharpsFlats(0), minor(false) {}
+
+    // Pitch class of the declared tonic (0 = C)
+    int getTonicPitchClass() const {
+        int majorTonic = ((sharpsFlats * 7) % 12 + 12) % 12;
+        return minor ? (majorTonic + 9) % 12 : majorTonic;
+    }
+};
+
+// Time signature meta event (0x58)
+struct TimeSignature {
+    uint32_t tick;
+    double time;            // Seconds, from the tempo map
+    uint8_t numerator;
+    uint8_t denominator;    // Note value, e.g. 4 for quarter notes
+    uint8_t clocksPerClick;
+    uint8_t thirtySecondsPerQuarter;
+
+    TimeSignature() : tick(0), time(0.0), numerator(4), denominator(4),
+                      clocksPerClick(24), thirtySecondsPerQuarter(8) {}
+};
+
+// File-wide tempo map. Tempo events from every track are merged here so
+// that format-1 tracks share the conductor track's timing.
+struct TempoMap {
+    std::vector<TempoChange> changes;   // Sorted by tick, always starts at tick 0
+    uint16_t division;
+    double secondsPerSMPTETick;         // Non-zero for SMPTE divisions (tempo-independent)
+
+    TempoMap() : division(480), secondsPerSMPTETick(0.0) {}
+
+    // Start collecting changes for a file with the given header division
+    void reset(uint16_t timeDivision);
+
+    // Record a tempo event; call finalize() once all tracks are read
+    void addChange(uint32_t tick, uint32_t microsecondsPerQuarter);
+
+    // Sort changes and compute the cumulative seconds at each one
+    void finalize();
+
+    // Convert an absolute tick to seconds (binary search, O(log n))
+    double ticksToSeconds(uint32_t tick) const;
+
+    // Same, for ascending ticks: segment carries the position between calls
+    double ticksToSeconds(uint32_t tick, size_t& segment) const;
+};
+
+// Paired notes in struct-of-arrays form, sorted by start time. Each column
+// is contiguous so analysis can run as linear scans without re-pairing.
+struct NoteTable {
+    std::vector<uint8_t> pitch;
+    std::vector<uint8_t> channel;
+    std::vector<uint8_t> velocity;
+    std::vector<uint32_t> startTick;
+    std::vector<uint32_t> endTick;
+    std::vector<double> startTime;
+    std::vector<double> endTime;
+
+    size_t size() const { return pitch.size(); }
+    bool empty() const { return pitch.empty(); }
+    void clear();
+    void reserve(size_t count);
+
+    // Pair note-on/off events from all tracks and sort by start tick
+    void build(const std::vector<MIDITrack>& tracks, const TempoMap& tempoMap);
+
+    // Index of the first note starting at or after time
+    size_t lowerBound(double time) const;
+
+private:
+    void append(uint8_t notePitch, uint8_t noteChannel, uint8_t noteVelocity,
+                uint32_t start, uint32_t end);
 };
 
 // Complete MIDI File
 struct MIDIFile {
     MIDIHeader header;
     std::vector<MIDITrack> tracks;
-    double tempo;           // BPM
+    TempoMap tempoMap;
+    std::vector<KeySignature> keySignatures;     // All tracks, sorted by tick
+    std::vector<TimeSignature> timeSignatures;   // All tracks, sorted by tick
+    NoteTable notes;        // Filled when MIDIParser::setBuildNoteTable is on
+    double tempo;           // BPM of the first tempo event (120 if none)
     std::string filePath;
+    uint64_t contentHash;   // hashContent() of the raw file bytes
 
-    MIDIFile() : tempo(120.0) {}
+    // Bytes the track names and meta payloads point into. Null when the
+    // caller supplied the buffer and keeps it alive itself.
+    std::shared_ptr<const MappedFile> source;
+
+    MIDIFile() : tempo(120.0), contentHash(0) {}
 
     // Get all note events across all tracks
     std::vector<MIDIEvent> getAllNoteEvents() const;
@@ -69,33 +214,142 @@ struct MIDIFile {
 
     // Get total duration in seconds
     double getDuration() const;
+
+    // Unmap the source together with the track names and meta events that
+    // point into it. Events, notes and the tempo map stay valid, and the
+    // vectors keep their capacity for the next parse.
+    void releaseSource();
+};
+
+// Library listing info gathered in one pass without materializing events
+struct MIDIProbe {
+    MIDIHeader header;
+    double tempo;                       // BPM of the first tempo event (120 if none)
+    uint8_t timeSignatureNumerator;
+    uint8_t timeSignatureDenominator;
+    int firstProgram;                   // First program change, -1 if none
+    std::vector<std::string> trackNames;
+    uint32_t noteCount;                 // Note-ons with non-zero velocity
+    double duration;                    // Seconds to the last channel event
+    uint64_t contentHash;               // hashContent() of the raw file bytes
+
+    MIDIProbe() : tempo(120.0), timeSignatureNumerator(4), timeSignatureDenominator(4),
+                  firstProgram(-1), noteCount(0), duration(0.0), contentHash(0) {}
 };
 
 // MIDI Parser Class
 class MIDIParser {
 public:
+    // Called once per file by parseBatch. The MIDIFile is reused for the next
+    // path, so it is only valid during the call and only when parsed is true
+    // (getLastError() explains a failure). Return false to stop the batch.
+    using BatchCallback = std::function<bool(size_t index, const MIDIFile& midiFile, bool parsed)>;
+
     MIDIParser();
     ~MIDIParser();
 
-    // Parse MIDI file from path
+    // Parse MIDI file from path (memory-mapped, decoded in place)
     bool parse(const std::string& filePath, MIDIFile& midiFile);
 
+    // Parse bytes owned by a shared source; the MIDIFile keeps it alive
+    bool parse(std::shared_ptr<const MappedFile> source, MIDIFile& midiFile);
+
+    // Parse a caller-supplied buffer without copying it. Track names and meta
+    // payloads point into the buffer, so it must outlive the MIDIFile.
+    bool parse(const uint8_t* data, size_t size, MIDIFile& midiFile);
+
+    // Parse many files through one reused MIDIFile. Parsing into the same
+    // MIDIFile keeps track and event capacity, so after the first few files
+    // a batch decodes into recycled storage. Returns the number parsed.
+    size_t parseBatch(const std::vector<std::string>& filePaths, const BatchCallback& callback);
+
+    // Read only header info, tempo, time signature, first program change,
+    // track names and note count - note payloads are skipped, not stored
+    bool probe(const std::string& filePath, MIDIProbe& result);
+    bool probe(const uint8_t* data, size_t size, MIDIProbe& result);
+
+    // Also build MIDIFile::notes while parsing
+    void setBuildNoteTable(bool enabled) { buildNoteTable = enabled; }
+
+    // Select stored event types (ParseOptions flags, default ParseEverything)
+    void setParseOptions(uint32_t options) { parseOptions = options; }
+    uint32_t getParseOptions() const { return parseOptions; }
+
+    // Buffers of at least this many bytes with more than one track have their
+    // tracks decoded on worker threads (0 = always, SIZE_MAX = never)
+    static constexpr size_t kDefaultParallelThreshold = 1024 * 1024;
+    void setParallelThreshold(size_t bytes) { parallelThreshold = bytes; }
+
+    // Upper bound on decode threads (default: hardware concurrency)
+    void setMaxDecodeThreads(unsigned count) { maxDecodeThreads = count; }
+
     // Get last error message
     std::string getLastError() const { return lastError; }
 
 private:
+    friend class StreamingParser;   // Shares header validation
+
+    // Byte range of one MTrk chunk's events
+    struct TrackRange {
+        size_t begin;
+        size_t end;
+    };
+
+    // Tempo and signature events found in one track. Tracks are decoded
+    // independently, so these are merged into the MIDIFile in track order.
+    struct TrackSignals {
+        std::vector<TempoChange> tempoChanges;
+        std::vector<KeySignature> keySignatures;
+        std::vector<TimeSignature> timeSignatures;
+
+        void clear() {
+            tempoChanges.clear();
+            keySignatures.clear();
+            timeSignatures.clear();
+        }
+    };
+
     std::string lastError;
+    bool buildNoteTable;
+    uint32_t parseOptions;
+    size_t parallelThreshold;
+    unsigned maxDecodeThreads;
+
+    // Per-parse scratch, kept for its capacity
+    std::vector<TrackRange> trackRanges;
+    std::vector<TrackSignals> trackSignals;
 
     // Internal parsing methods
+    bool parseBuffer(const uint8_t* data, size_t size, MIDIFile& midiFile);
     bool parseHeader(const uint8_t* data, size_t size, MIDIHeader& header, size_t& offset);
-    bool parseTrack(const uint8_t* data, size_t size, MIDITrack& track, size_t& offset, uint16_t division);
-    uint32_t readVariableLength(const uint8_t* data, size_t& offset);
+    bool openTrackChunk(const uint8_t* data, size_t size, size_t& offset, size_t& trackEnd);
+    bool locateTracks(const uint8_t* data, size_t size, size_t offset, uint16_t trackCount);
+    bool parseTrack(const uint8_t* data, const TrackRange& range, MIDITrack& track,
+                    TrackSignals& signals) const;
+    size_t parseTracksParallel(const uint8_t* data, MIDIFile& midiFile, unsigned threadCount);
+    void applyTimestamps(MIDITrack& track, const TempoMap& tempoMap) const;
+    bool probeTrack(const uint8_t* data, size_t size, size_t& offset, TempoMap& tempoMap,
+                    MIDIProbe& result, uint32_t& lastTick, uint32_t& timeSignatureTick);
     uint32_t read32BitValue(const uint8_t* data, size_t& offset);
     uint16_t read16BitValue(const uint8_t* data, size_t& offset);
-    uint8_t read8BitValue(const uint8_t* data, size_t& offset);
 
-    // Convert MIDI ticks to seconds
-    double ticksToSeconds(uint32_t ticks, uint16_t division, double tempo) const;
+    // Channel, meta or SysEx event as stored in the chunk, payload in place
+    struct RawEvent {
+        uint32_t delta;
+        uint8_t status;         // 0 for a stray data byte that was dropped
+        uint8_t data1;
+        uint8_t data2;
+        uint8_t metaType;
+        size_t payloadOffset;   // Meta/SysEx payload, already bounds-checked
+        uint32_t payloadLength;
+    };
+
+    // Decode one event, never reading past end. False if truncated or malformed.
+    static bool readNextEvent(const uint8_t* data, size_t& offset, size_t end,
+                              uint8_t& runningStatus, RawEvent& event);
+    template <bool Checked>
+    static bool decodeEvent(const uint8_t* data, size_t& offset, size_t end,
+                            uint8_t& runningStatus, RawEvent& event);
 };
 
 } // namespace MIDIScaleDetector
@@ -0,0 +1,356 @@
+#include "MIDIWriter.h"
+#include <algorithm>
+
+namespace MIDIScaleDetector {
+
+namespace {
+    constexpr uint32_t kMaxVariableLength = 0x0FFFFFFF;    // Four VLQ bytes
+}
+
+MIDIWriter::MIDIWriter() : lastError(""), out(nullptr), lastTick(0), runningStatus(0) {}
+
+bool MIDIWriter::write(const MIDIFile& midiFile, uint16_t format, std::vector<uint8_t>& buffer) {
+    if (format > 1) {
+        lastError = "Only format 0 and format 1 files can be written";
+        return false;
+    }
+    if (midiFile.tracks.size() > 0xFFFF) {
+        lastError = "Too many tracks for a MIDI file";
+        return false;
+    }
+
+    out = &buffer;
+    buffer.clear();
+
+    // Files parsed without meta events still carry their tempo map and signatures
+    bool hasMetaEvents = std::any_of(midiFile.tracks.begin(), midiFile.tracks.end(),
+                                     [](const MIDITrack& track) { return !track.metaEvents.empty(); });
+    conductor.clear();
+    if (!hasMetaEvents) {
+        buildConductor(midiFile);
+    }
+
+    const size_t trackCount = midiFile.tracks.size();
+    if (format == 0 || trackCount == 0) {
+        writeHeader(0, 1, midiFile.header.division);
+        return writeMergedTrack(midiFile, 0, trackCount, true);
+    }
+
+    writeHeader(1, static_cast<uint16_t>(trackCount), midiFile.header.division);
+    for (size_t i = 0; i < trackCount; ++i) {
+        if (!writeMergedTrack(midiFile, i, i + 1, i == 0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool MIDIWriter::write(const NoteTable& notes, const TempoMap& tempoMap, std::vector<uint8_t>& buffer) {
+    out = &buffer;
+    buffer.clear();
+    buildTempoConductor(tempoMap);
+
+    writeHeader(0, 1, tempoMap.division);
+    size_t lengthOffset = beginTrack();
+
+    // Note-offs wait in a min-heap until the next note-on passes them
+    auto laterOff = [](const NoteOff& a, const NoteOff& b) { return a.tick > b.tick; };
+    pendingOffs.clear();
+    size_t nextConductor = 0;
+
+    // Conductor events, then note-offs, up to and including tick
+    auto flushUntil = [&](uint32_t tick) {
+        for (;;) {
+            bool conductorDue = nextConductor < conductor.size() && conductor[nextConductor].tick <= tick;
+            bool offDue = !pendingOffs.empty() && pendingOffs.front().tick <= tick;
+            if (conductorDue && (!offDue || conductor[nextConductor].tick <= pendingOffs.front().tick)) {
+                const ConductorEvent& event = conductor[nextConductor++];
+                if (!writeMeta(event.tick, event.type, event.data, event.length)) {
+                    return false;
+                }
+            } else if (offDue) {
+                std::pop_heap(pendingOffs.begin(), pendingOffs.end(), laterOff);
+                const NoteOff& off = pendingOffs.back();
+                MIDIEvent event;
+                event.tick = off.tick;
+                event.type = EventType::NoteOff;
+                event.channel = off.channel;
+                event.note = off.pitch;
+                event.velocity = 0;
+                pendingOffs.pop_back();
+                if (!writeChannelEvent(event)) {
+                    return false;
+                }
+            } else {
+                return true;
+            }
+        }
+    };
+
+    for (size_t i = 0; i < notes.size(); ++i) {
+        // Ends at the same tick go out first so a repeated pitch retriggers cleanly
+        if (!flushUntil(notes.startTick[i])) {
+            return false;
+        }
+
+        MIDIEvent event;
+        event.tick = notes.startTick[i];
+        event.type = EventType::NoteOn;
+        event.channel = notes.channel[i];
+        event.note = notes.pitch[i];
+        event.velocity = notes.velocity[i] > 0 ? notes.velocity[i] : 1;
+        if (!writeChannelEvent(event)) {
+            return false;
+        }
+
+        pendingOffs.push_back({std::max(notes.endTick[i], notes.startTick[i]), notes.channel[i], notes.pitch[i]});
+        std::push_heap(pendingOffs.begin(), pendingOffs.end(), laterOff);
+    }
+
+    if (!flushUntil(UINT32_MAX)) {
+        return false;
+    }
+
+    return endTrack(lengthOffset, 0);
+}
+
+void MIDIWriter::writeHeader(uint16_t format, uint16_t trackCount, uint16_t division) {
+    const uint8_t header[14] = {
+        'M', 'T', 'h', 'd', 0, 0, 0, 6,
+        static_cast<uint8_t>(format >> 8), static_cast<uint8_t>(format),
+        static_cast<uint8_t>(trackCount >> 8), static_cast<uint8_t>(trackCount),
+        static_cast<uint8_t>(division >> 8), static_cast<uint8_t>(division)
+    };
+    out->insert(out->end(), header, header + sizeof(header));
+}
+
+size_t MIDIWriter::beginTrack() {
+    // Length is patched in by endTrack once the events are written
+    const uint8_t chunk[8] = {'M', 'T', 'r', 'k', 0, 0, 0, 0};
+    out->insert(out->end(), chunk, chunk + sizeof(chunk));
+    lastTick = 0;
+    runningStatus = 0;
+    return out->size() - 4;
+}
+
+bool MIDIWriter::endTrack(size_t lengthOffset, uint32_t endTick) {
+    // End of Track at the source's end tick, or the last event's if that is later
+    if (!writeDelta(std::max(endTick, lastTick))) {
+        return false;
+    }
+    const uint8_t endOfTrack[3] = {0xFF, 0x2F, 0x00};
+    out->insert(out->end(), endOfTrack, endOfTrack + sizeof(endOfTrack));
+
+    uint32_t length = static_cast<uint32_t>(out->size() - lengthOffset - 4);
+    (*out)[lengthOffset] = static_cast<uint8_t>(length >> 24);
+    (*out)[lengthOffset + 1] = static_cast<uint8_t>(length >> 16);
+    (*out)[lengthOffset + 2] = static_cast<uint8_t>(length >> 8);
+    (*out)[lengthOffset + 3] = static_cast<uint8_t>(length);
+    return true;
+}
+
+bool MIDIWriter::writeMergedTrack(const MIDIFile& midiFile, size_t firstTrack, size_t lastTrack,
+                                  bool withConductor) {
+    size_t lengthOffset = beginTrack();
+    const auto& tracks = midiFile.tracks;
+
+    // One head per non-empty source; each source is already in tick order
+    // Min-heap on (tick, kind, track): at one tick conductor, then meta, then channel events
+    auto later = [](const Head& a, const Head& b) {
+        if (a.tick != b.tick) return a.tick > b.tick;
+        if (a.kind != b.kind) return a.kind > b.kind;
+        return a.track > b.track;
+    };
+    heads.clear();
+    eventPositions.assign(tracks.size(), 0);
+    metaPositions.assign(tracks.size(), 0);
+    size_t nextConductor = 0;
+
+    if (withConductor && !conductor.empty()) {
+        heads.push_back({conductor[0].tick, 0, 0});
+    }
+    for (size_t t = firstTrack; t < lastTrack; ++t) {
+        if (!tracks[t].metaEvents.empty()) {
+            heads.push_back({tracks[t].metaEvents[0].tick, 1, static_cast<uint32_t>(t)});
+        }
+        if (!tracks[t].events.empty()) {
+            heads.push_back({tracks[t].events[0].tick, 2, static_cast<uint32_t>(t)});
+        }
+    }
+    std::make_heap(heads.begin(), heads.end(), later);
+
+    uint32_t endTick = 0;
+    for (size_t t = firstTrack; t < lastTrack; ++t) {
+        endTick = std::max(endTick, tracks[t].endTick);
+    }
+
+    const bool merging = lastTrack - firstTrack > 1;
+
+    while (!heads.empty()) {
+        std::pop_heap(heads.begin(), heads.end(), later);
+        Head head = heads.back();
+        heads.pop_back();
+
+        bool written = true;
+        if (head.kind == 0) {
+            const ConductorEvent& event = conductor[nextConductor++];
+            written = writeMeta(event.tick, event.type, event.data, event.length);
+            if (nextConductor < conductor.size()) {
+                heads.push_back({conductor[nextConductor].tick, 0, 0});
+                std::push_heap(heads.begin(), heads.end(), later);
+            }
+        } else if (head.kind == 1) {
+            const auto& metaEvents = tracks[head.track].metaEvents;
+            const MIDIMetaEvent& meta = metaEvents[metaPositions[head.track]++];
+
+            // Merged into one track, only the first track's name survives
+            bool skip = meta.type == 0x2F || (merging && meta.type == 0x03 && head.track != firstTrack);
+            if (!skip) {
+                written = writeMeta(meta.tick, meta.type,
+                                    reinterpret_cast<const uint8_t*>(meta.data.data()), meta.data.size());
+            }
+            if (metaPositions[head.track] < metaEvents.size()) {
+                heads.push_back({metaEvents[metaPositions[head.track]].tick, 1, head.track});
+                std::push_heap(heads.begin(), heads.end(), later);
+            }
+        } else {
+            const auto& events = tracks[head.track].events;
+            written = writeChannelEvent(events[eventPositions[head.track]++]);
+            if (eventPositions[head.track] < events.size()) {
+                heads.push_back({events[eventPositions[head.track]].tick, 2, head.track});
+                std::push_heap(heads.begin(), heads.end(), later);
+            }
+        }
+
+        if (!written) {
+            return false;
+        }
+    }
+
+    return endTrack(lengthOffset, endTick);
+}
+
+void MIDIWriter::buildConductor(const MIDIFile& midiFile) {
+    buildTempoConductor(midiFile.tempoMap);
+
+    for (const auto& signature : midiFile.timeSignatures) {
+        // Denominator is stored as a power of two
+        uint8_t power = 0;
+        while (power < 7 && (1u << power) < signature.denominator) {
+            ++power;
+        }
+        conductor.push_back({signature.tick, 0x58, 4,
+                             {signature.numerator, power, signature.clocksPerClick,
+                              signature.thirtySecondsPerQuarter}});
+    }
+    for (const auto& signature : midiFile.keySignatures) {
+        conductor.push_back({signature.tick, 0x59, 2,
+                             {static_cast<uint8_t>(signature.sharpsFlats),
+                              static_cast<uint8_t>(signature.minor ? 1 : 0), 0, 0}});
+    }
+
+    std::sort(conductor.begin(), conductor.end(), [](const ConductorEvent& a, const ConductorEvent& b) {
+        return a.tick != b.tick ? a.tick < b.tick : a.type < b.type;
+    });
+}
+
+void MIDIWriter::buildTempoConductor(const TempoMap& tempoMap) {
+    conductor.clear();
+
+    // SMPTE timing ignores tempo, so there is nothing to write
+    if (tempoMap.secondsPerSMPTETick > 0.0) {
+        return;
+    }
+    for (const auto& change : tempoMap.changes) {
+        uint32_t tempo = change.microsecondsPerQuarter;
+        conductor.push_back({change.tick, 0x51, 3,
+                             {static_cast<uint8_t>(tempo >> 16), static_cast<uint8_t>(tempo >> 8),
+                              static_cast<uint8_t>(tempo), 0}});
+    }
+}
+
+bool MIDIWriter::writeDelta(uint32_t tick) {
+    if (tick < lastTick) {
+        lastError = "Events are not in tick order";
+        return false;
+    }
+    if (tick - lastTick > kMaxVariableLength) {
+        lastError = "Delta time too large for a MIDI file";
+        return false;
+    }
+    writeVariableLength(tick - lastTick);
+    lastTick = tick;
+    return true;
+}
+
+bool MIDIWriter::writeChannelEvent(const MIDIEvent& event) {
+    uint8_t status;
+    bool hasSecondByte = true;
+
+    switch (event.type) {
+        case EventType::NoteOn:
+            status = 0x90;
+            break;
+        case EventType::NoteOff:
+            // Velocity 0 note-on is equivalent and keeps running status going
+            status = event.velocity == 0 ? 0x90 : 0x80;
+            break;
+        case EventType::ControlChange:
+            status = 0xB0;
+            break;
+        case EventType::ProgramChange:
+            status = 0xC0;
+            hasSecondByte = false;
+            break;
+        default:
+            // Tempo and signatures are written as meta events
+            return true;
+    }
+    status |= event.channel & 0x0F;
+
+    if (!writeDelta(event.tick)) {
+        return false;
+    }
+    if (status != runningStatus) {
+        out->push_back(status);
+        runningStatus = status;
+    }
+    out->push_back(event.note & 0x7F);
+    if (hasSecondByte) {
+        out->push_back(event.velocity & 0x7F);
+    }
+    return true;
+}
+
+bool MIDIWriter::writeMeta(uint32_t tick, uint8_t type, const uint8_t* data, size_t length) {
+    if (length > kMaxVariableLength) {
+        lastError = "Meta event too large for a MIDI file";
+        return false;
+    }
+    if (!writeDelta(tick)) {
+        return false;
+    }
+
+    out->push_back(0xFF);
+    out->push_back(type);
+    writeVariableLength(static_cast<uint32_t>(length));
+    out->insert(out->end(), data, data + length);
+
+    // Readers cancel running status after a meta event
+    runningStatus = 0;
+    return true;
+}
+
+void MIDIWriter::writeVariableLength(uint32_t value) {
+    uint8_t buffer[4];
+    int count = 0;
+    buffer[count++] = value & 0x7F;
+    while ((value >>= 7) > 0) {
+        buffer[count++] = 0x80 | (value & 0x7F);
+    }
+    while (count > 0) {
+        out->push_back(buffer[--count]);
+    }
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MIDIParser.h"
+
+namespace MIDIScaleDetector {
+
+// Serializes parsed data back to Standard MIDI File bytes. Output goes into a
+// caller-owned buffer that is cleared but keeps its capacity, and the writer's
+// own merge state is recycled too, so a batch export only allocates while
+// buffers are still growing.
+//
+// Channel events are written with running status, and note-offs with zero
+// velocity become note-on/velocity 0 so long note runs share one status byte.
+class MIDIWriter {
+public:
+    MIDIWriter();
+
+    // Write a parsed file as format 0 (all tracks merged into one) or format 1
+    // (one chunk per track). Meta events are written from each track; a file
+    // parsed without ParseMetaEvents gets its tempo map and signatures
+    // written into the first track instead. End of Track keeps the source's
+    // tick, so a trailing rest survives the round trip.
+    bool write(const MIDIFile& midiFile, uint16_t format, std::vector<uint8_t>& buffer);
+
+    // Write paired notes as a single-track format 0 file. tempoMap supplies
+    // the division and tempo changes, and usually comes from the same MIDIFile.
+    bool write(const NoteTable& notes, const TempoMap& tempoMap, std::vector<uint8_t>& buffer);
+
+    // Get last error message
+    std::string getLastError() const { return lastError; }
+
+private:
+    // Tempo, time and key signature rebuilt from the parsed MIDIFile fields
+    struct ConductorEvent {
+        uint32_t tick;
+        uint8_t type;
+        uint8_t length;
+        uint8_t data[4];
+    };
+
+    // Next unwritten item of one source, ordered by (tick, kind, track)
+    struct Head {
+        uint32_t tick;
+        uint8_t kind;       // 0 = conductor, 1 = meta, 2 = channel event
+        uint32_t track;
+    };
+
+    // Pending note-off for the NoteTable writer, ordered by tick
+    struct NoteOff {
+        uint32_t tick;
+        uint8_t channel;
+        uint8_t pitch;
+    };
+
+    std::string lastError;
+    std::vector<uint8_t>* out;
+    uint32_t lastTick;
+    uint8_t runningStatus;
+
+    // Recycled between writes
+    std::vector<ConductorEvent> conductor;
+    std::vector<size_t> eventPositions;
+    std::vector<size_t> metaPositions;
+    std::vector<Head> heads;
+    std::vector<NoteOff> pendingOffs;
+
+    void writeHeader(uint16_t format, uint16_t trackCount, uint16_t division);
+    size_t beginTrack();
+    bool endTrack(size_t lengthOffset, uint32_t endTick);
+    bool writeMergedTrack(const MIDIFile& midiFile, size_t firstTrack, size_t lastTrack,
+                          bool withConductor);
+    void buildConductor(const MIDIFile& midiFile);
+    void buildTempoConductor(const TempoMap& tempoMap);
+
+    bool writeDelta(uint32_t tick);
+    bool writeChannelEvent(const MIDIEvent& event);
+    bool writeMeta(uint32_t tick, uint8_t type, const uint8_t* data, size_t length);
+    void writeVariableLength(uint32_t value);
+};
+
+} // namespace MIDIScaleDetector
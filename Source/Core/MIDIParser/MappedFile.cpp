@@ -0,0 +1,107 @@
+#include "MappedFile.h"
+#include "ZipArchive.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace MIDIScaleDetector {
+
+MappedFile::MappedFile() : bytes(nullptr), length(0), mapping(nullptr) {}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+    if (mapping != nullptr) {
+        munmap(mapping, length);
+    }
+#endif
+}
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filePath, std::string& error) {
+    // Entry inside a zip archive - inflate it into an owned buffer
+    std::string archivePath;
+    std::string entryName;
+    if (ZipArchive::splitPath(filePath, archivePath, entryName)) {
+        ZipArchive archive;
+        std::vector<uint8_t> buffer;
+        const ZipEntry* entry = archive.open(archivePath) ? archive.findEntry(entryName) : nullptr;
+        if (entry == nullptr || !archive.extract(*entry, buffer)) {
+            error = archive.getLastError().empty() ? "Failed to open file: " + filePath
+                                                   : archive.getLastError();
+            return nullptr;
+        }
+        return fromBuffer(std::move(buffer));
+    }
+
+#ifndef _WIN32
+    int fd = ::open(filePath.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "Failed to open file: " + filePath;
+        return nullptr;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        ::close(fd);
+        error = "Failed to read file: " + filePath;
+        return nullptr;
+    }
+
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+    // mmap rejects zero-length mappings; an empty file is just an empty buffer
+    if (info.st_size > 0) {
+        void* address = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            error = "Failed to map file: " + filePath;
+            return nullptr;
+        }
+
+        // Whole file is decoded front to back
+        madvise(address, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+        file->mapping = address;
+        file->bytes = static_cast<const uint8_t*>(address);
+        file->length = static_cast<size_t>(info.st_size);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    ::close(fd);
+
+    return file;
+#else
+    // No mapping support on this platform - read into an owned buffer
+    std::ifstream stream(filePath, std::ios::binary | std::ios::ate);
+    if (!stream.is_open()) {
+        error = "Failed to open file: " + filePath;
+        return nullptr;
+    }
+
+    std::streamsize fileSize = stream.tellg();
+    stream.seekg(0, std::ios::beg);
+
+    std::vector<uint8_t> buffer(static_cast<size_t>(fileSize));
+    if (!stream.read(reinterpret_cast<char*>(buffer.data()), fileSize)) {
+        error = "Failed to read file: " + filePath;
+        return nullptr;
+    }
+
+    return fromBuffer(std::move(buffer));
+#endif
+}
+
+std::shared_ptr<const MappedFile> MappedFile::fromBuffer(std::vector<uint8_t> buffer) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->owned = std::move(buffer);
+    file->bytes = file->owned.data();
+    file->length = file->owned.size();
+    return file;
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace MIDIScaleDetector {
+
+// Read-only byte source for the parser. Files on disk are memory-mapped so
+// they can be decoded without an intermediate copy; the mapping is released
+// when the last owner (usually a MIDIFile) goes away.
+class MappedFile {
+public:
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Map a file from disk. Returns nullptr and sets error on failure.
+    // "pack.zip!/inner/file.mid" paths are inflated into a heap buffer.
+    static std::shared_ptr<const MappedFile> open(const std::string& filePath, std::string& error);
+
+    // Wrap bytes that already live in memory (takes ownership)
+    static std::shared_ptr<const MappedFile> fromBuffer(std::vector<uint8_t> buffer);
+
+    const uint8_t* data() const { return bytes; }
+    size_t size() const { return length; }
+
+    // True if the bytes come from an OS mapping rather than a heap buffer
+    bool isMapped() const { return mapping != nullptr; }
+
+private:
+    MappedFile();
+
+    const uint8_t* bytes;
+    size_t length;
+    void* mapping;
+    std::vector<uint8_t> owned;
+};
+
+} // namespace MIDIScaleDetector
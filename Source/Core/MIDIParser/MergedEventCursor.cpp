@@ -0,0 +1,85 @@
+#include "MergedEventCursor.h"
+#include <algorithm>
+
+namespace MIDIScaleDetector {
+
+namespace {
+    // std heap functions build a max-heap; invert to keep the earliest on top.
+    // Equal ticks come out in track order.
+    struct LaterHead {
+        template <typename Head>
+        bool operator()(const Head& a, const Head& b) const {
+            return a.tick != b.tick ? a.tick > b.tick : a.track > b.track;
+        }
+    };
+
+    bool isNoteEvent(const MIDIEvent& event) {
+        return event.type == EventType::NoteOn || event.type == EventType::NoteOff;
+    }
+}
+
+MergedEventCursor::MergedEventCursor(const MIDIFile& midiFile, bool onlyNotes)
+    : tracks(midiFile.tracks), notesOnly(onlyNotes), positions(midiFile.tracks.size(), 0) {
+    heap.reserve(tracks.size());
+    rewind();
+}
+
+void MergedEventCursor::seek(double time) {
+    heap.clear();
+
+    for (size_t track = 0; track < tracks.size(); ++track) {
+        const auto& events = tracks[track].events;
+        auto first = std::lower_bound(events.begin(), events.end(), time,
+                                      [](const MIDIEvent& event, double t) {
+                                          return event.timestamp < t;
+                                      });
+        positions[track] = static_cast<size_t>(first - events.begin());
+        skipFiltered(track);
+        pushHead(track);
+    }
+}
+
+const MIDIEvent& MergedEventCursor::current() const {
+    const Head& head = heap.front();
+    return tracks[head.track].events[positions[head.track]];
+}
+
+bool MergedEventCursor::next() {
+    if (heap.empty()) {
+        return false;
+    }
+
+    std::pop_heap(heap.begin(), heap.end(), LaterHead());
+    size_t track = heap.back().track;
+    heap.pop_back();
+
+    positions[track]++;
+    skipFiltered(track);
+    pushHead(track);
+
+    return !heap.empty();
+}
+
+void MergedEventCursor::skipFiltered(size_t track) {
+    if (!notesOnly) {
+        return;
+    }
+
+    const auto& events = tracks[track].events;
+    size_t& position = positions[track];
+    while (position < events.size() && !isNoteEvent(events[position])) {
+        position++;
+    }
+}
+
+void MergedEventCursor::pushHead(size_t track) {
+    const auto& events = tracks[track].events;
+    if (positions[track] >= events.size()) {
+        return;
+    }
+
+    heap.push_back({events[positions[track]].tick, static_cast<uint32_t>(track)});
+    std::push_heap(heap.begin(), heap.end(), LaterHead());
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include "MIDIParser.h"
+
+namespace MIDIScaleDetector {
+
+// Walks the events of every track in global time order. Tracks are already
+// sorted, so they are merged on the fly through a heap holding one head per
+// track instead of being copied into one vector and sorted. The cursor
+// reads the MIDIFile in place and must not outlive it.
+class MergedEventCursor {
+public:
+    explicit MergedEventCursor(const MIDIFile& midiFile, bool notesOnly = false);
+
+    // Position on the first event at or after time (seconds)
+    void seek(double time);
+
+    // Back to the first event of the file
+    void rewind() { seek(0.0); }
+
+    bool atEnd() const { return heap.empty(); }
+
+    // Event under the cursor; only valid when !atEnd()
+    const MIDIEvent& current() const;
+
+    // Index of the track the current event belongs to
+    size_t currentTrack() const { return heap.front().track; }
+
+    // Step to the next event in global order. Returns false at the end.
+    bool next();
+
+private:
+    struct Head {
+        uint32_t tick;
+        uint32_t track;
+    };
+
+    const std::vector<MIDITrack>& tracks;
+    bool notesOnly;
+    std::vector<size_t> positions;  // Next unread event per track
+    std::vector<Head> heap;         // Min-heap on (tick, track)
+
+    void skipFiltered(size_t track);
+    void pushHead(size_t track);
+};
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,304 @@
+#include "StreamingParser.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+namespace MIDIScaleDetector {
+
+// Sliding window over the file. Reads refill the buffer from the stream;
+// skips past the buffered bytes seek instead of reading.
+class StreamingParser::Window {
+public:
+    Window(std::ifstream& fileStream, std::vector<uint8_t>& storage)
+        : stream(fileStream), buffer(storage), start(0), end(0), base(0) {}
+
+    // Absolute file offset of the next unread byte
+    uint64_t position() const { return base + start; }
+
+    void seek(uint64_t offset) {
+        stream.clear();
+        stream.seekg(static_cast<std::streamoff>(offset));
+        base = offset;
+        start = end = 0;
+    }
+
+    bool byte(uint8_t& value) {
+        if (start == end && !refill(1)) {
+            return false;
+        }
+        value = buffer[start++];
+        return true;
+    }
+
+    // Make count bytes contiguous in the buffer (count <= window size)
+    const uint8_t* view(size_t count) {
+        if (end - start < count && !refill(count)) {
+            return nullptr;
+        }
+        const uint8_t* data = buffer.data() + start;
+        start += count;
+        return data;
+    }
+
+    bool skip(uint64_t count) {
+        if (count <= end - start) {
+            start += static_cast<size_t>(count);
+            return true;
+        }
+        seek(position() + count);
+        return true;
+    }
+
+private:
+    std::ifstream& stream;
+    std::vector<uint8_t>& buffer;
+    size_t start;
+    size_t end;
+    uint64_t base;      // File offset of buffer[0]
+
+    bool refill(size_t needed) {
+        // Move the unread tail to the front and top up from the file
+        size_t remaining = end - start;
+        std::memmove(buffer.data(), buffer.data() + start, remaining);
+        base += start;
+        start = 0;
+        end = remaining;
+
+        stream.read(reinterpret_cast<char*>(buffer.data() + end),
+                    static_cast<std::streamsize>(buffer.size() - end));
+        end += static_cast<size_t>(stream.gcount());
+
+        return end >= needed;
+    }
+};
+
+StreamingParser::StreamingParser(size_t windowSize)
+    : buffer(std::max<size_t>(windowSize, 64)), parseOptions(ParseEverything),
+      tempo(120.0), duration(0.0) {}
+
+bool StreamingParser::parse(const std::string& filePath, MIDIEventVisitor& visitor) {
+    header = MIDIHeader();
+    tempo = 120.0;
+    duration = 0.0;
+
+    std::ifstream stream(filePath, std::ios::binary);
+    if (!stream.is_open()) {
+        lastError = "Failed to open file: " + filePath;
+        return false;
+    }
+
+    Window window(stream, buffer);
+
+    // Header - validated by the regular parser
+    const uint8_t* headerBytes = window.view(14);
+    if (headerBytes == nullptr) {
+        lastError = "File too small to contain MIDI header";
+        return false;
+    }
+    MIDIParser headerParser;
+    size_t offset = 0;
+    if (!headerParser.parseHeader(headerBytes, 14, header, offset)) {
+        lastError = headerParser.getLastError();
+        return false;
+    }
+
+    // First pass: tempo events only
+    tempoMap.reset(header.division);
+    if (!readTracks(window, nullptr)) {
+        return false;
+    }
+
+    const auto& changes = tempoMap.changes;
+    auto firstChange = std::min_element(changes.begin(), changes.end(),
+                                        [](const TempoChange& a, const TempoChange& b) {
+                                            return a.tick < b.tick;
+                                        });
+    tempo = (firstChange == changes.end()) ? 120.0 : firstChange->getBPM();
+    tempoMap.finalize();
+
+    // Second pass: events with timestamps
+    window.seek(14);
+    visitor.beginFile(header, tempoMap);
+    return readTracks(window, &visitor);
+}
+
+bool StreamingParser::readTracks(Window& window, MIDIEventVisitor* visitor) {
+    uint32_t lastTick = 0;
+
+    for (uint16_t i = 0; i < header.trackCount; ++i) {
+        // Chunk header; chunks other than MTrk are skipped
+        for (;;) {
+            const uint8_t* chunk = window.view(8);
+            if (chunk == nullptr) {
+                lastError = "Unexpected end of file while parsing track";
+                return false;
+            }
+
+            uint32_t chunkLength = (static_cast<uint32_t>(chunk[4]) << 24) | (chunk[5] << 16) |
+                                   (chunk[6] << 8) | chunk[7];
+            if (std::memcmp(chunk, "MTrk", 4) == 0) {
+                uint64_t trackEnd = window.position() + chunkLength;
+                if (visitor != nullptr) {
+                    visitor->beginTrack(i);
+                }
+                if (!readTrack(window, trackEnd, i, visitor, lastTick)) {
+                    lastError = "Failed to parse track " + std::to_string(i) + ": " + lastError;
+                    return false;
+                }
+                break;
+            }
+            window.skip(chunkLength);
+        }
+    }
+
+    if (visitor != nullptr) {
+        duration = tempoMap.ticksToSeconds(lastTick);
+    }
+    return true;
+}
+
+bool StreamingParser::readTrack(Window& window, uint64_t trackEnd, size_t trackIndex,
+                                MIDIEventVisitor* visitor, uint32_t& lastTick) {
+    uint32_t currentTick = 0;
+    uint32_t trackLastTick = 0;
+    uint8_t runningStatus = 0;
+    size_t segment = 0;
+
+    // Every read is checked against the end of the chunk
+    auto readByte = [&](uint8_t& value) {
+        return window.position() < trackEnd && window.byte(value);
+    };
+    auto readVariableLength = [&](uint32_t& value) {
+        value = 0;
+        for (int i = 0; i < 4; ++i) {
+            uint8_t next;
+            if (!readByte(next)) {
+                return false;
+            }
+            value = (value << 7) | (next & 0x7F);
+            if ((next & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    while (window.position() < trackEnd) {
+        uint32_t delta;
+        uint8_t status;
+        if (!readVariableLength(delta) || !readByte(status)) {
+            lastError = "Truncated or malformed event";
+            return false;
+        }
+        currentTick += delta;
+
+        bool runningData = (status & 0x80) == 0;
+        if (runningData && runningStatus == 0) {
+            // Stray data byte with no status to run on - drop it
+            continue;
+        }
+
+        if (runningData || status < 0xF0) {
+            uint8_t data1 = status;
+            if (!runningData) {
+                runningStatus = status;
+                if (!readByte(data1)) {
+                    lastError = "Truncated or malformed event";
+                    return false;
+                }
+            }
+            status = runningStatus;
+
+            uint8_t type = status & 0xF0;
+            uint8_t data2 = 0;
+            if (type != 0xC0 && type != 0xD0 && !readByte(data2)) {
+                lastError = "Truncated or malformed event";
+                return false;
+            }
+
+            if (type == 0x80 || type == 0x90 || type == 0xB0 || type == 0xC0) {
+                trackLastTick = currentTick;
+            }
+
+            if (visitor == nullptr) {
+                continue;
+            }
+
+            MIDIEvent event;
+            event.tick = currentTick;
+            event.channel = status & 0x0F;
+            event.note = data1 & 0x7F;
+            event.velocity = data2 & 0x7F;
+
+            uint32_t wanted = 0;
+            switch (type) {
+                case 0x80:
+                    event.type = EventType::NoteOff;
+                    wanted = ParseNotes;
+                    break;
+                case 0x90:
+                    event.type = event.velocity == 0 ? EventType::NoteOff : EventType::NoteOn;
+                    wanted = ParseNotes;
+                    break;
+                case 0xB0:
+                    event.type = EventType::ControlChange;
+                    wanted = ParseControlChanges;
+                    break;
+                case 0xC0:
+                    event.type = EventType::ProgramChange;
+                    wanted = ParseProgramChanges;
+                    break;
+                default:
+                    break;
+            }
+
+            if (parseOptions & wanted) {
+                event.timestamp = static_cast<float>(tempoMap.ticksToSeconds(currentTick, segment));
+                visitor->visitEvent(trackIndex, event);
+            }
+            continue;
+        }
+
+        // Meta and SysEx events cancel running status
+        runningStatus = 0;
+        uint8_t metaType = 0;
+        uint32_t length = 0;
+        if ((status == 0xFF && !readByte(metaType)) || !readVariableLength(length) ||
+            length > trackEnd - window.position()) {
+            lastError = "Truncated or malformed event";
+            return false;
+        }
+
+        bool tempoEvent = status == 0xFF && metaType == 0x51 && length == 3;
+        bool deliver = visitor != nullptr && status == 0xFF && metaType != 0x2F &&
+                       (parseOptions & ParseMetaEvents) && length <= buffer.size();
+
+        if ((tempoEvent && visitor == nullptr) || deliver) {
+            const uint8_t* payload = window.view(length);
+            if (payload == nullptr) {
+                lastError = "Truncated or malformed event";
+                return false;
+            }
+            if (tempoEvent && visitor == nullptr) {
+                tempoMap.addChange(currentTick, (payload[0] << 16) | (payload[1] << 8) | payload[2]);
+            }
+            if (deliver) {
+                MIDIMetaEvent meta;
+                meta.tick = currentTick;
+                meta.type = metaType;
+                meta.data = std::string_view(reinterpret_cast<const char*>(payload), length);
+                visitor->visitMetaEvent(trackIndex, meta);
+            }
+        } else {
+            window.skip(length);
+        }
+    }
+
+    lastTick = std::max(lastTick, trackLastTick);
+    if (visitor != nullptr) {
+        visitor->endTrack(trackIndex, tempoMap.ticksToSeconds(trackLastTick));
+    }
+    return true;
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "MIDIParser.h"
+
+namespace MIDIScaleDetector {
+
+// Receives events from StreamingParser. Events and meta payloads are only
+// valid for the duration of the call.
+class MIDIEventVisitor {
+public:
+    virtual ~MIDIEventVisitor() = default;
+
+    // Header and complete tempo map, before any events
+    virtual void beginFile(const MIDIHeader&, const TempoMap&) {}
+
+    virtual void beginTrack(size_t /*trackIndex*/) {}
+
+    // Channel event with tick and timestamp filled in, in track order
+    virtual void visitEvent(size_t trackIndex, const MIDIEvent& event) = 0;
+
+    // Meta event; payloads larger than the read window are not delivered
+    virtual void visitMetaEvent(size_t /*trackIndex*/, const MIDIMetaEvent& /*meta*/) {}
+
+    // endTime is the time of the track's last channel event
+    virtual void endTrack(size_t /*trackIndex*/, double /*endTime*/) {}
+};
+
+// Parser for files too large to hold in memory as events. Track chunks are
+// read through a fixed-size window and events go straight to a visitor, so
+// memory use does not grow with the file. The file is read twice: once to
+// build the tempo map, then to deliver events with their timestamps.
+class StreamingParser {
+public:
+    static constexpr size_t kDefaultWindowSize = 64 * 1024;
+
+    explicit StreamingParser(size_t windowSize = kDefaultWindowSize);
+
+    bool parse(const std::string& filePath, MIDIEventVisitor& visitor);
+
+    // Select events passed to visitEvent (ParseOptions flags, default ParseEverything)
+    void setParseOptions(uint32_t options) { parseOptions = options; }
+
+    // Results of the last parse
+    const MIDIHeader& getHeader() const { return header; }
+    const TempoMap& getTempoMap() const { return tempoMap; }
+    double getTempo() const { return tempo; }           // BPM of the first tempo event
+    double getDuration() const { return duration; }     // Seconds to the last channel event
+
+    std::string getLastError() const { return lastError; }
+
+private:
+    class Window;
+
+    std::vector<uint8_t> buffer;
+    uint32_t parseOptions;
+    MIDIHeader header;
+    TempoMap tempoMap;
+    double tempo;
+    double duration;
+    std::string lastError;
+
+    bool readTracks(Window& window, MIDIEventVisitor* visitor);
+    bool readTrack(Window& window, uint64_t trackEnd, size_t trackIndex,
+                   MIDIEventVisitor* visitor, uint32_t& lastTick);
+};
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,243 @@
+#include "ZipArchive.h"
+#include <algorithm>
+#include <cstring>
+#include <zlib.h>
+
+namespace MIDIScaleDetector {
+
+namespace {
+    // Zip records are little-endian
+    uint16_t readLE16(const uint8_t* p) {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t readLE32(const uint8_t* p) {
+        return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+               (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    constexpr uint32_t kEndOfCentralDirectory = 0x06054b50;
+    constexpr uint32_t kCentralDirectoryHeader = 0x02014b50;
+    constexpr uint32_t kLocalFileHeader = 0x04034b50;
+
+    constexpr size_t kEndRecordSize = 22;
+    constexpr size_t kCentralHeaderSize = 46;
+    constexpr size_t kLocalHeaderSize = 30;
+    constexpr size_t kMaxCommentLength = 0xFFFF;
+
+    constexpr uint16_t kFlagEncrypted = 0x0001;
+    constexpr uint16_t kMethodStored = 0;
+    constexpr uint16_t kMethodDeflate = 8;
+}
+
+ZipArchive::ZipArchive() {}
+
+bool ZipArchive::open(const std::string& archivePath) {
+    close();
+
+    file = MappedFile::open(archivePath, lastError);
+    if (!file) {
+        return false;
+    }
+    path = archivePath;
+
+    if (!readCentralDirectory()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void ZipArchive::close() {
+    file.reset();
+    path.clear();
+    entries.clear();
+    entryIndex.clear();
+}
+
+bool ZipArchive::readCentralDirectory() {
+    const uint8_t* data = file->data();
+    const size_t size = file->size();
+
+    if (size < kEndRecordSize) {
+        lastError = "Not a zip archive: " + path;
+        return false;
+    }
+
+    // The end record sits at the very end, followed only by an optional comment
+    size_t searchStart = size - kEndRecordSize;
+    size_t searchLimit = searchStart > kMaxCommentLength ? searchStart - kMaxCommentLength : 0;
+    size_t endRecord = SIZE_MAX;
+    for (size_t pos = searchStart + 1; pos-- > searchLimit;) {
+        if (readLE32(data + pos) == kEndOfCentralDirectory) {
+            endRecord = pos;
+            break;
+        }
+    }
+    if (endRecord == SIZE_MAX) {
+        lastError = "Not a zip archive: " + path;
+        return false;
+    }
+
+    uint16_t entryCount = readLE16(data + endRecord + 10);
+    uint32_t directorySize = readLE32(data + endRecord + 12);
+    uint32_t directoryOffset = readLE32(data + endRecord + 16);
+
+    if (entryCount == 0xFFFF || directoryOffset == 0xFFFFFFFF) {
+        lastError = "ZIP64 archives are not supported: " + path;
+        return false;
+    }
+    if (directoryOffset > endRecord || directorySize > endRecord - directoryOffset) {
+        lastError = "Corrupt zip central directory: " + path;
+        return false;
+    }
+
+    entries.reserve(entryCount);
+    size_t offset = directoryOffset;
+    const size_t directoryEnd = directoryOffset + directorySize;
+
+    for (uint16_t i = 0; i < entryCount; ++i) {
+        if (directoryEnd - offset < kCentralHeaderSize ||
+            readLE32(data + offset) != kCentralDirectoryHeader) {
+            lastError = "Corrupt zip central directory: " + path;
+            return false;
+        }
+
+        const uint8_t* header = data + offset;
+        uint16_t flags = readLE16(header + 8);
+        uint16_t nameLength = readLE16(header + 28);
+        size_t recordSize = kCentralHeaderSize + nameLength +
+                            readLE16(header + 30) + readLE16(header + 32);
+        if (recordSize > directoryEnd - offset) {
+            lastError = "Corrupt zip central directory: " + path;
+            return false;
+        }
+
+        ZipEntry entry;
+        entry.method = readLE16(header + 10);
+        entry.crc32 = readLE32(header + 16);
+        entry.compressedSize = readLE32(header + 20);
+        entry.uncompressedSize = readLE32(header + 24);
+        entry.localHeaderOffset = readLE32(header + 42);
+        entry.name.assign(reinterpret_cast<const char*>(header + kCentralHeaderSize), nameLength);
+        offset += recordSize;
+
+        // Directories, encrypted entries and ZIP64-sized entries can't be read
+        bool isDirectory = !entry.name.empty() && entry.name.back() == '/';
+        bool isZip64 = entry.compressedSize == 0xFFFFFFFF || entry.uncompressedSize == 0xFFFFFFFF;
+        if (isDirectory || isZip64 || (flags & kFlagEncrypted)) {
+            continue;
+        }
+
+        // Archives written on Windows may use backslashes
+        std::replace(entry.name.begin(), entry.name.end(), '\\', '/');
+        entryIndex.emplace(entry.name, entries.size());
+        entries.push_back(std::move(entry));
+    }
+
+    return true;
+}
+
+const ZipEntry* ZipArchive::findEntry(const std::string& name) const {
+    auto found = entryIndex.find(name);
+    return found != entryIndex.end() ? &entries[found->second] : nullptr;
+}
+
+bool ZipArchive::extract(const ZipEntry& entry, std::vector<uint8_t>& buffer) {
+    if (!file) {
+        lastError = "Archive is not open";
+        return false;
+    }
+
+    const uint8_t* data = file->data();
+    const size_t size = file->size();
+
+    // Local header repeats the name and may carry a different extra field
+    size_t offset = static_cast<size_t>(entry.localHeaderOffset);
+    if (offset > size || size - offset < kLocalHeaderSize ||
+        readLE32(data + offset) != kLocalFileHeader) {
+        lastError = "Corrupt zip entry: " + entry.name;
+        return false;
+    }
+    offset += kLocalHeaderSize + readLE16(data + offset + 26) + readLE16(data + offset + 28);
+    if (offset > size || entry.compressedSize > size - offset) {
+        lastError = "Corrupt zip entry: " + entry.name;
+        return false;
+    }
+    if (entry.uncompressedSize > kMaxEntrySize) {
+        lastError = "Zip entry too large: " + entry.name;
+        return false;
+    }
+
+    const uint8_t* compressed = data + offset;
+    buffer.resize(entry.uncompressedSize);
+
+    if (entry.method == kMethodStored) {
+        if (entry.compressedSize != entry.uncompressedSize) {
+            lastError = "Corrupt zip entry: " + entry.name;
+            return false;
+        }
+        if (entry.uncompressedSize > 0) {
+            std::memcpy(buffer.data(), compressed, entry.uncompressedSize);
+        }
+    } else if (entry.method == kMethodDeflate) {
+        if (entry.uncompressedSize > 0) {
+            // Raw deflate stream, inflated straight into the output buffer
+            z_stream stream;
+            std::memset(&stream, 0, sizeof(stream));
+            if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+                lastError = "Failed to initialise inflate";
+                return false;
+            }
+            stream.next_in = const_cast<Bytef*>(compressed);
+            stream.avail_in = entry.compressedSize;
+            stream.next_out = buffer.data();
+            stream.avail_out = entry.uncompressedSize;
+
+            int status = inflate(&stream, Z_FINISH);
+            uLong produced = stream.total_out;
+            inflateEnd(&stream);
+
+            if (status != Z_STREAM_END || produced != entry.uncompressedSize) {
+                lastError = "Failed to inflate zip entry: " + entry.name;
+                return false;
+            }
+        }
+    } else {
+        lastError = "Unsupported zip compression method in " + entry.name;
+        return false;
+    }
+
+    uLong checksum = ::crc32(0L, buffer.data(), static_cast<uInt>(buffer.size()));
+    if (checksum != entry.crc32) {
+        lastError = "CRC mismatch in zip entry: " + entry.name;
+        return false;
+    }
+
+    return true;
+}
+
+bool ZipArchive::splitPath(const std::string& filePath, std::string& archivePath,
+                           std::string& entryName) {
+    // Only a separator right after a .zip name counts, so '!' in folder names is safe
+    const size_t separatorLength = std::strlen(kEntrySeparator);
+    for (size_t separator = filePath.find(kEntrySeparator); separator != std::string::npos;
+         separator = filePath.find(kEntrySeparator, separator + 1)) {
+        if (separator >= 4) {
+            std::string extension = filePath.substr(separator - 4, 4);
+            std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+            if (extension == ".zip") {
+                archivePath = filePath.substr(0, separator);
+                entryName = filePath.substr(separator + separatorLength);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+std::string ZipArchive::makePath(const std::string& archivePath, const std::string& entryName) {
+    return archivePath + kEntrySeparator + entryName;
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "MappedFile.h"
+
+namespace MIDIScaleDetector {
+
+// One file inside a zip archive, from the central directory
+struct ZipEntry {
+    std::string name;           // Path inside the archive, '/' separated
+    uint64_t localHeaderOffset;
+    uint32_t compressedSize;
+    uint32_t uncompressedSize;
+    uint32_t crc32;
+    uint16_t method;            // 0 = stored, 8 = deflate
+};
+
+// Read-only view of a zip archive so MIDI packs can be browsed without
+// extracting them. The archive is memory-mapped and entries are inflated
+// into a caller-supplied buffer on demand.
+//
+// Entries are addressed as "archive.zip!/inner/path.mid" wherever a file
+// path is expected (database rows, MappedFile::open, MIDIParser::parse).
+class ZipArchive {
+public:
+    // Separator between the archive path and the entry name
+    static constexpr const char* kEntrySeparator = "!/";
+
+    // Entries are inflated in memory; anything claiming more is rejected
+    static constexpr uint32_t kMaxEntrySize = 256 * 1024 * 1024;
+
+    ZipArchive();
+
+    // Map the archive and read its central directory
+    bool open(const std::string& archivePath);
+    void close();
+
+    bool isOpen() const { return file != nullptr; }
+    const std::string& getPath() const { return path; }
+
+    // File entries only - directories are left out
+    const std::vector<ZipEntry>& getEntries() const { return entries; }
+    const ZipEntry* findEntry(const std::string& name) const;
+
+    // Decompress an entry into buffer (resized to fit) and verify its CRC
+    bool extract(const ZipEntry& entry, std::vector<uint8_t>& buffer);
+
+    std::string getLastError() const { return lastError; }
+
+    // "a.zip!/b/c.mid" -> ("a.zip", "b/c.mid"). False for plain paths.
+    static bool splitPath(const std::string& filePath, std::string& archivePath,
+                          std::string& entryName);
+    static std::string makePath(const std::string& archivePath, const std::string& entryName);
+
+private:
+    std::shared_ptr<const MappedFile> file;
+    std::string path;
+    std::vector<ZipEntry> entries;
+    std::unordered_map<std::string, size_t> entryIndex;     // Name -> position in entries
+    std::string lastError;
+
+    bool readCentralDirectory();
+};
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,265 @@
+#include "ChordDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace MIDIScaleDetector {
+
+int Chord::getInversion() const {
+    int interval = (static_cast<int>(bass) - static_cast<int>(root) + 12) % 12;
+    PitchClassMask tones = kChordTemplates[static_cast<size_t>(quality)].mask;
+    if (((tones >> interval) & 1) == 0) {
+        return -1;
+    }
+    return countPitchClasses(static_cast<PitchClassMask>(tones & ((1u << interval) - 1)));
+}
+
+std::string Chord::getName() const {
+    std::string name = noteNameToString(root);
+    name += kChordTemplates[static_cast<size_t>(quality)].suffix;
+    if (bass != root) {
+        name += "/" + noteNameToString(bass);
+    }
+    return name;
+}
+
+ChordDetector::ChordDetector()
+    : window(ChordWindow::Beats),
+      windowLength(2.0),
+      minimumDuration(0.1),
+      minimumPresence(0.25) {}
+
+void ChordDetector::setWindow(ChordWindow mode, double length) {
+    window = mode;
+    if (length > 0.0) {
+        windowLength = length;
+    }
+}
+
+bool ChordDetector::identify(PitchClassMask sounding, int bassPitchClass, Chord& chord) {
+    if (countPitchClasses(sounding) < 2) {
+        return false;
+    }
+
+    // Score = chord tones present minus notes left over and omitted fifths,
+    // doubled so a root in the bass only breaks ties
+    int bestScore = -1000;
+    for (int root = 0; root < 12; ++root) {
+        if (((sounding >> root) & 1) == 0) {
+            continue;
+        }
+        for (const auto& chordTemplate : kChordTemplates) {
+            PitchClassMask tones = transposePitchClassMask(chordTemplate.mask, root);
+            PitchClassMask required = tones;
+            if (countPitchClasses(chordTemplate.mask) >= 4) {
+                required &= static_cast<PitchClassMask>(~(1u << ((root + 7) % 12)));
+            }
+            if ((required & ~sounding) != 0) {
+                continue;
+            }
+            int present = countPitchClasses(static_cast<PitchClassMask>(tones & sounding));
+            int missing = countPitchClasses(tones) - present;
+            int extra = countPitchClasses(static_cast<PitchClassMask>(sounding & ~tones));
+            int score = (present - missing - extra) * 2 + (root == bassPitchClass ? 1 : 0);
+            if (score > bestScore) {
+                bestScore = score;
+                chord.root = intToNoteName(root);
+                chord.quality = chordTemplate.quality;
+            }
+        }
+    }
+    if (bestScore == -1000) {
+        return false;
+    }
+    chord.bass = bassPitchClass >= 0 ? intToNoteName(bassPitchClass) : chord.root;
+    return true;
+}
+
+void ChordDetector::detect(const NoteTable& notes, const TempoMap& tempoMap,
+                           double startTime, double endTime, std::vector<Chord>& chords) {
+    chords.clear();
+    if (notes.empty() || endTime <= startTime) {
+        return;
+    }
+    if (window == ChordWindow::Changes) {
+        detectChanges(notes, startTime, endTime, chords);
+    } else {
+        detectWindows(notes, tempoMap, startTime, endTime, chords);
+    }
+}
+
+void ChordDetector::append(const Chord& chord, std::vector<Chord>& chords) const {
+    if (!chords.empty() && chords.back().sameLabel(chord) && chords.back().endTime >= chord.startTime) {
+        chords.back().endTime = std::max(chords.back().endTime, chord.endTime);
+    } else {
+        chords.push_back(chord);
+    }
+}
+
+void ChordDetector::detectChanges(const NoteTable& notes, double startTime, double endTime,
+                                  std::vector<Chord>& chords) {
+    // Starts and ends clipped to the range; ends sort before starts at the
+    // same time so a repeated note never counts twice
+    events.clear();
+    for (size_t i = 0; i < notes.size() && notes.startTime[i] < endTime; ++i) {
+        double start = std::max(notes.startTime[i], startTime);
+        double end = std::min(notes.endTime[i], endTime);
+        if (end > start) {
+            events.emplace_back(start, notes.pitch[i] + 1);
+            events.emplace_back(end, -(notes.pitch[i] + 1));
+        }
+    }
+    std::sort(events.begin(), events.end());
+
+    std::array<int, 128> pitchCount;
+    std::array<int, 12> pitchClassCount;
+    pitchCount.fill(0);
+    pitchClassCount.fill(0);
+    int sounding = 0;
+    double previous = 0.0;
+    for (size_t i = 0; i < events.size();) {
+        double position = events[i].first;
+        if (sounding > 0 && position > previous) {
+            PitchClassMask mask = 0;
+            for (int pc = 0; pc < 12; ++pc) {
+                if (pitchClassCount[static_cast<size_t>(pc)] > 0) {
+                    mask |= static_cast<PitchClassMask>(1u << pc);
+                }
+            }
+            int bass = 0;
+            while (pitchCount[static_cast<size_t>(bass)] == 0) {
+                ++bass;
+            }
+            Chord chord;
+            if (identify(mask, bass % 12, chord)) {
+                chord.startTime = previous;
+                chord.endTime = position;
+                append(chord, chords);
+            }
+        }
+        for (; i < events.size() && events[i].first == position; ++i) {
+            int pitch = std::abs(events[i].second) - 1;
+            int change = events[i].second > 0 ? 1 : -1;
+            pitchCount[static_cast<size_t>(pitch)] += change;
+            pitchClassCount[static_cast<size_t>(pitch % 12)] += change;
+            sounding += change;
+        }
+        previous = position;
+    }
+
+    // Drop passing spans, then join neighbours they separated
+    size_t kept = 0;
+    for (const Chord& chord : chords) {
+        if (chord.endTime - chord.startTime < minimumDuration) {
+            continue;
+        }
+        if (kept > 0 && chords[kept - 1].sameLabel(chord) &&
+            chord.startTime - chords[kept - 1].endTime <= minimumDuration) {
+            chords[kept - 1].endTime = chord.endTime;
+        } else {
+            chords[kept++] = chord;
+        }
+    }
+    chords.resize(kept);
+}
+
+void ChordDetector::detectWindows(const NoteTable& notes, const TempoMap& tempoMap,
+                                  double startTime, double endTime, std::vector<Chord>& chords) {
+    // Beats are counted in ticks. SMPTE files have no beat grid, so their
+    // beats are taken at 120 BPM.
+    bool inTicks = window == ChordWindow::Beats && tempoMap.secondsPerSMPTETick == 0.0 &&
+                   tempoMap.division > 0;
+    double size = windowLength;
+    if (window == ChordWindow::Beats) {
+        size = inTicks ? windowLength * tempoMap.division : windowLength * 0.5;
+    }
+    auto noteStart = [&](size_t i) {
+        return inTicks ? static_cast<double>(notes.startTick[i]) : notes.startTime[i];
+    };
+    auto noteEnd = [&](size_t i) {
+        return inTicks ? static_cast<double>(notes.endTick[i]) : notes.endTime[i];
+    };
+
+    // Windows sit on the beat grid from tick 0, or start with the range
+    size_t first = notes.size();
+    size_t last = 0;
+    double lowest = 0.0;
+    double highest = 0.0;
+    for (size_t i = 0; i < notes.size() && notes.startTime[i] < endTime; ++i) {
+        if (notes.endTime[i] <= startTime || noteEnd(i) <= noteStart(i)) {
+            continue;
+        }
+        lowest = first == notes.size() ? noteStart(i) : std::min(lowest, noteStart(i));
+        highest = std::max(highest, noteEnd(i));
+        first = std::min(first, i);
+        last = i + 1;
+    }
+    if (first >= last) {
+        return;
+    }
+    double origin = inTicks ? std::floor(lowest / size) * size : startTime;
+    if (!inTicks) {
+        highest = std::min(highest, endTime);
+    }
+    size_t windowCount = static_cast<size_t>(std::ceil((highest - origin) / size));
+    if (windowCount == 0) {
+        return;
+    }
+
+    std::array<double, 12> empty;
+    empty.fill(0.0);
+    windowWeights.assign(windowCount, empty);
+    windowBass.assign(windowCount, 128);
+    double threshold = minimumPresence * size;
+    for (size_t i = first; i < last; ++i) {
+        if (notes.endTime[i] <= startTime) {
+            continue;
+        }
+        double start = std::max(noteStart(i), origin);
+        double end = noteEnd(i);
+        if (end <= start) {
+            continue;
+        }
+        size_t w = static_cast<size_t>((start - origin) / size);
+        for (; w < windowCount; ++w) {
+            double windowStart = origin + static_cast<double>(w) * size;
+            if (windowStart >= end) {
+                break;
+            }
+            double overlap = std::min(end, windowStart + size) - std::max(start, windowStart);
+            windowWeights[w][notes.pitch[i] % 12] += overlap;
+            if (overlap >= threshold) {
+                windowBass[w] = std::min(windowBass[w], static_cast<int>(notes.pitch[i]));
+            }
+        }
+    }
+
+    for (size_t w = 0; w < windowCount; ++w) {
+        PitchClassMask mask = 0;
+        for (int pc = 0; pc < 12; ++pc) {
+            if (windowWeights[w][static_cast<size_t>(pc)] >= threshold) {
+                mask |= static_cast<PitchClassMask>(1u << pc);
+            }
+        }
+        int bass = windowBass[w] < 128 && ((mask >> (windowBass[w] % 12)) & 1) ? windowBass[w] % 12 : -1;
+        Chord chord;
+        if (!identify(mask, bass, chord)) {
+            continue;
+        }
+
+        double windowStart = origin + static_cast<double>(w) * size;
+        if (inTicks) {
+            chord.startTime = tempoMap.ticksToSeconds(static_cast<uint32_t>(windowStart));
+            chord.endTime = tempoMap.ticksToSeconds(static_cast<uint32_t>(windowStart + size));
+        } else {
+            chord.startTime = windowStart;
+            chord.endTime = windowStart + size;
+        }
+        chord.startTime = std::max(chord.startTime, startTime);
+        chord.endTime = std::min(chord.endTime, endTime);
+        if (chord.endTime > chord.startTime) {
+            append(chord, chords);
+        }
+    }
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "ScaleDetector.h"
+
+namespace MIDIScaleDetector {
+
+// Builds a labelled chord timeline from a note table in one sweep.
+//
+// Changes mode sorts note starts and ends once and walks them with a count
+// of sounding notes per pitch, labelling each span between events. The
+// windowed modes add each note's overlap to the windows it covers and label
+// every window from the pitch classes sounding for enough of it. Either way
+// consecutive spans with the same label are merged.
+class ChordDetector {
+public:
+    ChordDetector();
+
+    // Window length is in beats or seconds; ignored for Changes
+    void setWindow(ChordWindow mode, double length);
+    ChordWindow getWindow() const { return window; }
+
+    // Changes mode drops chords shorter than this (seconds)
+    void setMinimumDuration(double seconds) { minimumDuration = seconds; }
+
+    // Windowed modes: share of the window a pitch class must sound for
+    void setMinimumPresence(double fraction) { minimumPresence = fraction; }
+
+    // Timeline of the notes sounding in [startTime, endTime)
+    void detect(const NoteTable& notes, const TempoMap& tempoMap,
+                double startTime, double endTime, std::vector<Chord>& chords);
+
+    // Best chord containing the sounding pitch classes (bit 0 = C). Needs at
+    // least two pitch classes. The seventh chords may omit their fifth.
+    static bool identify(PitchClassMask sounding, int bassPitchClass, Chord& chord);
+
+private:
+    ChordWindow window;
+    double windowLength;
+    double minimumDuration;
+    double minimumPresence;
+
+    // Scratch kept between calls
+    std::vector<std::pair<double, int>> events;     // Position, +-(pitch + 1)
+    std::vector<std::array<double, 12>> windowWeights;
+    std::vector<int> windowBass;
+
+    void detectChanges(const NoteTable& notes, double startTime, double endTime,
+                       std::vector<Chord>& chords);
+    void detectWindows(const NoteTable& notes, const TempoMap& tempoMap,
+                       double startTime, double endTime, std::vector<Chord>& chords);
+    void append(const Chord& chord, std::vector<Chord>& chords) const;
+};
+
+} // namespace MIDIScaleDetector
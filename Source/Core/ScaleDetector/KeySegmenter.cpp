@@ -0,0 +1,151 @@
+#include "KeySegmenter.h"
+#include "ScaleScoring.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace MIDIScaleDetector {
+
+namespace {
+    // Position of a key's signature on the circle of fifths; a minor key
+    // sits with its relative major
+    int circlePosition(int key) {
+        int majorRoot = key < 12 ? key : (key + 3) % 12;
+        return (majorRoot * 7) % 12;
+    }
+}
+
+KeySegmenter::KeySegmenter() : switchProbability(0.002), emissionWeight(8.0) {
+    setProfiles(kMajorKeyProfile, kMinorKeyProfile);
+    buildTransitions();
+}
+
+void KeySegmenter::setProfiles(const std::array<double, 12>& majorProfile,
+                               const std::array<double, 12>& minorProfile) {
+    // Each profile as a distribution over pitch classes, rotated to every root
+    auto setRows = [this](const std::array<double, 12>& profile, int firstKey) {
+        double sum = std::accumulate(profile.begin(), profile.end(), 0.0);
+        for (int root = 0; root < 12; ++root) {
+            for (int pc = 0; pc < 12; ++pc) {
+                double probability = profile[static_cast<size_t>((pc - root + 12) % 12)] / sum;
+                logEmission[static_cast<size_t>(firstKey + root)][static_cast<size_t>(pc)] =
+                    std::log(std::max(probability, 1e-6));
+            }
+        }
+    };
+    setRows(majorProfile, 0);
+    setRows(minorProfile, 12);
+}
+
+void KeySegmenter::setSwitchProbability(double probability) {
+    if (probability > 0.0 && probability < 1.0) {
+        switchProbability = probability;
+        buildTransitions();
+    }
+}
+
+void KeySegmenter::buildTransitions() {
+    // Switches share switchProbability in proportion to 1 / (1 + fifths apart)
+    for (int from = 0; from < kStates; ++from) {
+        std::array<double, kStates> weights;
+        double total = 0.0;
+        for (int to = 0; to < kStates; ++to) {
+            int distance = std::abs(circlePosition(from) - circlePosition(to));
+            distance = std::min(distance, 12 - distance);
+            weights[static_cast<size_t>(to)] = to == from ? 0.0 : 1.0 / (1.0 + distance);
+            total += weights[static_cast<size_t>(to)];
+        }
+        for (int to = 0; to < kStates; ++to) {
+            double probability = to == from ? 1.0 - switchProbability
+                                            : switchProbability * weights[static_cast<size_t>(to)] / total;
+            logTransition[static_cast<size_t>(from)][static_cast<size_t>(to)] = std::log(probability);
+        }
+    }
+}
+
+void KeySegmenter::findBeats(const TempoMap& tempoMap, double startTime, double endTime) {
+    beatTimes.clear();
+    beatTimes.push_back(startTime);
+    if (tempoMap.secondsPerSMPTETick != 0.0 || tempoMap.division == 0) {
+        for (double time = startTime + 0.5; time < endTime; time += 0.5) {
+            beatTimes.push_back(time);
+        }
+    } else {
+        size_t segment = 0;
+        for (uint64_t tick = tempoMap.division; tick <= UINT32_MAX; tick += tempoMap.division) {
+            double time = tempoMap.ticksToSeconds(static_cast<uint32_t>(tick), segment);
+            if (time >= endTime) {
+                break;
+            }
+            if (time > startTime) {
+                beatTimes.push_back(time);
+            }
+        }
+    }
+    beatTimes.push_back(endTime);
+}
+
+void KeySegmenter::segment(const PitchClassTimeline& timeline, const TempoMap& tempoMap,
+                           double startTime, double endTime, std::vector<KeySegment>& segments) {
+    segments.clear();
+    if (timeline.empty() || endTime <= startTime) {
+        return;
+    }
+    findBeats(tempoMap, startTime, endTime);
+    size_t beatCount = beatTimes.size() - 1;
+    backPointers.resize(beatCount * kStates);
+
+    // Forward pass in log space. Scores are shifted so the best is zero
+    // after every beat, which keeps them bounded on long songs.
+    std::array<double, kStates> previous;
+    std::array<double, kStates> current;
+    std::array<double, 12> chroma;
+    previous.fill(0.0);
+    for (size_t beat = 0; beat < beatCount; ++beat) {
+        timeline.histogram(beatTimes[beat], beatTimes[beat + 1], chroma);
+        double total = std::accumulate(chroma.begin(), chroma.end(), 0.0);
+        double scale = total > 0.0 ? emissionWeight / total : 0.0;
+
+        uint8_t* pointers = backPointers.data() + beat * kStates;
+        double best = -INFINITY;
+        for (size_t to = 0; to < kStates; ++to) {
+            size_t from = to;
+            double score = previous[to];
+            if (beat > 0) {
+                score += logTransition[to][to];
+                for (size_t other = 0; other < kStates; ++other) {
+                    double candidate = previous[other] + logTransition[other][to];
+                    if (candidate > score) {
+                        score = candidate;
+                        from = other;
+                    }
+                }
+            }
+            double emission = 0.0;
+            for (size_t pc = 0; pc < 12; ++pc) {
+                emission += chroma[pc] * logEmission[to][pc];
+            }
+            current[to] = score + emission * scale;
+            pointers[to] = static_cast<uint8_t>(from);
+            best = std::max(best, current[to]);
+        }
+        for (size_t state = 0; state < kStates; ++state) {
+            previous[state] = current[state] - best;
+        }
+    }
+
+    // Trace the best path back, then merge runs of one key
+    size_t state = static_cast<size_t>(std::max_element(previous.begin(), previous.end()) - previous.begin());
+    for (size_t beat = beatCount; beat-- > 0;) {
+        int key = static_cast<int>(state);
+        if (!segments.empty() && segments.back().key == key) {
+            segments.back().startTime = beatTimes[beat];
+        } else {
+            segments.push_back({beatTimes[beat], beatTimes[beat + 1], key});
+        }
+        state = backPointers[beat * kStates + state];
+    }
+    std::reverse(segments.begin(), segments.end());
+}
+
+} // namespace MIDIScaleDetector
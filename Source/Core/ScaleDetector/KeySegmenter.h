@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "PitchClassTimeline.h"
+
+namespace MIDIScaleDetector {
+
+// A stretch of beats decoded as one key. Key rows follow ScaleScores:
+// 0-11 major keys by root, 12-23 minor keys by root.
+struct KeySegment {
+    double startTime;
+    double endTime;
+    int key;
+};
+
+// Segments a range into keys with a hidden Markov model over the 24 major
+// and minor keys, decoded with Viterbi.
+//
+// The observations are beat-synchronous chroma: one histogram per beat,
+// each two prefix lookups in a PitchClassTimeline. A beat's log-emission
+// for a key is its normalised chroma dotted with the log of that key's
+// profile, taken from a table built once. Transitions stay in the same
+// key with high probability; the remainder goes to other keys, favouring
+// neighbours on the circle of fifths. Decoding costs a fixed 24 x 24 step
+// per beat, so long songs stay linear in their beat count.
+class KeySegmenter {
+public:
+    KeySegmenter();
+
+    // Krumhansl-style key profiles, C-rooted
+    void setProfiles(const std::array<double, 12>& majorProfile,
+                     const std::array<double, 12>& minorProfile);
+
+    // Chance per beat of leaving the current key (default 0.002)
+    void setSwitchProbability(double probability);
+
+    // Scales every beat's log-emission, i.e. how much one beat of evidence
+    // counts against the cost of a switch (default 8)
+    void setEmissionWeight(double weight) { emissionWeight = weight; }
+
+    // Key segments covering the beats in [startTime, endTime). Beats come
+    // from the tempo map; SMPTE files use half-second beats. Silent beats
+    // carry no evidence and stay with the surrounding key.
+    void segment(const PitchClassTimeline& timeline, const TempoMap& tempoMap,
+                 double startTime, double endTime, std::vector<KeySegment>& segments);
+
+    static constexpr int kStates = 24;
+
+private:
+    std::array<std::array<double, 12>, kStates> logEmission;     // [key][pitch class]
+    std::array<std::array<double, kStates>, kStates> logTransition;    // [from][to]
+    double switchProbability;
+    double emissionWeight;
+
+    // Scratch kept between calls
+    std::vector<double> beatTimes;          // Beat boundaries, one more than beats
+    std::vector<uint8_t> backPointers;      // kStates per beat
+
+    void buildTransitions();
+    void findBeats(const TempoMap& tempoMap, double startTime, double endTime);
+};
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,137 @@
+#include "PitchClassTimeline.h"
+#include <algorithm>
+
+namespace MIDIScaleDetector {
+
+PitchClassTimeline::PitchClassTimeline() : durationWeighted(true) {}
+
+void PitchClassTimeline::clear() {
+    times.clear();
+    prefix.clear();
+}
+
+void PitchClassTimeline::build(const NoteTable& notes, bool weightByDuration, bool weightByVelocity) {
+    clear();
+    durationWeighted = weightByDuration;
+    if (notes.empty()) {
+        return;
+    }
+
+    auto noteWeight = [&](size_t i) {
+        return weightByVelocity ? notes.velocity[i] / 127.0 : 1.0;
+    };
+    std::array<double, 12> running;
+    running.fill(0.0);
+    auto addBreakpoint = [&](double time) {
+        times.push_back(time);
+        prefix.insert(prefix.end(), running.begin(), running.end());
+    };
+
+    if (!weightByDuration) {
+        // Step function: each breakpoint includes the notes starting there
+        for (size_t i = 0; i < notes.size(); ++i) {
+            running[notes.pitch[i] % 12] += noteWeight(i);
+            if (times.empty() || notes.startTime[i] != times.back()) {
+                addBreakpoint(notes.startTime[i]);
+            } else {
+                std::copy(running.begin(), running.end(), prefix.end() - 12);
+            }
+        }
+        return;
+    }
+
+    // Sweep note starts (already sorted) against note ends, integrating the
+    // sounding weight of each pitch class between consecutive events
+    ends.clear();
+    for (size_t i = 0; i < notes.size(); ++i) {
+        if (notes.endTime[i] > notes.startTime[i]) {
+            ends.emplace_back(notes.endTime[i], i);
+        }
+    }
+    std::sort(ends.begin(), ends.end());
+
+    std::array<double, 12> slope;
+    std::array<int, 12> sounding;
+    slope.fill(0.0);
+    sounding.fill(0);
+    size_t nextStart = 0;
+    size_t nextEnd = 0;
+    while (nextEnd < ends.size()) {
+        while (nextStart < notes.size() && notes.endTime[nextStart] <= notes.startTime[nextStart]) {
+            ++nextStart;
+        }
+        double time = ends[nextEnd].first;
+        if (nextStart < notes.size()) {
+            time = std::min(time, notes.startTime[nextStart]);
+        }
+
+        if (times.empty()) {
+            addBreakpoint(time);
+        } else if (time > times.back()) {
+            double elapsed = time - times.back();
+            for (size_t pc = 0; pc < 12; ++pc) {
+                running[pc] += slope[pc] * elapsed;
+            }
+            addBreakpoint(time);
+        }
+
+        while (nextEnd < ends.size() && ends[nextEnd].first == time) {
+            size_t i = ends[nextEnd++].second;
+            size_t pc = notes.pitch[i] % 12;
+            // Exact zero once nothing sounds, so rounding can't accumulate
+            slope[pc] = --sounding[pc] > 0 ? slope[pc] - noteWeight(i) : 0.0;
+        }
+        while (nextStart < notes.size() && notes.startTime[nextStart] == time) {
+            if (notes.endTime[nextStart] > time) {
+                size_t pc = notes.pitch[nextStart] % 12;
+                ++sounding[pc];
+                slope[pc] += noteWeight(nextStart);
+            }
+            ++nextStart;
+        }
+    }
+}
+
+void PitchClassTimeline::cumulative(double time, std::array<double, 12>& weights) const {
+    weights.fill(0.0);
+    if (times.empty()) {
+        return;
+    }
+
+    if (!durationWeighted) {
+        // Notes starting strictly before time
+        size_t count = static_cast<size_t>(std::lower_bound(times.begin(), times.end(), time) - times.begin());
+        if (count > 0) {
+            std::copy_n(prefix.begin() + static_cast<std::ptrdiff_t>((count - 1) * 12), 12, weights.begin());
+        }
+        return;
+    }
+
+    size_t upper = static_cast<size_t>(std::upper_bound(times.begin(), times.end(), time) - times.begin());
+    if (upper == 0) {
+        return;
+    }
+    const double* before = prefix.data() + (upper - 1) * 12;
+    if (upper == times.size()) {
+        std::copy_n(before, 12, weights.begin());
+        return;
+    }
+    // Linear between breakpoints: nothing starts or stops in between
+    const double* after = before + 12;
+    double fraction = (time - times[upper - 1]) / (times[upper] - times[upper - 1]);
+    for (size_t pc = 0; pc < 12; ++pc) {
+        weights[pc] = before[pc] + (after[pc] - before[pc]) * fraction;
+    }
+}
+
+void PitchClassTimeline::histogram(double startTime, double endTime,
+                                   std::array<double, 12>& weights) const {
+    std::array<double, 12> before;
+    cumulative(startTime, before);
+    cumulative(endTime, weights);
+    for (size_t pc = 0; pc < 12; ++pc) {
+        weights[pc] = std::max(0.0, weights[pc] - before[pc]);
+    }
+}
+
+} // namespace MIDIScaleDetector
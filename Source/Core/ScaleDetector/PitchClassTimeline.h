@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "../MIDIParser/MIDIParser.h"
+
+namespace MIDIScaleDetector {
+
+// Cumulative per-pitch-class note weight over time, so the histogram of any
+// time range is the difference of two prefix rows instead of a pass over
+// the notes.
+//
+// With duration weighting a note contributes velocity x sounding time, and
+// a range counts only the part of each note inside it. The cumulative
+// weight is then piecewise linear between note starts and ends, and is
+// stored exactly at those breakpoints. Without duration weighting each note
+// counts once, in the range containing its start.
+class PitchClassTimeline {
+public:
+    PitchClassTimeline();
+
+    // Rebuild from a note table. Buffers are kept between builds.
+    void build(const NoteTable& notes, bool weightByDuration, bool weightByVelocity);
+    void clear();
+
+    bool empty() const { return times.empty(); }
+
+    // Cumulative weight of every pitch class up to time
+    void cumulative(double time, std::array<double, 12>& weights) const;
+
+    // Unnormalised histogram of [startTime, endTime)
+    void histogram(double startTime, double endTime, std::array<double, 12>& weights) const;
+
+private:
+    bool durationWeighted;
+    std::vector<double> times;          // Breakpoints, ascending
+    std::vector<double> prefix;         // 12 per breakpoint: weight up to times[k]
+    std::vector<std::pair<double, size_t>> ends;   // Scratch for build: end time, note index
+};
+
+} // namespace MIDIScaleDetector
@@ -1,11 +1,90 @@
 #include "ScaleDetector.h"
+#include "ScaleScoring.h"
+#include "ChordDetector.h"
 #include <cmath>
 #include <algorithm>
 #include <numeric>
-#include <sstream>
 
 namespace MIDIScaleDetector {
 
+namespace {
+    // Pairs note-on/off per track and accumulates the same weights as
+    // calculateWeightedHistogram, holding only the currently sounding notes
+    class NoteAccumulator : public MIDIEventVisitor {
+    public:
+        NoteAccumulator(bool byDuration, bool byVelocity)
+            : noteCount(0), pitchSum(0.0),
+              weightByDuration(byDuration), weightByVelocity(byVelocity) {
+            histogram.fill(0.0);
+            pitchCounts.fill(0);
+        }
+
+        void beginTrack(size_t) override {
+            for (auto& note : openNotes) {
+                note.active = false;
+            }
+        }
+
+        void visitEvent(size_t, const MIDIEvent& event) override {
+            if (event.type != EventType::NoteOn && event.type != EventType::NoteOff) {
+                return;
+            }
+
+            OpenNote& open = openNotes[(event.channel & 0x0F) * 128 + event.note];
+            if (open.active) {
+                // Note-off, or a retrigger of a note that is still sounding
+                close(open, event.note, event.timestamp);
+            }
+
+            if (event.type == EventType::NoteOn) {
+                open.active = true;
+                open.start = event.timestamp;
+                open.velocity = event.velocity;
+                noteCount++;
+                pitchSum += event.note;
+                pitchCounts[event.note]++;
+            }
+        }
+
+        void endTrack(size_t, double endTime) override {
+            // Notes never released end with their track
+            for (size_t i = 0; i < openNotes.size(); ++i) {
+                if (openNotes[i].active) {
+                    close(openNotes[i], static_cast<int>(i % 128), endTime);
+                }
+            }
+        }
+
+        std::array<double, 12> histogram;
+        std::array<uint32_t, 128> pitchCounts;
+        uint64_t noteCount;
+        double pitchSum;
+
+    private:
+        struct OpenNote {
+            double start = 0.0;
+            uint8_t velocity = 0;
+            bool active = false;
+        };
+
+        bool weightByDuration;
+        bool weightByVelocity;
+        std::array<OpenNote, 16 * 128> openNotes;
+
+        void close(OpenNote& note, int pitch, double endTime) {
+            double weight = 1.0;
+            if (weightByDuration) {
+                weight *= endTime - note.start;
+            }
+            if (weightByVelocity) {
+                weight *= (note.velocity / 127.0);
+            }
+            histogram[pitch % 12] += weight;
+            note.active = false;
+        }
+    };
+}
+
 // Scale implementation
 std::string Scale::getName() const {
     return getRootName() + " " + scaleTypeToString(type);
@@ -15,151 +94,63 @@ std::string Scale::getRootName() const {
     return noteNameToString(root);
 }
 
-bool Scale::containsNote(int midiNote) const {
-    int pitchClass = midiNote % 12;
-    int rootPitch = static_cast<int>(root);
-    for (int interval : intervals) {
-        if ((rootPitch + interval) % 12 == pitchClass) {
-            return true;
-        }
-    }
-    return false;
+void HarmonicAnalysis::clear() {
+    primaryScale = Scale();
+    alternativeScales.clear();
+    noteWeights.fill(0.0);
+    chordProgression.clear();
+    chords.clear();
+    keyChanges.clear();
+    totalNotes = 0;
+    averagePitch = 0.0;
+    noteDistribution.fill(0);
+    usedDeclaredKey = false;
+    level = AnalysisLevel::KeyOnly;
 }
 
+AnalysisContext::AnalysisContext() : chordDetector(std::make_unique<ChordDetector>()) {}
+
+AnalysisContext::~AnalysisContext() {}
+
 // ScaleDetector implementation
 ScaleDetector::ScaleDetector()
     : minConfidence(0.6),
       weightByDuration(true),
       weightByVelocity(true),
-      detectKeyChangesEnabled(true) {
-    initializeScaleTemplates();
+      detectKeyChangesEnabled(true),
+      useDeclaredKey(false),
+      keyChangeWindow(4.0),
+      keyChangeHop(2.0),
+      keyChangeHysteresis(1),
+      keyChangeMethod(KeyChangeMethod::Windowed),
+      keySwitchProbability(0.002),
+      chordWindow(ChordWindow::Beats),
+      chordWindowLength(2.0),
+      analysisLevel(AnalysisLevel::Full),
+      scorer(std::make_unique<ScaleScorer>()) {
     initializeKeyProfiles();
+    scorer->setProfiles(majorProfile, minorProfile);
 }
 
 ScaleDetector::~ScaleDetector() {}
 
-void ScaleDetector::initializeScaleTemplates() {
-    // ===== Major modes (Church modes) =====
-    scaleTemplates[ScaleType::Ionian] = {0, 2, 4, 5, 7, 9, 11};           // Major
-    scaleTemplates[ScaleType::Dorian] = {0, 2, 3, 5, 7, 9, 10};
-    scaleTemplates[ScaleType::Phrygian] = {0, 1, 3, 5, 7, 8, 10};
-    scaleTemplates[ScaleType::Lydian] = {0, 2, 4, 6, 7, 9, 11};
-    scaleTemplates[ScaleType::Mixolydian] = {0, 2, 4, 5, 7, 9, 10};
-    scaleTemplates[ScaleType::Aeolian] = {0, 2, 3, 5, 7, 8, 10};          // Natural Minor
-    scaleTemplates[ScaleType::Locrian] = {0, 1, 3, 5, 6, 8, 10};
-
-    // ===== Minor variants =====
-    scaleTemplates[ScaleType::HarmonicMinor] = {0, 2, 3, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::MelodicMinor] = {0, 2, 3, 5, 7, 9, 11};
-    scaleTemplates[ScaleType::NaturalMinor] = {0, 2, 3, 5, 7, 8, 10};
-
-    // ===== Melodic Minor modes =====
-    scaleTemplates[ScaleType::DorianFlat2] = {0, 1, 3, 5, 7, 9, 10};      // Phrygian #6 / Javanese
-    scaleTemplates[ScaleType::LydianAugmented] = {0, 2, 4, 6, 8, 9, 11};  // Lydian #5
-    scaleTemplates[ScaleType::LydianDominant] = {0, 2, 4, 6, 7, 9, 10};   // Lydian b7 / Overtone
-    scaleTemplates[ScaleType::MixolydianFlat6] = {0, 2, 4, 5, 7, 8, 10};  // Aeolian Dominant / Hindu
-    scaleTemplates[ScaleType::LocrianNatural2] = {0, 2, 3, 5, 6, 8, 10};  // Half-Diminished
-    scaleTemplates[ScaleType::SuperLocrian] = {0, 1, 3, 4, 6, 8, 10};     // Altered / Diminished Whole Tone
-
-    // ===== Harmonic Minor modes =====
-    scaleTemplates[ScaleType::LocrianNatural6] = {0, 1, 3, 5, 6, 9, 10};
-    scaleTemplates[ScaleType::IonianAugmented] = {0, 2, 4, 5, 8, 9, 11};  // Ionian #5
-    scaleTemplates[ScaleType::DorianSharp4] = {0, 2, 3, 6, 7, 9, 10};     // Romanian Minor / Ukrainian Dorian
-    scaleTemplates[ScaleType::PhrygianDominant] = {0, 1, 4, 5, 7, 8, 10}; // Spanish Phrygian / Freygish
-    scaleTemplates[ScaleType::LydianSharp2] = {0, 3, 4, 6, 7, 9, 11};
-    scaleTemplates[ScaleType::SuperLocrianDiminished] = {0, 1, 3, 4, 6, 8, 9}; // Ultra Locrian
-
-    // ===== Harmonic Major modes =====
-    scaleTemplates[ScaleType::HarmonicMajor] = {0, 2, 4, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::DorianFlat5] = {0, 2, 3, 5, 6, 9, 10};
-    scaleTemplates[ScaleType::PhrygianFlat4] = {0, 1, 3, 4, 7, 8, 10};
-    scaleTemplates[ScaleType::LydianFlat3] = {0, 2, 3, 6, 7, 9, 11};
-    scaleTemplates[ScaleType::MixolydianFlat2] = {0, 1, 4, 5, 7, 9, 10};
-    scaleTemplates[ScaleType::LydianAugmentedSharp2] = {0, 3, 4, 6, 8, 9, 11};
-    scaleTemplates[ScaleType::LocrianDiminished7] = {0, 1, 3, 5, 6, 8, 9};
-
-    // ===== Double Harmonic / Byzantine modes =====
-    scaleTemplates[ScaleType::DoubleHarmonic] = {0, 1, 4, 5, 7, 8, 11};   // Byzantine / Arabic / Gypsy Major
-    scaleTemplates[ScaleType::LydianSharp2Sharp6] = {0, 3, 4, 6, 7, 10, 11};
-    scaleTemplates[ScaleType::UltraPhrygian] = {0, 1, 3, 4, 7, 8, 9};
-    scaleTemplates[ScaleType::HungarianMinor] = {0, 2, 3, 6, 7, 8, 11};   // Gypsy Minor
-    scaleTemplates[ScaleType::Oriental] = {0, 1, 4, 5, 6, 9, 10};
-    scaleTemplates[ScaleType::IonianAugmentedSharp2] = {0, 3, 4, 5, 8, 9, 11};
-    scaleTemplates[ScaleType::LocrianDiminished3Diminished7] = {0, 1, 2, 5, 6, 8, 9};
-
-    // ===== Pentatonic scales =====
-    scaleTemplates[ScaleType::MajorPentatonic] = {0, 2, 4, 7, 9};
-    scaleTemplates[ScaleType::MinorPentatonic] = {0, 3, 5, 7, 10};
-    scaleTemplates[ScaleType::EgyptianPentatonic] = {0, 2, 5, 7, 10};     // Suspended Pentatonic
-    scaleTemplates[ScaleType::BluesMinorPentatonic] = {0, 3, 5, 8, 10};   // Man Gong
-    scaleTemplates[ScaleType::BluesMajorPentatonic] = {0, 2, 5, 7, 9};    // Ritusen / Scottish
-    scaleTemplates[ScaleType::JapanesePentatonic] = {0, 1, 5, 7, 8};      // In scale
-    scaleTemplates[ScaleType::ChinesePentatonic] = {0, 2, 4, 7, 9};       // Same as major pentatonic
-
-    // ===== Blues scales =====
-    scaleTemplates[ScaleType::Blues] = {0, 3, 5, 6, 7, 10};               // Minor Blues
-    scaleTemplates[ScaleType::MajorBlues] = {0, 2, 3, 4, 7, 9};           // Major Blues
-
-    // ===== Bebop scales =====
-    scaleTemplates[ScaleType::BebopDominant] = {0, 2, 4, 5, 7, 9, 10, 11};
-    scaleTemplates[ScaleType::BebopMajor] = {0, 2, 4, 5, 7, 8, 9, 11};
-    scaleTemplates[ScaleType::BebopMinor] = {0, 2, 3, 5, 7, 8, 9, 10};
-    scaleTemplates[ScaleType::BebopDorian] = {0, 2, 3, 4, 5, 7, 9, 10};
-
-    // ===== Symmetric scales =====
-    scaleTemplates[ScaleType::Chromatic] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
-    scaleTemplates[ScaleType::WholeTone] = {0, 2, 4, 6, 8, 10};
-    scaleTemplates[ScaleType::Diminished] = {0, 2, 3, 5, 6, 8, 9, 11};    // Whole-Half Diminished
-    scaleTemplates[ScaleType::DiminishedHalfWhole] = {0, 1, 3, 4, 6, 7, 9, 10}; // Half-Whole Diminished
-    scaleTemplates[ScaleType::Augmented] = {0, 3, 4, 7, 8, 11};           // Hexatonic
-
-    // ===== Ethnic / World scales =====
-    scaleTemplates[ScaleType::HungarianMajor] = {0, 3, 4, 6, 7, 9, 10};
-    scaleTemplates[ScaleType::NeapolitanMajor] = {0, 1, 3, 5, 7, 9, 11};
-    scaleTemplates[ScaleType::NeapolitanMinor] = {0, 1, 3, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::Persian] = {0, 1, 4, 5, 6, 8, 11};
-    scaleTemplates[ScaleType::Hirajoshi] = {0, 2, 3, 7, 8};               // Japanese
-    scaleTemplates[ScaleType::Iwato] = {0, 1, 5, 6, 10};                  // Japanese
-    scaleTemplates[ScaleType::Kumoi] = {0, 2, 3, 7, 9};                   // Japanese
-    scaleTemplates[ScaleType::InSen] = {0, 1, 5, 7, 10};                  // Japanese
-    scaleTemplates[ScaleType::Mongolian] = {0, 2, 4, 7, 9};
-    scaleTemplates[ScaleType::Balinese] = {0, 1, 3, 7, 8};
-    scaleTemplates[ScaleType::Pelog] = {0, 1, 3, 7, 10};
-    scaleTemplates[ScaleType::Algerian] = {0, 2, 3, 6, 7, 8, 11};
-    scaleTemplates[ScaleType::Spanish8Tone] = {0, 1, 3, 4, 5, 6, 8, 10};
-    scaleTemplates[ScaleType::Flamenco] = {0, 1, 4, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::Jewish] = {0, 1, 4, 5, 7, 8, 10};           // Ahava Rabbah
-    scaleTemplates[ScaleType::Gypsy] = {0, 2, 3, 6, 7, 8, 10};
-    scaleTemplates[ScaleType::Romanian] = {0, 2, 3, 6, 7, 9, 10};
-    scaleTemplates[ScaleType::Hawaiian] = {0, 2, 3, 5, 7, 9, 11};
-    scaleTemplates[ScaleType::Ethiopian] = {0, 2, 4, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::Arabic] = {0, 2, 4, 5, 6, 8, 10};
-
-    // ===== Jazz scales =====
-    scaleTemplates[ScaleType::Enigmatic] = {0, 1, 4, 6, 8, 10, 11};
-    scaleTemplates[ScaleType::LeadingWholeTone] = {0, 2, 4, 6, 8, 10, 11};
-    scaleTemplates[ScaleType::SixToneSymmetric] = {0, 1, 4, 5, 8, 9};
-    scaleTemplates[ScaleType::Prometheus] = {0, 2, 4, 6, 9, 10};
-    scaleTemplates[ScaleType::PrometheusNeapolitan] = {0, 1, 4, 6, 9, 10};
-    scaleTemplates[ScaleType::Tritone] = {0, 1, 4, 6, 7, 10};
-    scaleTemplates[ScaleType::TwoSemitoneTritone] = {0, 1, 2, 6, 7, 8};
-
-    // ===== Modal variations =====
-    scaleTemplates[ScaleType::MajorLocrian] = {0, 2, 4, 5, 6, 8, 10};
-    scaleTemplates[ScaleType::ArabicMaqam] = {0, 1, 4, 5, 7, 8, 11};
-    scaleTemplates[ScaleType::Istrian] = {0, 1, 3, 4, 6, 7};
-    scaleTemplates[ScaleType::UkrainianDorian] = {0, 2, 3, 6, 7, 9, 10};
+void ScaleDetector::setChordWindow(ChordWindow mode, double length) {
+    chordWindow = mode;
+    if (length > 0.0) {
+        chordWindowLength = length;
+    }
+}
+
+void ScaleDetector::setKeyChangeWindow(double windowSeconds, double hopSeconds) {
+    if (windowSeconds > 0.0 && hopSeconds > 0.0) {
+        keyChangeWindow = windowSeconds;
+        keyChangeHop = hopSeconds;
+    }
 }
 
 void ScaleDetector::initializeKeyProfiles() {
-    // Krumhansl-Schmuckler major key profile
-    majorProfile = {
-        6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88
-    };
-    // Krumhansl-Schmuckler minor key profile
-    minorProfile = {
-        6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17
-    };
+    majorProfile = kMajorKeyProfile;
+    minorProfile = kMinorKeyProfile;
 }
 
 HarmonicAnalysis ScaleDetector::analyze(const MIDIFile& midiFile) {
@@ -169,144 +160,242 @@ HarmonicAnalysis ScaleDetector::analyze(const MIDIFile& midiFile) {
 HarmonicAnalysis ScaleDetector::analyzeRange(const MIDIFile& midiFile,
                                              double startTime, double endTime) {
     HarmonicAnalysis result;
-    std::vector<MIDIEvent> events = midiFile.getNoteEventsInRange(startTime, endTime);
-    if (events.empty()) {
-        return result;
-    }
-    result.noteWeights = calculateWeightedHistogram(events, midiFile);
-    result.primaryScale = findBestScale(result.noteWeights);
-    result.alternativeScales = findAlternativeScales(result.noteWeights, result.primaryScale);
-    result.chordProgression = detectChordProgressions(midiFile, result.primaryScale);
-    if (detectKeyChangesEnabled && (endTime - startTime) > 8.0) {
-        result.keyChanges = this->detectKeyChanges(midiFile);
-    }
-    result.noteDistribution = calculateNoteDistribution(events);
-    result.totalNotes = events.size();
-    double pitchSum = 0.0;
-    for (const auto& event : events) {
-        if (event.type == EventType::NoteOn) {
-            pitchSum += event.note;
+    analyzeRange(midiFile, startTime, endTime, defaultContext, result);
+    return result;
+}
+
+void ScaleDetector::analyze(const MIDIFile& midiFile, AnalysisContext& context,
+                            HarmonicAnalysis& result) const {
+    analyzeRange(midiFile, 0.0, midiFile.getDuration(), context, result);
+}
+
+void ScaleDetector::analyzeRange(const MIDIFile& midiFile, double startTime, double endTime,
+                                 AnalysisContext& context, HarmonicAnalysis& result) const {
+    result.clear();
+    // Files parsed without a note table get one built into the context
+    if (!midiFile.notes.empty()) {
+        analyzeNotes(midiFile, midiFile.notes, startTime, endTime, context, result);
+        return;
+    }
+    context.notes.build(midiFile.tracks, midiFile.tempoMap);
+    analyzeNotes(midiFile, context.notes, startTime, endTime, context, result);
+}
+
+void ScaleDetector::analyzeBatch(const MIDIFile* files, size_t count, HarmonicAnalysis* results,
+                                 AnalysisContext& context) const {
+    for (size_t i = 0; i < count; ++i) {
+        analyze(files[i], context, results[i]);
+    }
+}
+
+void ScaleDetector::summarize(const MIDIFile& midiFile, double duration, AnalysisContext& context,
+                              FileSummary& summary) const {
+    analyzeRange(midiFile, 0.0, duration, context, summary.analysis);
+    describe(midiFile, midiFile.notes.empty() ? context.notes : midiFile.notes, duration, summary);
+}
+
+void ScaleDetector::summarize(const MIDIFile& midiFile, double duration, const HarmonicAnalysis& analysis,
+                              AnalysisContext& context, FileSummary& summary) const {
+    if (analysis.level < analysisLevel) {
+        summarize(midiFile, duration, context, summary);
+        return;
+    }
+    summary.analysis = analysis;
+    if (!midiFile.notes.empty()) {
+        describe(midiFile, midiFile.notes, duration, summary);
+        return;
+    }
+    context.notes.build(midiFile.tracks, midiFile.tempoMap);
+    describe(midiFile, context.notes, duration, summary);
+}
+
+void ScaleDetector::describe(const MIDIFile& midiFile, const NoteTable& notes, double duration,
+                             FileSummary& summary) const {
+    summary.parentMajor = parentMajorKey(summary.analysis.primaryScale);
+    summary.relativeMinor = intToNoteName(static_cast<int>(summary.parentMajor) + 9);
+    summary.tempo = midiFile.tempo;
+    summary.duration = duration;
+    summary.mood = classifyMood(summary.analysis.primaryScale, summary.tempo);
+
+    // Earliest program change; events are in tick order within a track
+    summary.program = -1;
+    uint32_t programTick = 0;
+    for (const auto& track : midiFile.tracks) {
+        for (const auto& event : track.events) {
+            if (event.type == EventType::ProgramChange) {
+                if (summary.program < 0 || event.tick < programTick) {
+                    summary.program = event.program();
+                    programTick = event.tick;
+                }
+                break;
+            }
         }
     }
-    result.averagePitch = pitchSum / result.totalNotes;
-    return result;
+
+    // Notes starting within 20 ms of the first in a group sound together;
+    // a group with two different pitches is a chord
+    constexpr double kOnsetWindow = 0.020;
+    summary.containsChords = false;
+    summary.containsSingleNotes = false;
+    for (size_t i = 0; i < notes.size();) {
+        size_t next = i + 1;
+        bool chord = false;
+        for (; next < notes.size() && notes.startTime[next] - notes.startTime[i] <= kOnsetWindow; ++next) {
+            chord = chord || notes.pitch[next] != notes.pitch[i];
+        }
+        (chord ? summary.containsChords : summary.containsSingleNotes) = true;
+        i = next;
+    }
 }
 
-std::array<double, 12> ScaleDetector::buildNoteHistogram(const std::vector<MIDIEvent>& events) {
-    std::array<double, 12> histogram;
-    histogram.fill(0.0);
-    for (const auto& event : events) {
-        if (event.type == EventType::NoteOn) {
-            int pitchClass = noteToPitchClass(event.note);
-            histogram[pitchClass] += 1.0;
+void ScaleDetector::upgrade(const MIDIFile& midiFile, AnalysisLevel level, AnalysisContext& context,
+                            HarmonicAnalysis& result) const {
+    if (result.level >= level) {
+        return;
+    }
+    if (result.totalNotes > 0) {
+        if (result.level < AnalysisLevel::KeyAndAlternatives) {
+            ScaleScores scores;
+            scorer->score(result.noteWeights, scores);
+            findAlternativeScales(scores, result.primaryScale, result.alternativeScales);
+        }
+        if (level == AnalysisLevel::Full) {
+            const NoteTable* notes = &midiFile.notes;
+            if (notes->empty()) {
+                context.notes.build(midiFile.tracks, midiFile.tempoMap);
+                notes = &context.notes;
+            }
+            addTimelines(midiFile, *notes, 0.0, midiFile.getDuration(), context, result);
         }
     }
-    return histogram;
+    result.level = level;
+}
+
+void ScaleDetector::analyzeNotes(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                                 double endTime, AnalysisContext& context,
+                                 HarmonicAnalysis& result) const {
+    result.level = analysisLevel;
+
+    // Notes starting inside the range form one contiguous run of the table
+    size_t first = notes.lowerBound(startTime);
+    size_t last = first;
+    while (last < notes.size() && notes.startTime[last] <= endTime) {
+        ++last;
+    }
+    if (first == last) {
+        return;
+    }
+
+    result.noteWeights = calculateWeightedHistogram(notes, first, last, endTime);
+    scoreAndDetect(result.noteWeights, &midiFile, startTime, result);
+    if (analysisLevel == AnalysisLevel::Full) {
+        addTimelines(midiFile, notes, startTime, endTime, context, result);
+    }
+    result.totalNotes = static_cast<int>(last - first);
+    double pitchSum = 0.0;
+    for (size_t i = first; i < last; ++i) {
+        result.noteDistribution[notes.pitch[i] & 0x7F]++;
+        pitchSum += notes.pitch[i];
+    }
+    result.averagePitch = pitchSum / result.totalNotes;
+}
+
+bool ScaleDetector::analyzeStream(const std::string& filePath, StreamingParser& parser,
+                                  HarmonicAnalysis& result) {
+    result.clear();
+
+    NoteAccumulator accumulator(weightByDuration, weightByVelocity);
+    parser.setParseOptions(ParseNotesOnly);
+    if (!parser.parse(filePath, accumulator)) {
+        return false;
+    }
+    if (accumulator.noteCount == 0) {
+        return true;
+    }
+
+    // Chords and key changes need the note list, so a stream stops short of Full
+    result.level = std::min(analysisLevel, AnalysisLevel::KeyAndAlternatives);
+    result.noteWeights = accumulator.histogram;
+    normalizeHistogram(result.noteWeights);
+    scoreAndDetect(result.noteWeights, nullptr, 0.0, result);
+    result.noteDistribution = accumulator.pitchCounts;
+    result.totalNotes = static_cast<int>(accumulator.noteCount);
+    result.averagePitch = accumulator.pitchSum / accumulator.noteCount;
+    return true;
 }
 
 std::array<double, 12> ScaleDetector::calculateWeightedHistogram(
-    const std::vector<MIDIEvent>& events, const MIDIFile& midiFile) {
+    const NoteTable& notes, size_t first, size_t last, double endTime) const {
     std::array<double, 12> histogram;
     histogram.fill(0.0);
-    std::map<int, MIDIEvent> activeNotes;
-    for (const auto& event : events) {
-        int pitchClass = noteToPitchClass(event.note);
-        if (event.type == EventType::NoteOn && event.velocity > 0) {
-            activeNotes[event.note] = event;
-        } else if (event.type == EventType::NoteOff ||
-                  (event.type == EventType::NoteOn && event.velocity == 0)) {
-            if (activeNotes.find(event.note) != activeNotes.end()) {
-                MIDIEvent noteOn = activeNotes[event.note];
-                double weight = 1.0;
-                if (weightByDuration) {
-                    double duration = event.timestamp - noteOn.timestamp;
-                    weight *= duration;
-                }
-                if (weightByVelocity) {
-                    weight *= (noteOn.velocity / 127.0);
-                }
-                histogram[pitchClass] += weight;
-                activeNotes.erase(event.note);
-            }
-        }
-    }
-    for (const auto& pair : activeNotes) {
-        int pitchClass = noteToPitchClass(pair.first);
+    for (size_t i = first; i < last; ++i) {
         double weight = 1.0;
+        if (weightByDuration) {
+            // Notes held past the end of the range only count up to it
+            weight *= std::min(notes.endTime[i], endTime) - notes.startTime[i];
+        }
         if (weightByVelocity) {
-            weight *= (pair.second.velocity / 127.0);
+            weight *= (notes.velocity[i] / 127.0);
         }
-        histogram[pitchClass] += weight;
+        histogram[noteToPitchClass(notes.pitch[i])] += weight;
     }
     normalizeHistogram(histogram);
     return histogram;
 }
 
-double ScaleDetector::correlate(const std::array<double, 12>& histogram,
-                                const std::array<double, 12>& profile) const {
-    double meanH = std::accumulate(histogram.begin(), histogram.end(), 0.0) / 12.0;
-    double meanP = std::accumulate(profile.begin(), profile.end(), 0.0) / 12.0;
-    double numerator = 0.0;
-    double denomH = 0.0;
-    double denomP = 0.0;
-    for (int i = 0; i < 12; ++i) {
-        double diffH = histogram[i] - meanH;
-        double diffP = profile[i] - meanP;
-        numerator += diffH * diffP;
-        denomH += diffH * diffH;
-        denomP += diffP * diffP;
+void ScaleDetector::scoreAndDetect(const std::array<double, 12>& histogram, const MIDIFile* midiFile,
+                                   double startTime, HarmonicAnalysis& result) const {
+    // One pass scores every key and template; the choices below only read it
+    ScaleScores scores;
+    scorer->score(histogram, scores);
+
+    result.usedDeclaredKey = useDeclaredKey && midiFile != nullptr &&
+        matchDeclaredKey(*midiFile, startTime, scores, result.primaryScale);
+    if (!result.usedDeclaredKey) {
+        result.primaryScale = findBestScale(scores);
     }
-    if (denomH == 0.0 || denomP == 0.0) {
-        return 0.0;
+    if (result.level >= AnalysisLevel::KeyAndAlternatives) {
+        findAlternativeScales(scores, result.primaryScale, result.alternativeScales);
     }
-    return numerator / std::sqrt(denomH * denomP);
 }
 
-Scale ScaleDetector::findBestScale(const std::array<double, 12>& histogram) {
+void ScaleDetector::addTimelines(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                                 double endTime, AnalysisContext& context, HarmonicAnalysis& result) const {
+    detectChords(midiFile, notes, startTime, endTime, context, result);
+    if (detectKeyChangesEnabled &&
+        (keyChangeMethod == KeyChangeMethod::Viterbi || (endTime - startTime) > 2.0 * keyChangeWindow)) {
+        detectKeyChanges(midiFile, notes, startTime, endTime, context, result.keyChanges);
+    }
+}
+
+Scale ScaleDetector::findBestScale(const ScaleScores& scores) const {
     Scale bestScale;
     double bestCorrelation = -1.0;
 
     for (int root = 0; root < 12; ++root) {
-        std::array<double, 12> rotatedHistogram;
-        for (int i = 0; i < 12; ++i) {
-            rotatedHistogram[i] = histogram[(i + root) % 12];
-        }
-        double majorCorr = correlate(rotatedHistogram, majorProfile);
+        double majorCorr = scores.majorCorrelation(root);
         if (majorCorr > bestCorrelation) {
             bestCorrelation = majorCorr;
-            bestScale.root = intToNoteName(root);
-            bestScale.type = ScaleType::Ionian;
-            bestScale.intervals = scaleTemplates[ScaleType::Ionian];
-            bestScale.confidence = (majorCorr + 1.0) / 2.0;
+            bestScale = Scale(intToNoteName(root), ScaleType::Ionian, (majorCorr + 1.0) / 2.0);
         }
-        double minorCorr = correlate(rotatedHistogram, minorProfile);
+        double minorCorr = scores.minorCorrelation(root);
         if (minorCorr > bestCorrelation) {
             bestCorrelation = minorCorr;
-            bestScale.root = intToNoteName(root);
-            bestScale.type = ScaleType::Aeolian;
-            bestScale.intervals = scaleTemplates[ScaleType::Aeolian];
-            bestScale.confidence = (minorCorr + 1.0) / 2.0;
+            bestScale = Scale(intToNoteName(root), ScaleType::Aeolian, (minorCorr + 1.0) / 2.0);
         }
     }
 
     if (bestScale.type != ScaleType::Unknown) {
         int rootPitch = static_cast<int>(bestScale.root);
-        for (const auto& templatePair : scaleTemplates) {
-            if (templatePair.first == ScaleType::Ionian ||
-                templatePair.first == ScaleType::Aeolian) {
+        for (const auto& scaleTemplate : kScaleTemplates) {
+            if (scaleTemplate.type == ScaleType::Ionian ||
+                scaleTemplate.type == ScaleType::Aeolian) {
                 continue;
             }
-            double matchScore = 0.0;
-            double totalWeight = 0.0;
-            for (int interval : templatePair.second) {
-                int pitchClass = (rootPitch + interval) % 12;
-                matchScore += histogram[pitchClass];
-                totalWeight += 1.0;
-            }
-            matchScore /= totalWeight;
+            double matchScore = scores.templateMatch(scaleTemplate.type, rootPitch);
             if (matchScore > bestScale.confidence) {
-                bestScale.type = templatePair.first;
-                bestScale.intervals = templatePair.second;
+                bestScale.type = scaleTemplate.type;
+                bestScale.mask = scaleTemplate.mask;
                 bestScale.confidence = matchScore;
             }
         }
@@ -314,128 +403,156 @@ Scale ScaleDetector::findBestScale(const std::array<double, 12>& histogram) {
     return bestScale;
 }
 
-std::vector<Scale> ScaleDetector::findAlternativeScales(
-    const std::array<double, 12>& histogram, const Scale& primaryScale) {
-    std::vector<Scale> alternatives;
-    for (int root = 0; root < 12; ++root) {
-        std::array<double, 12> rotatedHistogram;
-        for (int i = 0; i < 12; ++i) {
-            rotatedHistogram[i] = histogram[(i + root) % 12];
-        }
-        double majorCorr = correlate(rotatedHistogram, majorProfile);
-        double minorCorr = correlate(rotatedHistogram, minorProfile);
-        double majorConf = (majorCorr + 1.0) / 2.0;
-        double minorConf = (minorCorr + 1.0) / 2.0;
-        if (majorConf >= minConfidence &&
-            (root != static_cast<int>(primaryScale.root) ||
-             ScaleType::Ionian != primaryScale.type)) {
-            Scale alt;
-            alt.root = intToNoteName(root);
-            alt.type = ScaleType::Ionian;
-            alt.intervals = scaleTemplates[ScaleType::Ionian];
-            alt.confidence = majorConf;
-            alternatives.push_back(alt);
-        }
-        if (minorConf >= minConfidence &&
-            (root != static_cast<int>(primaryScale.root) ||
-             ScaleType::Aeolian != primaryScale.type)) {
-            Scale alt;
-            alt.root = intToNoteName(root);
-            alt.type = ScaleType::Aeolian;
-            alt.intervals = scaleTemplates[ScaleType::Aeolian];
-            alt.confidence = minorConf;
-            alternatives.push_back(alt);
+bool ScaleDetector::matchDeclaredKey(const MIDIFile& midiFile, double time,
+                                     const ScaleScores& scores, Scale& scale) const {
+    // Key signature in effect at the start of the range
+    const KeySignature* declared = nullptr;
+    for (const auto& signature : midiFile.keySignatures) {
+        if (signature.time > time && declared != nullptr) {
+            break;
         }
+        declared = &signature;
+    }
+    if (declared == nullptr) {
+        return false;
+    }
+
+    // Quick check: the declared key must correlate about as well as the best
+    // of the 24 major/minor keys. Many files carry a default C major
+    // signature, so an unsupported declaration falls back to the full sweep.
+    static constexpr double kAgreementMargin = 0.02;
+
+    int declaredRoot = declared->getTonicPitchClass();
+    double declaredCorrelation = declared->minor ? scores.minorCorrelation(declaredRoot)
+                                                 : scores.majorCorrelation(declaredRoot);
+    double bestCorrelation = -1.0;
+    for (int root = 0; root < 12; ++root) {
+        bestCorrelation = std::max(bestCorrelation,
+                                   std::max(scores.majorCorrelation(root), scores.minorCorrelation(root)));
+    }
+
+    double confidence = (declaredCorrelation + 1.0) / 2.0;
+    if (declaredCorrelation < bestCorrelation - kAgreementMargin || confidence < minConfidence) {
+        return false;
     }
-    std::sort(alternatives.begin(), alternatives.end(),
-             [](const Scale& a, const Scale& b) {
-                 return a.confidence > b.confidence;
-             });
+
+    scale = Scale(intToNoteName(declaredRoot), declared->minor ? ScaleType::Aeolian : ScaleType::Ionian,
+                  confidence);
+    return true;
+}
+
+void ScaleDetector::findAlternativeScales(const ScaleScores& scores, const Scale& primaryScale,
+                                          std::vector<Scale>& alternatives) const {
+    // The primary key can take one of the top slots, so ask for one extra
+    scorer->topKeys(scores, 4, alternatives);
+    alternatives.erase(std::remove_if(alternatives.begin(), alternatives.end(),
+                                      [&](const Scale& alt) {
+                                          return alt.confidence < minConfidence ||
+                                                 (alt.root == primaryScale.root &&
+                                                  alt.type == primaryScale.type);
+                                      }),
+                       alternatives.end());
     if (alternatives.size() > 3) {
         alternatives.resize(3);
     }
-    return alternatives;
-}
-
-std::vector<std::pair<double, Scale>> ScaleDetector::detectKeyChanges(const MIDIFile& midiFile) {
-    std::vector<std::pair<double, Scale>> keyChanges;
-    double duration = midiFile.getDuration();
-    double windowSize = 4.0;
-    double hopSize = 2.0;
-    Scale previousScale;
-    previousScale.type = ScaleType::Unknown;
-    for (double time = 0.0; time < duration; time += hopSize) {
-        double endTime = std::min(time + windowSize, duration);
-        HarmonicAnalysis analysis = analyzeRange(midiFile, time, endTime);
-        if (previousScale.type != ScaleType::Unknown &&
-            (analysis.primaryScale.root != previousScale.root ||
-             analysis.primaryScale.type != previousScale.type) &&
-            analysis.primaryScale.confidence >= minConfidence) {
-            keyChanges.push_back({time, analysis.primaryScale});
-        }
-        previousScale = analysis.primaryScale;
-    }
-    return keyChanges;
 }
 
-std::vector<std::string> ScaleDetector::detectChordProgressions(
-    const MIDIFile& midiFile, const Scale& scale) {
-    std::vector<std::string> progression;
-    double duration = midiFile.getDuration();
-    double windowSize = 1.0;
-    auto allEvents = midiFile.getAllNoteEvents();
-    for (double time = 0.0; time < duration; time += windowSize) {
-        std::string chord = analyzeChord(allEvents, time, time + windowSize);
-        if (!chord.empty() && (progression.empty() || progression.back() != chord)) {
-            progression.push_back(chord);
-        }
+void ScaleDetector::detectKeyChanges(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                                     double endTime, AnalysisContext& context,
+                                     std::vector<std::pair<double, Scale>>& keyChanges) const {
+    // Each window's histogram is two prefix lookups, so the whole pass is
+    // one sort of note ends plus a key scoring per hop
+    keyChanges.clear();
+    PitchClassTimeline& keyTimeline = context.keyTimeline;
+    keyTimeline.build(notes, weightByDuration, weightByVelocity);
+    if (keyChangeMethod == KeyChangeMethod::Viterbi) {
+        segmentKeys(midiFile, startTime, endTime, context, keyChanges);
+        return;
     }
-    return progression;
-}
-
-std::string ScaleDetector::analyzeChord(const std::vector<MIDIEvent>& events,
-                                       double windowStart, double windowEnd) {
-    std::array<int, 12> activeNotes;
-    activeNotes.fill(0);
-    std::map<int, MIDIEvent> noteStates;
-    for (const auto& event : events) {
-        if (event.timestamp > windowEnd) break;
-        if (event.type == EventType::NoteOn && event.velocity > 0) {
-            noteStates[event.note] = event;
-        } else if (event.type == EventType::NoteOff ||
-                  (event.type == EventType::NoteOn && event.velocity == 0)) {
-            noteStates.erase(event.note);
+
+    ScaleScores scores;
+    std::array<double, 12> histogram;
+    Scale currentKey;           // Last reported (or first confident) key
+    Scale candidateKey;         // Challenger and where its run began
+    double candidateStart = 0.0;
+    int candidateWindows = 0;
+    for (double time = startTime; time < endTime; time += keyChangeHop) {
+        double windowEnd = std::min(time + keyChangeWindow, endTime);
+        keyTimeline.histogram(time, windowEnd, histogram);
+        if (std::all_of(histogram.begin(), histogram.end(), [](double weight) { return weight <= 0.0; })) {
+            // Silence neither confirms nor breaks the current key
+            candidateWindows = 0;
+            continue;
         }
-        if (event.timestamp >= windowStart && event.timestamp <= windowEnd) {
-            for (const auto& pair : noteStates) {
-                int pitchClass = pair.first % 12;
-                activeNotes[pitchClass] = 1;
-            }
+        normalizeHistogram(histogram);
+        scorer->score(histogram, scores);
+
+        Scale windowKey;
+        if (!(useDeclaredKey && matchDeclaredKey(midiFile, time, scores, windowKey))) {
+            windowKey = findBestScale(scores);
         }
-    }
-    std::vector<int> activePitches;
-    for (int i = 0; i < 12; ++i) {
-        if (activeNotes[i] > 0) {
-            activePitches.push_back(i);
+        if (windowKey.confidence < minConfidence) {
+            candidateWindows = 0;
+            continue;
+        }
+        if (currentKey.type == ScaleType::Unknown) {
+            currentKey = windowKey;
+            continue;
+        }
+
+        bool sameAsCurrent = windowKey.root == currentKey.root && windowKey.type == currentKey.type;
+        if (sameAsCurrent) {
+            candidateWindows = 0;
+            continue;
+        }
+        if (candidateWindows == 0 || windowKey.root != candidateKey.root || windowKey.type != candidateKey.type) {
+            candidateKey = windowKey;
+            candidateStart = time;
+            candidateWindows = 0;
+        }
+        if (++candidateWindows >= keyChangeHysteresis) {
+            keyChanges.push_back({candidateStart, windowKey});
+            currentKey = windowKey;
+            candidateWindows = 0;
         }
     }
-    if (activePitches.size() < 2) {
-        return "";
+}
+
+void ScaleDetector::segmentKeys(const MIDIFile& midiFile, double startTime, double endTime,
+                                AnalysisContext& context,
+                                std::vector<std::pair<double, Scale>>& keyChanges) const {
+    context.keySegmenter.setSwitchProbability(keySwitchProbability);
+    context.keySegmenter.segment(context.keyTimeline, midiFile.tempoMap, startTime, endTime,
+                                 context.keySegments);
+
+    // Every segment after the first is a change; confidence is the
+    // segment's correlation with its key, as for the primary scale
+    ScaleScores scores;
+    std::array<double, 12> histogram;
+    for (size_t i = 1; i < context.keySegments.size(); ++i) {
+        const KeySegment& segment = context.keySegments[i];
+        context.keyTimeline.histogram(segment.startTime, segment.endTime, histogram);
+        normalizeHistogram(histogram);
+        scorer->score(histogram, scores);
+        double correlation = scores.values[static_cast<size_t>(segment.key)];
+        keyChanges.push_back({segment.startTime,
+                              Scale(intToNoteName(segment.key % 12),
+                                    segment.key < 12 ? ScaleType::Ionian : ScaleType::Aeolian,
+                                    (correlation + 1.0) / 2.0)});
     }
-    std::ostringstream oss;
-    oss << noteNameToString(intToNoteName(activePitches[0]));
-    return oss.str();
 }
 
-std::map<int, int> ScaleDetector::calculateNoteDistribution(
-    const std::vector<MIDIEvent>& events) {
-    std::map<int, int> distribution;
-    for (const auto& event : events) {
-        if (event.type == EventType::NoteOn) {
-            distribution[event.note]++;
+void ScaleDetector::detectChords(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                                 double endTime, AnalysisContext& context, HarmonicAnalysis& result) const {
+    context.chordDetector->setWindow(chordWindow, chordWindowLength);
+    context.chordDetector->detect(notes, midiFile.tempoMap, startTime, endTime, result.chords);
+    result.chordProgression.clear();
+    for (const Chord& chord : result.chords) {
+        std::string name = chord.getName();
+        if (result.chordProgression.empty() || result.chordProgression.back() != name) {
+            result.chordProgression.push_back(std::move(name));
         }
     }
-    return distribution;
 }
 
 void ScaleDetector::normalizeHistogram(std::array<double, 12>& histogram) const {
@@ -449,120 +566,7 @@ void ScaleDetector::normalizeHistogram(std::array<double, 12>& histogram) const
 
 // Utility functions
 std::string scaleTypeToString(ScaleType type) {
-    switch (type) {
-        // Major modes
-        case ScaleType::Ionian: return "Major";
-        case ScaleType::Dorian: return "Dorian";
-        case ScaleType::Phrygian: return "Phrygian";
-        case ScaleType::Lydian: return "Lydian";
-        case ScaleType::Mixolydian: return "Mixolydian";
-        case ScaleType::Aeolian: return "Minor";
-        case ScaleType::Locrian: return "Locrian";
-
-        // Minor variants
-        case ScaleType::HarmonicMinor: return "Harmonic Minor";
-        case ScaleType::MelodicMinor: return "Melodic Minor";
-        case ScaleType::NaturalMinor: return "Natural Minor";
-
-        // Melodic Minor modes
-        case ScaleType::DorianFlat2: return "Dorian b2";
-        case ScaleType::LydianAugmented: return "Lydian Augmented";
-        case ScaleType::LydianDominant: return "Lydian Dominant";
-        case ScaleType::MixolydianFlat6: return "Mixolydian b6";
-        case ScaleType::LocrianNatural2: return "Locrian #2";
-        case ScaleType::SuperLocrian: return "Super Locrian";
-
-        // Harmonic Minor modes
-        case ScaleType::LocrianNatural6: return "Locrian #6";
-        case ScaleType::IonianAugmented: return "Ionian Augmented";
-        case ScaleType::DorianSharp4: return "Dorian #4";
-        case ScaleType::PhrygianDominant: return "Phrygian Dominant";
-        case ScaleType::LydianSharp2: return "Lydian #2";
-        case ScaleType::SuperLocrianDiminished: return "Super Locrian Diminished";
-
-        // Harmonic Major modes
-        case ScaleType::HarmonicMajor: return "Harmonic Major";
-        case ScaleType::DorianFlat5: return "Dorian b5";
-        case ScaleType::PhrygianFlat4: return "Phrygian b4";
-        case ScaleType::LydianFlat3: return "Lydian b3";
-        case ScaleType::MixolydianFlat2: return "Mixolydian b2";
-        case ScaleType::LydianAugmentedSharp2: return "Lydian Augmented #2";
-        case ScaleType::LocrianDiminished7: return "Locrian Diminished 7";
-
-        // Double Harmonic modes
-        case ScaleType::DoubleHarmonic: return "Double Harmonic";
-        case ScaleType::LydianSharp2Sharp6: return "Lydian #2 #6";
-        case ScaleType::UltraPhrygian: return "Ultra Phrygian";
-        case ScaleType::HungarianMinor: return "Hungarian Minor";
-        case ScaleType::Oriental: return "Oriental";
-        case ScaleType::IonianAugmentedSharp2: return "Ionian Augmented #2";
-        case ScaleType::LocrianDiminished3Diminished7: return "Locrian bb3 bb7";
-
-        // Pentatonic
-        case ScaleType::MajorPentatonic: return "Major Pentatonic";
-        case ScaleType::MinorPentatonic: return "Minor Pentatonic";
-        case ScaleType::EgyptianPentatonic: return "Egyptian";
-        case ScaleType::BluesMinorPentatonic: return "Blues Minor Pentatonic";
-        case ScaleType::BluesMajorPentatonic: return "Blues Major Pentatonic";
-        case ScaleType::JapanesePentatonic: return "Japanese";
-        case ScaleType::ChinesePentatonic: return "Chinese";
-
-        // Blues
-        case ScaleType::Blues: return "Blues";
-        case ScaleType::MajorBlues: return "Major Blues";
-
-        // Bebop
-        case ScaleType::BebopDominant: return "Bebop Dominant";
-        case ScaleType::BebopMajor: return "Bebop Major";
-        case ScaleType::BebopMinor: return "Bebop Minor";
-        case ScaleType::BebopDorian: return "Bebop Dorian";
-
-        // Symmetric
-        case ScaleType::Chromatic: return "Chromatic";
-        case ScaleType::WholeTone: return "Whole Tone";
-        case ScaleType::Diminished: return "Diminished";
-        case ScaleType::DiminishedHalfWhole: return "Diminished Half-Whole";
-        case ScaleType::Augmented: return "Augmented";
-
-        // Ethnic / World
-        case ScaleType::HungarianMajor: return "Hungarian Major";
-        case ScaleType::NeapolitanMajor: return "Neapolitan Major";
-        case ScaleType::NeapolitanMinor: return "Neapolitan Minor";
-        case ScaleType::Persian: return "Persian";
-        case ScaleType::Hirajoshi: return "Hirajoshi";
-        case ScaleType::Iwato: return "Iwato";
-        case ScaleType::Kumoi: return "Kumoi";
-        case ScaleType::InSen: return "In Sen";
-        case ScaleType::Mongolian: return "Mongolian";
-        case ScaleType::Balinese: return "Balinese";
-        case ScaleType::Pelog: return "Pelog";
-        case ScaleType::Algerian: return "Algerian";
-        case ScaleType::Spanish8Tone: return "Spanish 8-Tone";
-        case ScaleType::Flamenco: return "Flamenco";
-        case ScaleType::Jewish: return "Jewish";
-        case ScaleType::Gypsy: return "Gypsy";
-        case ScaleType::Romanian: return "Romanian";
-        case ScaleType::Hawaiian: return "Hawaiian";
-        case ScaleType::Ethiopian: return "Ethiopian";
-        case ScaleType::Arabic: return "Arabic";
-
-        // Jazz
-        case ScaleType::Enigmatic: return "Enigmatic";
-        case ScaleType::LeadingWholeTone: return "Leading Whole Tone";
-        case ScaleType::SixToneSymmetric: return "Six-Tone Symmetric";
-        case ScaleType::Prometheus: return "Prometheus";
-        case ScaleType::PrometheusNeapolitan: return "Prometheus Neapolitan";
-        case ScaleType::Tritone: return "Tritone";
-        case ScaleType::TwoSemitoneTritone: return "Two-Semitone Tritone";
-
-        // Modal variations
-        case ScaleType::MajorLocrian: return "Major Locrian";
-        case ScaleType::ArabicMaqam: return "Arabic Maqam";
-        case ScaleType::Istrian: return "Istrian";
-        case ScaleType::UkrainianDorian: return "Ukrainian Dorian";
-
-        default: return "Unknown";
-    }
+    return std::string(scaleTypeName(type));
 }
 
 std::string noteNameToString(NoteName note) {
@@ -587,4 +591,73 @@ NoteName intToNoteName(int pitchClass) {
     return static_cast<NoteName>(pitchClass % 12);
 }
 
+NoteName parentMajorKey(const Scale& scale) {
+    int root = static_cast<int>(scale.root);
+    switch (scale.type) {
+        case ScaleType::Dorian: return intToNoteName(root + 10);
+        case ScaleType::Phrygian: return intToNoteName(root + 8);
+        case ScaleType::Lydian: return intToNoteName(root + 7);
+        case ScaleType::Mixolydian: return intToNoteName(root + 5);
+        case ScaleType::Locrian: return intToNoteName(root + 1);
+        case ScaleType::Aeolian:
+        case ScaleType::NaturalMinor:
+        case ScaleType::HarmonicMinor:
+        case ScaleType::MelodicMinor:
+        case ScaleType::MinorPentatonic:
+        case ScaleType::Blues:
+            return intToNoteName(root + 3);
+        default:
+            // Major scales are their own parent; other scales show the
+            // parallel major
+            return scale.root;
+    }
+}
+
+Mood classifyMood(const Scale& scale, double tempo) {
+    bool slow = tempo < 80.0;
+    bool fast = tempo >= 120.0;
+    switch (scale.type) {
+        case ScaleType::Dorian: return fast ? Mood::Funky : Mood::Soulful;
+        case ScaleType::Blues: return slow ? Mood::Sorrowful : Mood::Bluesy;
+        case ScaleType::Lydian: return Mood::Dreamy;
+        case ScaleType::Phrygian:
+        case ScaleType::PhrygianDominant:
+            return Mood::Exotic;
+        case ScaleType::Unknown: return Mood::Mysterious;
+        default: break;
+    }
+
+    // Otherwise the third decides between the major and minor moods
+    PitchClassMask mask = scaleMask(scale.type);
+    bool minorThird = (mask >> 3) & 1;
+    bool majorThird = (mask >> 4) & 1;
+    if (majorThird && !minorThird) {
+        return fast ? Mood::Joyful : slow ? Mood::Peaceful : Mood::Happy;
+    }
+    if (minorThird && !majorThird) {
+        return fast ? Mood::Intense : slow ? Mood::Melancholic : Mood::Emotional;
+    }
+    return countPitchClasses(mask) == 5 ? Mood::Ethereal : Mood::Mysterious;
+}
+
+const char* moodName(Mood mood) {
+    switch (mood) {
+        case Mood::Joyful: return "Joyful";
+        case Mood::Happy: return "Happy";
+        case Mood::Peaceful: return "Peaceful";
+        case Mood::Intense: return "Intense";
+        case Mood::Emotional: return "Emotional";
+        case Mood::Melancholic: return "Melancholic";
+        case Mood::Funky: return "Funky";
+        case Mood::Soulful: return "Soulful";
+        case Mood::Bluesy: return "Bluesy";
+        case Mood::Sorrowful: return "Sorrowful";
+        case Mood::Dreamy: return "Dreamy";
+        case Mood::Exotic: return "Exotic";
+        case Mood::Ethereal: return "Ethereal";
+        case Mood::Mysterious: return "Mysterious";
+        default: return "?";
+    }
+}
+
 } // namespace MIDIScaleDetector
@@ -1,10 +1,18 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <map>
 #include <array>
+#include <cstdint>
+#include <initializer_list>
+#include <memory>
 #include "../MIDIParser/MIDIParser.h"
+#include "../MIDIParser/StreamingParser.h"
+#include "PitchClassTimeline.h"
+#include "KeySegmenter.h"
 
 namespace MIDIScaleDetector {
 
@@ -129,18 +137,294 @@ enum class ScaleType {
     Unknown
 };
 
-// Scale definition
+// Pitch classes relative to a root: bit i is set when the note i semitones
+// above the root belongs to the set
+using PitchClassMask = uint16_t;
+
+constexpr PitchClassMask makePitchClassMask(std::initializer_list<int> intervals) {
+    PitchClassMask mask = 0;
+    for (int interval : intervals) {
+        mask |= static_cast<PitchClassMask>(1u << (interval % 12));
+    }
+    return mask;
+}
+
+constexpr int countPitchClasses(PitchClassMask mask) {
+    int count = 0;
+    for (; mask != 0; mask &= static_cast<PitchClassMask>(mask - 1)) {
+        ++count;
+    }
+    return count;
+}
+
+// Rotate a root-relative mask to absolute pitch classes (bit 0 = C)
+constexpr PitchClassMask transposePitchClassMask(PitchClassMask mask, int root) {
+    root = ((root % 12) + 12) % 12;
+    return static_cast<PitchClassMask>(((mask << root) | (mask >> (12 - root))) & 0x0FFF);
+}
+
+struct ScaleTemplate {
+    ScaleType type;
+    PitchClassMask mask;
+    std::string_view name;
+};
+
+inline constexpr size_t kScaleTypeCount = static_cast<size_t>(ScaleType::Unknown);
+
+// Every scale type except Unknown, indexed by ScaleType
+inline constexpr std::array<ScaleTemplate, kScaleTypeCount> kScaleTemplates = {{
+    // Major modes (Church modes)
+    {ScaleType::Ionian, makePitchClassMask({0, 2, 4, 5, 7, 9, 11}), "Major"},
+    {ScaleType::Dorian, makePitchClassMask({0, 2, 3, 5, 7, 9, 10}), "Dorian"},
+    {ScaleType::Phrygian, makePitchClassMask({0, 1, 3, 5, 7, 8, 10}), "Phrygian"},
+    {ScaleType::Lydian, makePitchClassMask({0, 2, 4, 6, 7, 9, 11}), "Lydian"},
+    {ScaleType::Mixolydian, makePitchClassMask({0, 2, 4, 5, 7, 9, 10}), "Mixolydian"},
+    {ScaleType::Aeolian, makePitchClassMask({0, 2, 3, 5, 7, 8, 10}), "Minor"},  // Natural Minor
+    {ScaleType::Locrian, makePitchClassMask({0, 1, 3, 5, 6, 8, 10}), "Locrian"},
+
+    // Minor variants
+    {ScaleType::HarmonicMinor, makePitchClassMask({0, 2, 3, 5, 7, 8, 11}), "Harmonic Minor"},
+    {ScaleType::MelodicMinor, makePitchClassMask({0, 2, 3, 5, 7, 9, 11}), "Melodic Minor"},
+    {ScaleType::NaturalMinor, makePitchClassMask({0, 2, 3, 5, 7, 8, 10}), "Natural Minor"},
+
+    // Melodic Minor modes
+    {ScaleType::DorianFlat2, makePitchClassMask({0, 1, 3, 5, 7, 9, 10}), "Dorian b2"},  // Phrygian #6 / Javanese
+    {ScaleType::LydianAugmented, makePitchClassMask({0, 2, 4, 6, 8, 9, 11}), "Lydian Augmented"},  // Lydian #5
+    {ScaleType::LydianDominant, makePitchClassMask({0, 2, 4, 6, 7, 9, 10}), "Lydian Dominant"},  // Lydian b7 / Overtone
+    {ScaleType::MixolydianFlat6, makePitchClassMask({0, 2, 4, 5, 7, 8, 10}), "Mixolydian b6"},  // Aeolian Dominant / Hindu
+    {ScaleType::LocrianNatural2, makePitchClassMask({0, 2, 3, 5, 6, 8, 10}), "Locrian #2"},  // Half-Diminished
+    {ScaleType::SuperLocrian, makePitchClassMask({0, 1, 3, 4, 6, 8, 10}), "Super Locrian"},  // Altered / Diminished Whole Tone
+
+    // Harmonic Minor modes
+    {ScaleType::LocrianNatural6, makePitchClassMask({0, 1, 3, 5, 6, 9, 10}), "Locrian #6"},
+    {ScaleType::IonianAugmented, makePitchClassMask({0, 2, 4, 5, 8, 9, 11}), "Ionian Augmented"},  // Ionian #5
+    {ScaleType::DorianSharp4, makePitchClassMask({0, 2, 3, 6, 7, 9, 10}), "Dorian #4"},  // Romanian Minor / Ukrainian Dorian
+    {ScaleType::PhrygianDominant, makePitchClassMask({0, 1, 4, 5, 7, 8, 10}), "Phrygian Dominant"},  // Spanish Phrygian / Freygish
+    {ScaleType::LydianSharp2, makePitchClassMask({0, 3, 4, 6, 7, 9, 11}), "Lydian #2"},
+    {ScaleType::SuperLocrianDiminished, makePitchClassMask({0, 1, 3, 4, 6, 8, 9}), "Super Locrian Diminished"},  // Ultra Locrian
+
+    // Harmonic Major modes
+    {ScaleType::HarmonicMajor, makePitchClassMask({0, 2, 4, 5, 7, 8, 11}), "Harmonic Major"},
+    {ScaleType::DorianFlat5, makePitchClassMask({0, 2, 3, 5, 6, 9, 10}), "Dorian b5"},
+    {ScaleType::PhrygianFlat4, makePitchClassMask({0, 1, 3, 4, 7, 8, 10}), "Phrygian b4"},
+    {ScaleType::LydianFlat3, makePitchClassMask({0, 2, 3, 6, 7, 9, 11}), "Lydian b3"},
+    {ScaleType::MixolydianFlat2, makePitchClassMask({0, 1, 4, 5, 7, 9, 10}), "Mixolydian b2"},
+    {ScaleType::LydianAugmentedSharp2, makePitchClassMask({0, 3, 4, 6, 8, 9, 11}), "Lydian Augmented #2"},
+    {ScaleType::LocrianDiminished7, makePitchClassMask({0, 1, 3, 5, 6, 8, 9}), "Locrian Diminished 7"},
+
+    // Double Harmonic / Byzantine modes
+    {ScaleType::DoubleHarmonic, makePitchClassMask({0, 1, 4, 5, 7, 8, 11}), "Double Harmonic"},  // Byzantine / Arabic / Gypsy Major
+    {ScaleType::LydianSharp2Sharp6, makePitchClassMask({0, 3, 4, 6, 7, 10, 11}), "Lydian #2 #6"},
+    {ScaleType::UltraPhrygian, makePitchClassMask({0, 1, 3, 4, 7, 8, 9}), "Ultra Phrygian"},
+    {ScaleType::HungarianMinor, makePitchClassMask({0, 2, 3, 6, 7, 8, 11}), "Hungarian Minor"},  // Gypsy Minor
+    {ScaleType::Oriental, makePitchClassMask({0, 1, 4, 5, 6, 9, 10}), "Oriental"},
+    {ScaleType::IonianAugmentedSharp2, makePitchClassMask({0, 3, 4, 5, 8, 9, 11}), "Ionian Augmented #2"},
+    {ScaleType::LocrianDiminished3Diminished7, makePitchClassMask({0, 1, 2, 5, 6, 8, 9}), "Locrian bb3 bb7"},
+
+    // Pentatonic scales
+    {ScaleType::MajorPentatonic, makePitchClassMask({0, 2, 4, 7, 9}), "Major Pentatonic"},
+    {ScaleType::MinorPentatonic, makePitchClassMask({0, 3, 5, 7, 10}), "Minor Pentatonic"},
+    {ScaleType::EgyptianPentatonic, makePitchClassMask({0, 2, 5, 7, 10}), "Egyptian"},  // Suspended Pentatonic
+    {ScaleType::BluesMinorPentatonic, makePitchClassMask({0, 3, 5, 8, 10}), "Blues Minor Pentatonic"},  // Man Gong
+    {ScaleType::BluesMajorPentatonic, makePitchClassMask({0, 2, 5, 7, 9}), "Blues Major Pentatonic"},  // Ritusen / Scottish
+    {ScaleType::JapanesePentatonic, makePitchClassMask({0, 1, 5, 7, 8}), "Japanese"},  // In scale
+    {ScaleType::ChinesePentatonic, makePitchClassMask({0, 2, 4, 7, 9}), "Chinese"},  // Same as major pentatonic
+
+    // Blues scales
+    {ScaleType::Blues, makePitchClassMask({0, 3, 5, 6, 7, 10}), "Blues"},  // Minor Blues
+    {ScaleType::MajorBlues, makePitchClassMask({0, 2, 3, 4, 7, 9}), "Major Blues"},
+
+    // Bebop scales
+    {ScaleType::BebopDominant, makePitchClassMask({0, 2, 4, 5, 7, 9, 10, 11}), "Bebop Dominant"},
+    {ScaleType::BebopMajor, makePitchClassMask({0, 2, 4, 5, 7, 8, 9, 11}), "Bebop Major"},
+    {ScaleType::BebopMinor, makePitchClassMask({0, 2, 3, 5, 7, 8, 9, 10}), "Bebop Minor"},
+    {ScaleType::BebopDorian, makePitchClassMask({0, 2, 3, 4, 5, 7, 9, 10}), "Bebop Dorian"},
+
+    // Symmetric scales
+    {ScaleType::Chromatic, makePitchClassMask({0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11}), "Chromatic"},
+    {ScaleType::WholeTone, makePitchClassMask({0, 2, 4, 6, 8, 10}), "Whole Tone"},
+    {ScaleType::Diminished, makePitchClassMask({0, 2, 3, 5, 6, 8, 9, 11}), "Diminished"},  // Whole-Half Diminished
+    {ScaleType::DiminishedHalfWhole, makePitchClassMask({0, 1, 3, 4, 6, 7, 9, 10}), "Diminished Half-Whole"},  // Half-Whole Diminished
+    {ScaleType::Augmented, makePitchClassMask({0, 3, 4, 7, 8, 11}), "Augmented"},  // Hexatonic
+
+    // Ethnic / World scales
+    {ScaleType::HungarianMajor, makePitchClassMask({0, 3, 4, 6, 7, 9, 10}), "Hungarian Major"},
+    {ScaleType::NeapolitanMajor, makePitchClassMask({0, 1, 3, 5, 7, 9, 11}), "Neapolitan Major"},
+    {ScaleType::NeapolitanMinor, makePitchClassMask({0, 1, 3, 5, 7, 8, 11}), "Neapolitan Minor"},
+    {ScaleType::Persian, makePitchClassMask({0, 1, 4, 5, 6, 8, 11}), "Persian"},
+    {ScaleType::Hirajoshi, makePitchClassMask({0, 2, 3, 7, 8}), "Hirajoshi"},  // Japanese
+    {ScaleType::Iwato, makePitchClassMask({0, 1, 5, 6, 10}), "Iwato"},  // Japanese
+    {ScaleType::Kumoi, makePitchClassMask({0, 2, 3, 7, 9}), "Kumoi"},  // Japanese
+    {ScaleType::InSen, makePitchClassMask({0, 1, 5, 7, 10}), "In Sen"},  // Japanese
+    {ScaleType::Mongolian, makePitchClassMask({0, 2, 4, 7, 9}), "Mongolian"},
+    {ScaleType::Balinese, makePitchClassMask({0, 1, 3, 7, 8}), "Balinese"},
+    {ScaleType::Pelog, makePitchClassMask({0, 1, 3, 7, 10}), "Pelog"},
+    {ScaleType::Algerian, makePitchClassMask({0, 2, 3, 6, 7, 8, 11}), "Algerian"},
+    {ScaleType::Spanish8Tone, makePitchClassMask({0, 1, 3, 4, 5, 6, 8, 10}), "Spanish 8-Tone"},
+    {ScaleType::Flamenco, makePitchClassMask({0, 1, 4, 5, 7, 8, 11}), "Flamenco"},
+    {ScaleType::Jewish, makePitchClassMask({0, 1, 4, 5, 7, 8, 10}), "Jewish"},  // Ahava Rabbah
+    {ScaleType::Gypsy, makePitchClassMask({0, 2, 3, 6, 7, 8, 10}), "Gypsy"},
+    {ScaleType::Romanian, makePitchClassMask({0, 2, 3, 6, 7, 9, 10}), "Romanian"},
+    {ScaleType::Hawaiian, makePitchClassMask({0, 2, 3, 5, 7, 9, 11}), "Hawaiian"},
+    {ScaleType::Ethiopian, makePitchClassMask({0, 2, 4, 5, 7, 8, 11}), "Ethiopian"},
+    {ScaleType::Arabic, makePitchClassMask({0, 2, 4, 5, 6, 8, 10}), "Arabic"},
+
+    // Jazz scales
+    {ScaleType::Enigmatic, makePitchClassMask({0, 1, 4, 6, 8, 10, 11}), "Enigmatic"},
+    {ScaleType::LeadingWholeTone, makePitchClassMask({0, 2, 4, 6, 8, 10, 11}), "Leading Whole Tone"},
+    {ScaleType::SixToneSymmetric, makePitchClassMask({0, 1, 4, 5, 8, 9}), "Six-Tone Symmetric"},
+    {ScaleType::Prometheus, makePitchClassMask({0, 2, 4, 6, 9, 10}), "Prometheus"},
+    {ScaleType::PrometheusNeapolitan, makePitchClassMask({0, 1, 4, 6, 9, 10}), "Prometheus Neapolitan"},
+    {ScaleType::Tritone, makePitchClassMask({0, 1, 4, 6, 7, 10}), "Tritone"},
+    {ScaleType::TwoSemitoneTritone, makePitchClassMask({0, 1, 2, 6, 7, 8}), "Two-Semitone Tritone"},
+
+    // Modal variations
+    {ScaleType::MajorLocrian, makePitchClassMask({0, 2, 4, 5, 6, 8, 10}), "Major Locrian"},
+    {ScaleType::ArabicMaqam, makePitchClassMask({0, 1, 4, 5, 7, 8, 11}), "Arabic Maqam"},
+    {ScaleType::Istrian, makePitchClassMask({0, 1, 3, 4, 6, 7}), "Istrian"},
+    {ScaleType::UkrainianDorian, makePitchClassMask({0, 2, 3, 6, 7, 9, 10}), "Ukrainian Dorian"},
+}};
+
+constexpr bool scaleTemplatesInEnumOrder() {
+    for (size_t i = 0; i < kScaleTemplates.size(); ++i) {
+        if (static_cast<size_t>(kScaleTemplates[i].type) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(scaleTemplatesInEnumOrder(), "kScaleTemplates must follow the ScaleType order");
+
+constexpr PitchClassMask scaleMask(ScaleType type) {
+    size_t index = static_cast<size_t>(type);
+    return index < kScaleTypeCount ? kScaleTemplates[index].mask : 0;
+}
+
+constexpr std::string_view scaleTypeName(ScaleType type) {
+    size_t index = static_cast<size_t>(type);
+    return index < kScaleTypeCount ? kScaleTemplates[index].name : std::string_view("Unknown");
+}
+
+// Scale definition. Plain value type: copying one never allocates.
 struct Scale {
     NoteName root;
     ScaleType type;
-    std::vector<int> intervals;
+    PitchClassMask mask;    // Intervals from the root, usually scaleMask(type)
     double confidence;
 
-    Scale() : root(NoteName::C), type(ScaleType::Unknown), confidence(0.0) {}
+    Scale() : root(NoteName::C), type(ScaleType::Unknown), mask(0), confidence(0.0) {}
+    Scale(NoteName scaleRoot, ScaleType scaleType, double scaleConfidence)
+        : root(scaleRoot), type(scaleType), mask(scaleMask(scaleType)), confidence(scaleConfidence) {}
 
     std::string getName() const;
     std::string getRootName() const;
-    bool containsNote(int midiNote) const;
+
+    bool containsNote(int midiNote) const {
+        int interval = ((midiNote - static_cast<int>(root)) % 12 + 12) % 12;
+        return (mask >> interval) & 1;
+    }
+
+    int noteCount() const { return countPitchClasses(mask); }
+
+    // Member pitch classes as absolute bits (bit 0 = C)
+    PitchClassMask getPitchClasses() const { return transposePitchClassMask(mask, static_cast<int>(root)); }
+};
+
+// Chord qualities the chord timeline can label
+enum class ChordQuality {
+    Major,
+    Minor,
+    Diminished,
+    Augmented,
+    Sus2,
+    Sus4,
+    Power,
+    Major6,
+    Minor6,
+    Dominant7,
+    Major7,
+    Minor7,
+    MinorMajor7,
+    HalfDiminished7,
+    Diminished7
+};
+
+struct ChordTemplate {
+    ChordQuality quality;
+    PitchClassMask mask;        // Chord tones above the root
+    std::string_view suffix;    // Appended to the root name: "m7" in "Am7"
+};
+
+// Indexed by ChordQuality. Simpler chords first, which wins ties.
+inline constexpr std::array<ChordTemplate, 15> kChordTemplates = {{
+    {ChordQuality::Major, makePitchClassMask({0, 4, 7}), ""},
+    {ChordQuality::Minor, makePitchClassMask({0, 3, 7}), "m"},
+    {ChordQuality::Diminished, makePitchClassMask({0, 3, 6}), "dim"},
+    {ChordQuality::Augmented, makePitchClassMask({0, 4, 8}), "aug"},
+    {ChordQuality::Sus2, makePitchClassMask({0, 2, 7}), "sus2"},
+    {ChordQuality::Sus4, makePitchClassMask({0, 5, 7}), "sus4"},
+    {ChordQuality::Power, makePitchClassMask({0, 7}), "5"},
+    {ChordQuality::Major6, makePitchClassMask({0, 4, 7, 9}), "6"},
+    {ChordQuality::Minor6, makePitchClassMask({0, 3, 7, 9}), "m6"},
+    {ChordQuality::Dominant7, makePitchClassMask({0, 4, 7, 10}), "7"},
+    {ChordQuality::Major7, makePitchClassMask({0, 4, 7, 11}), "maj7"},
+    {ChordQuality::Minor7, makePitchClassMask({0, 3, 7, 10}), "m7"},
+    {ChordQuality::MinorMajor7, makePitchClassMask({0, 3, 7, 11}), "m(maj7)"},
+    {ChordQuality::HalfDiminished7, makePitchClassMask({0, 3, 6, 10}), "m7b5"},
+    {ChordQuality::Diminished7, makePitchClassMask({0, 3, 6, 9}), "dim7"},
+}};
+
+constexpr bool chordTemplatesInEnumOrder() {
+    for (size_t i = 0; i < kChordTemplates.size(); ++i) {
+        if (static_cast<size_t>(kChordTemplates[i].quality) != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(chordTemplatesInEnumOrder(), "kChordTemplates must follow the ChordQuality order");
+
+// One labelled span of the chord timeline
+struct Chord {
+    NoteName root;
+    ChordQuality quality;
+    NoteName bass;          // Lowest sounding pitch class
+    double startTime;       // Seconds
+    double endTime;
+
+    Chord() : root(NoteName::C), quality(ChordQuality::Major), bass(NoteName::C),
+              startTime(0.0), endTime(0.0) {}
+
+    // 0 in root position, n with the nth chord tone above the root in the
+    // bass, -1 when the bass isn't a chord tone
+    int getInversion() const;
+
+    // Root, quality suffix and slash bass when inverted: "C", "Am7/G"
+    std::string getName() const;
+
+    bool sameLabel(const Chord& other) const {
+        return root == other.root && quality == other.quality && bass == other.bass;
+    }
+};
+
+// How the chord timeline is cut into spans
+enum class ChordWindow {
+    Changes,    // A new span whenever the set of sounding notes changes
+    Beats,      // Fixed windows of a number of quarter-note beats
+    Seconds     // Fixed windows of a number of seconds
+};
+
+// How key changes are found
+enum class KeyChangeMethod {
+    Windowed,   // Best key of each sliding window, with hysteresis
+    Viterbi     // Most likely key path over per-beat chroma (KeySegmenter)
+};
+
+// How much of the analysis to compute. Each level includes the ones above.
+enum class AnalysisLevel {
+    KeyOnly,                // Primary scale, note weights and note counts
+    KeyAndAlternatives,     // Plus the alternative scales
+    Full                    // Plus the chord timeline and key changes
 };
 
 // Harmonic analysis result
@@ -148,15 +432,75 @@ struct HarmonicAnalysis {
     Scale primaryScale;
     std::vector<Scale> alternativeScales;
     std::array<double, 12> noteWeights;
-    std::vector<std::string> chordProgression;
+    std::vector<std::string> chordProgression;     // Chord names, repeats collapsed
+    std::vector<Chord> chords;                      // Timed chord timeline
     std::vector<std::pair<double, Scale>> keyChanges;
     int totalNotes;
     double averagePitch;
-    std::map<int, int> noteDistribution;
+    std::array<uint32_t, 128> noteDistribution;     // Note count per MIDI pitch
+    bool usedDeclaredKey;   // Primary scale confirmed from the file's key signature
+    AnalysisLevel level;    // Which of the fields above were computed
 
-    HarmonicAnalysis() : totalNotes(0), averagePitch(0.0) {
+    HarmonicAnalysis() : totalNotes(0), averagePitch(0.0), usedDeclaredKey(false),
+                         level(AnalysisLevel::KeyOnly) {
         noteWeights.fill(0.0);
+        noteDistribution.fill(0);
     }
+
+    // Back to the empty result, keeping vector capacity for the next file
+    void clear();
+};
+
+// Character of a file, from its scale and tempo
+enum class Mood {
+    Joyful, Happy, Peaceful,            // Major third; fast, moderate, slow
+    Intense, Emotional, Melancholic,    // Minor third; fast, moderate, slow
+    Funky, Soulful,                     // Dorian; fast, otherwise
+    Bluesy, Sorrowful,                  // Blues; otherwise, slow
+    Dreamy,                             // Lydian
+    Exotic,                             // Phrygian
+    Ethereal,                           // Other five-note scales
+    Mysterious                          // Everything else
+};
+
+// Everything a file browser row shows, from one call
+struct FileSummary {
+    HarmonicAnalysis analysis;  // At the detector's analysis level
+    NoteName parentMajor;       // Major key with the scale's notes (the root for non-diatonic scales)
+    NoteName relativeMinor;     // Relative minor of parentMajor
+    double tempo;               // BPM of the first tempo event
+    double duration;            // Seconds
+    int program;                // First program change, -1 if none
+    bool containsChords;        // Two or more pitches start together somewhere
+    bool containsSingleNotes;   // Some note starts on its own
+    Mood mood;
+
+    FileSummary() : parentMajor(NoteName::C), relativeMinor(NoteName::A), tempo(120.0), duration(0.0),
+                    program(-1), containsChords(false), containsSingleNotes(false),
+                    mood(Mood::Mysterious) {}
+};
+
+class ScaleScorer;
+struct ScaleScores;
+class ChordDetector;
+
+// Scratch buffers for ScaleDetector. Once they have grown to fit the
+// largest file seen, analysis into a reused context and result makes no
+// heap allocations. A context serves one thread at a time; give each
+// worker its own and they can share one ScaleDetector.
+class AnalysisContext {
+public:
+    AnalysisContext();
+    ~AnalysisContext();
+
+private:
+    friend class ScaleDetector;
+
+    NoteTable notes;                    // Built for files parsed without one
+    PitchClassTimeline keyTimeline;     // Window histograms for key tracking
+    KeySegmenter keySegmenter;
+    std::vector<KeySegment> keySegments;
+    std::unique_ptr<ChordDetector> chordDetector;
 };
 
 // Scale Detection Engine
@@ -168,43 +512,122 @@ public:
     HarmonicAnalysis analyze(const MIDIFile& midiFile);
     HarmonicAnalysis analyzeRange(const MIDIFile& midiFile, double startTime, double endTime);
 
+    // Same analysis into a caller-owned result, using the context's buffers
+    void analyze(const MIDIFile& midiFile, AnalysisContext& context, HarmonicAnalysis& result) const;
+    void analyzeRange(const MIDIFile& midiFile, double startTime, double endTime,
+                      AnalysisContext& context, HarmonicAnalysis& result) const;
+
+    // Whole-file analysis of files[i] into results[i] for count files,
+    // recycling each result's storage
+    void analyzeBatch(const MIDIFile* files, size_t count, HarmonicAnalysis* results,
+                      AnalysisContext& context) const;
+
+    // Analysis plus the listing details, over [0, duration). Pass
+    // midiFile.getDuration() for a parsed file, or the cached duration for
+    // one rebuilt with NoteCacheEntry::restore().
+    void summarize(const MIDIFile& midiFile, double duration, AnalysisContext& context,
+                   FileSummary& summary) const;
+
+    // Same, reusing an analysis made earlier for this file (e.g. one kept in
+    // the note cache) when it is at least as deep as the detector's level
+    void summarize(const MIDIFile& midiFile, double duration, const HarmonicAnalysis& analysis,
+                   AnalysisContext& context, FileSummary& summary) const;
+
+    // Depth of every analyze call (default Full). The primary key costs one
+    // histogram and one scoring pass; chords and key changes cost more.
+    void setAnalysisLevel(AnalysisLevel level) { analysisLevel = level; }
+    AnalysisLevel getAnalysisLevel() const { return analysisLevel; }
+
+    // Fill in the tiers a whole-file result from analyze() lacks, up to
+    // level, keeping its primary scale
+    void upgrade(const MIDIFile& midiFile, AnalysisLevel level, AnalysisContext& context,
+                 HarmonicAnalysis& result) const;
+
+    // Whole-file analysis in constant memory: notes are folded into running
+    // histograms as the file streams past. Chords and key changes need the
+    // full note list and are left empty. Errors are in parser.getLastError().
+    bool analyzeStream(const std::string& filePath, StreamingParser& parser, HarmonicAnalysis& result);
+
     void setMinConfidenceThreshold(double threshold) { minConfidence = threshold; }
     void setWeightByDuration(bool enabled) { weightByDuration = enabled; }
     void setWeightByVelocity(bool enabled) { weightByVelocity = enabled; }
     void setDetectKeyChanges(bool enabled) { detectKeyChangesEnabled = enabled; }
 
+    // Key tracking slides a window of windowSeconds by hopSeconds. Ranges
+    // shorter than two windows are not tracked. A new key is reported only
+    // after it wins this many consecutive windows, which keeps a passing
+    // chromatic phrase from registering as a modulation.
+    void setKeyChangeWindow(double windowSeconds, double hopSeconds);
+    void setKeyChangeHysteresis(int windows) { keyChangeHysteresis = std::max(1, windows); }
+
+    // Windowed (default) or Viterbi. Viterbi ignores the window settings
+    // and tracks ranges of any length; switchProbability is its chance per
+    // beat of leaving the current key.
+    void setKeyChangeMethod(KeyChangeMethod method) { keyChangeMethod = method; }
+    void setKeySwitchProbability(double probability) { keySwitchProbability = probability; }
+
+    // Chord timeline segmentation (default: two-beat windows)
+    void setChordWindow(ChordWindow mode, double length);
+
+    // Trust a key signature in the file when the note histogram agrees with
+    // it, skipping the full scale template sweep
+    void setUseDeclaredKey(bool enabled) { useDeclaredKey = enabled; }
+
 private:
     double minConfidence;
     bool weightByDuration;
     bool weightByVelocity;
     bool detectKeyChangesEnabled;
+    bool useDeclaredKey;
+    double keyChangeWindow;
+    double keyChangeHop;
+    int keyChangeHysteresis;
+    KeyChangeMethod keyChangeMethod;
+    double keySwitchProbability;
+    ChordWindow chordWindow;
+    double chordWindowLength;
+    AnalysisLevel analysisLevel;
 
-    std::map<ScaleType, std::vector<int>> scaleTemplates;
     std::array<double, 12> majorProfile;
     std::array<double, 12> minorProfile;
+    std::unique_ptr<ScaleScorer> scorer;    // Key and template scores in one pass
+    AnalysisContext defaultContext;         // For the calls that return a new result
 
-    void initializeScaleTemplates();
     void initializeKeyProfiles();
-    std::array<double, 12> buildNoteHistogram(const std::vector<MIDIEvent>& events);
-    std::array<double, 12> calculateWeightedHistogram(const std::vector<MIDIEvent>& events,
-                                                       const MIDIFile& midiFile);
-    double correlate(const std::array<double, 12>& histogram,
-                    const std::array<double, 12>& profile) const;
-    Scale findBestScale(const std::array<double, 12>& histogram);
-    std::vector<Scale> findAlternativeScales(const std::array<double, 12>& histogram,
-                                             const Scale& primaryScale);
-    std::vector<std::pair<double, Scale>> detectKeyChanges(const MIDIFile& midiFile);
-    std::vector<std::string> detectChordProgressions(const MIDIFile& midiFile,
-                                                     const Scale& scale);
-    std::string analyzeChord(const std::vector<MIDIEvent>& events,
-                            double windowStart, double windowEnd);
-    std::map<int, int> calculateNoteDistribution(const std::vector<MIDIEvent>& events);
+    void analyzeNotes(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                      double endTime, AnalysisContext& context, HarmonicAnalysis& result) const;
+    std::array<double, 12> calculateWeightedHistogram(const NoteTable& notes, size_t first,
+                                                       size_t last, double endTime) const;
+    Scale findBestScale(const ScaleScores& scores) const;
+    bool matchDeclaredKey(const MIDIFile& midiFile, double time,
+                          const ScaleScores& scores, Scale& scale) const;
+    void findAlternativeScales(const ScaleScores& scores, const Scale& primaryScale,
+                               std::vector<Scale>& alternatives) const;
+    void scoreAndDetect(const std::array<double, 12>& histogram, const MIDIFile* midiFile,
+                        double startTime, HarmonicAnalysis& result) const;
+    void addTimelines(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                      double endTime, AnalysisContext& context, HarmonicAnalysis& result) const;
+    void detectKeyChanges(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                          double endTime, AnalysisContext& context,
+                          std::vector<std::pair<double, Scale>>& keyChanges) const;
+    void segmentKeys(const MIDIFile& midiFile, double startTime, double endTime,
+                     AnalysisContext& context, std::vector<std::pair<double, Scale>>& keyChanges) const;
+    void describe(const MIDIFile& midiFile, const NoteTable& notes, double duration,
+                  FileSummary& summary) const;
+    void detectChords(const MIDIFile& midiFile, const NoteTable& notes, double startTime,
+                      double endTime, AnalysisContext& context, HarmonicAnalysis& result) const;
     void normalizeHistogram(std::array<double, 12>& histogram) const;
     int noteToPitchClass(int midiNote) const { return midiNote % 12; }
 };
 
+// Same names as scaleTypeName(), as an owned string
 std::string scaleTypeToString(ScaleType type);
 std::string noteNameToString(NoteName note);
 NoteName intToNoteName(int pitchClass);
 
+// Root of the major scale a mode, minor or pentatonic scale is drawn from
+NoteName parentMajorKey(const Scale& scale);
+Mood classifyMood(const Scale& scale, double tempo);
+const char* moodName(Mood mood);
+
 } // namespace MIDIScaleDetector
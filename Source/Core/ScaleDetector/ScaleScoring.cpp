@@ -0,0 +1,253 @@
+#include "ScaleScoring.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define MIDIXPLORER_SCORING_X86 1
+#if defined(__GNUC__) || defined(__clang__)
+#define MIDIXPLORER_SCORING_AVX2 1
+#endif
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define MIDIXPLORER_SCORING_NEON 1
+#endif
+
+namespace MIDIScaleDetector {
+
+namespace {
+    constexpr size_t kRows = ScaleScores::kRows;
+    static_assert(kRows % 4 == 0, "Kernels process rows in blocks of four");
+
+    using KernelFunction = void (*)(const double* weights, const double* histogram, double* out);
+
+    // out[row] = sum over j of weights[j * kRows + row] * histogram[j]
+    void scoreScalar(const double* weights, const double* histogram, double* out) {
+        for (size_t row = 0; row < kRows; ++row) {
+            double sum = 0.0;
+            for (size_t j = 0; j < 12; ++j) {
+                sum += weights[j * kRows + row] * histogram[j];
+            }
+            out[row] = sum;
+        }
+    }
+
+#ifdef MIDIXPLORER_SCORING_X86
+    // Baseline on every x86-64 CPU
+    void scoreSSE2(const double* weights, const double* histogram, double* out) {
+        __m128d h[12];
+        for (size_t j = 0; j < 12; ++j) {
+            h[j] = _mm_set1_pd(histogram[j]);
+        }
+        for (size_t row = 0; row < kRows; row += 2) {
+            __m128d sum = _mm_setzero_pd();
+            for (size_t j = 0; j < 12; ++j) {
+                sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(weights + j * kRows + row), h[j]));
+            }
+            _mm_storeu_pd(out + row, sum);
+        }
+    }
+#endif
+
+#ifdef MIDIXPLORER_SCORING_AVX2
+    __attribute__((target("avx2,fma")))
+    void scoreAVX2(const double* weights, const double* histogram, double* out) {
+        __m256d h[12];
+        for (size_t j = 0; j < 12; ++j) {
+            h[j] = _mm256_set1_pd(histogram[j]);
+        }
+        for (size_t row = 0; row < kRows; row += 4) {
+            __m256d sum = _mm256_setzero_pd();
+            for (size_t j = 0; j < 12; ++j) {
+                sum = _mm256_fmadd_pd(_mm256_loadu_pd(weights + j * kRows + row), h[j], sum);
+            }
+            _mm256_storeu_pd(out + row, sum);
+        }
+    }
+#endif
+
+#ifdef MIDIXPLORER_SCORING_NEON
+    void scoreNEON(const double* weights, const double* histogram, double* out) {
+        float64x2_t h[12];
+        for (size_t j = 0; j < 12; ++j) {
+            h[j] = vdupq_n_f64(histogram[j]);
+        }
+        for (size_t row = 0; row < kRows; row += 2) {
+            float64x2_t sum = vdupq_n_f64(0.0);
+            for (size_t j = 0; j < 12; ++j) {
+                sum = vfmaq_f64(sum, vld1q_f64(weights + j * kRows + row), h[j]);
+            }
+            vst1q_f64(out + row, sum);
+        }
+    }
+#endif
+
+    KernelFunction kernelFunction(ScoringKernel kernel) {
+        switch (kernel) {
+#ifdef MIDIXPLORER_SCORING_X86
+            case ScoringKernel::SSE2: return scoreSSE2;
+#endif
+#ifdef MIDIXPLORER_SCORING_AVX2
+            case ScoringKernel::AVX2: return scoreAVX2;
+#endif
+#ifdef MIDIXPLORER_SCORING_NEON
+            case ScoringKernel::NEON: return scoreNEON;
+#endif
+            default: return scoreScalar;
+        }
+    }
+}
+
+const char* scoringKernelName(ScoringKernel kernel) {
+    switch (kernel) {
+        case ScoringKernel::Scalar: return "scalar";
+        case ScoringKernel::SSE2: return "SSE2";
+        case ScoringKernel::AVX2: return "AVX2";
+        case ScoringKernel::NEON: return "NEON";
+        default: return "?";
+    }
+}
+
+ScaleScorer::ScaleScorer() : weights(12 * kRows, 0.0), kernel(bestKernel()) {
+    // Template rows: 1/n on each of the template's n notes, rotated to the root
+    for (const auto& scaleTemplate : kScaleTemplates) {
+        double weight = 1.0 / countPitchClasses(scaleTemplate.mask);
+        for (int root = 0; root < 12; ++root) {
+            size_t row = ScaleScores::kKeyRows + static_cast<size_t>(scaleTemplate.type) * 12 +
+                         static_cast<size_t>(root);
+            for (int j = 0; j < 12; ++j) {
+                if ((scaleTemplate.mask >> ((j - root + 12) % 12)) & 1) {
+                    weights[static_cast<size_t>(j) * kRows + row] = weight;
+                }
+            }
+        }
+    }
+}
+
+void ScaleScorer::setProfiles(const std::array<double, 12>& majorProfile,
+                              const std::array<double, 12>& minorProfile) {
+    // Pearson correlation against a centred profile c reduces to
+    // sum(h[j] * c[j - root]) / (|c| * |h - mean(h)|), since c sums to zero.
+    // The division by |c| is folded into the weights here.
+    auto setKeyRows = [this](const std::array<double, 12>& profile, size_t firstRow) {
+        double mean = std::accumulate(profile.begin(), profile.end(), 0.0) / 12.0;
+        std::array<double, 12> centred;
+        double norm = 0.0;
+        for (size_t i = 0; i < 12; ++i) {
+            centred[i] = profile[i] - mean;
+            norm += centred[i] * centred[i];
+        }
+        norm = std::sqrt(norm);
+
+        for (int root = 0; root < 12; ++root) {
+            for (int j = 0; j < 12; ++j) {
+                double value = norm > 0.0 ? centred[static_cast<size_t>((j - root + 12) % 12)] / norm : 0.0;
+                weights[static_cast<size_t>(j) * kRows + firstRow + static_cast<size_t>(root)] = value;
+            }
+        }
+    };
+    setKeyRows(majorProfile, 0);
+    setKeyRows(minorProfile, 12);
+}
+
+void ScaleScorer::score(const std::array<double, 12>& histogram, ScaleScores& scores) const {
+    kernelFunction(kernel)(weights.data(), histogram.data(), scores.values.data());
+
+    // Finish the correlations with the histogram's spread; a flat
+    // histogram correlates with nothing
+    double mean = std::accumulate(histogram.begin(), histogram.end(), 0.0) / 12.0;
+    double spread = 0.0;
+    for (double value : histogram) {
+        spread += (value - mean) * (value - mean);
+    }
+    double scale = spread > 0.0 ? 1.0 / std::sqrt(spread) : 0.0;
+    for (size_t row = 0; row < ScaleScores::kKeyRows; ++row) {
+        scores.values[row] *= scale;
+    }
+}
+
+void ScaleScorer::scoreKeys(const std::array<double, 12>& histogram,
+                            std::array<double, ScaleScores::kKeyRows>& keyScores) const {
+    keyScores.fill(0.0);
+    for (size_t j = 0; j < 12; ++j) {
+        const double* column = weights.data() + j * ScaleScores::kRows;
+        for (size_t row = 0; row < ScaleScores::kKeyRows; ++row) {
+            keyScores[row] += column[row] * histogram[j];
+        }
+    }
+
+    double mean = std::accumulate(histogram.begin(), histogram.end(), 0.0) / 12.0;
+    double spread = 0.0;
+    for (double value : histogram) {
+        spread += (value - mean) * (value - mean);
+    }
+    double scale = spread > 0.0 ? 1.0 / std::sqrt(spread) : 0.0;
+    for (double& value : keyScores) {
+        value *= scale;
+    }
+}
+
+void ScaleScorer::topKeys(const ScaleScores& scores, size_t k, std::vector<Scale>& keys) const {
+    // Ties keep root order, major before minor
+    std::array<int, ScaleScores::kKeyRows> order;
+    std::iota(order.begin(), order.end(), 0);
+    k = std::min(k, order.size());
+    std::partial_sort(order.begin(), order.begin() + static_cast<std::ptrdiff_t>(k), order.end(),
+                      [&scores](int a, int b) {
+                          double scoreA = scores.values[static_cast<size_t>(a)];
+                          double scoreB = scores.values[static_cast<size_t>(b)];
+                          if (scoreA != scoreB) {
+                              return scoreA > scoreB;
+                          }
+                          return (a % 12) * 2 + a / 12 < (b % 12) * 2 + b / 12;
+                      });
+
+    keys.clear();
+    for (size_t i = 0; i < k; ++i) {
+        int row = order[i];
+        double correlation = scores.values[static_cast<size_t>(row)];
+        keys.emplace_back(intToNoteName(row % 12), row < 12 ? ScaleType::Ionian : ScaleType::Aeolian,
+                          (correlation + 1.0) / 2.0);
+    }
+}
+
+bool ScaleScorer::setKernel(ScoringKernel requested) {
+    if (!isSupported(requested)) {
+        return false;
+    }
+    kernel = requested;
+    return true;
+}
+
+bool ScaleScorer::isSupported(ScoringKernel kernel) {
+    switch (kernel) {
+        case ScoringKernel::Scalar:
+            return true;
+#ifdef MIDIXPLORER_SCORING_X86
+        case ScoringKernel::SSE2:
+            return true;
+#endif
+#ifdef MIDIXPLORER_SCORING_AVX2
+        case ScoringKernel::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+#endif
+#ifdef MIDIXPLORER_SCORING_NEON
+        case ScoringKernel::NEON:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+ScoringKernel ScaleScorer::bestKernel() {
+    for (ScoringKernel kernel : {ScoringKernel::AVX2, ScoringKernel::NEON, ScoringKernel::SSE2}) {
+        if (isSupported(kernel)) {
+            return kernel;
+        }
+    }
+    return ScoringKernel::Scalar;
+}
+
+} // namespace MIDIScaleDetector
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+#include "ScaleDetector.h"
+
+namespace MIDIScaleDetector {
+
+// Instruction sets the scoring kernel can run on
+enum class ScoringKernel {
+    Scalar,
+    SSE2,
+    AVX2,       // With FMA
+    NEON
+};
+
+const char* scoringKernelName(ScoringKernel kernel);
+
+// Krumhansl-Schmuckler key profiles, C-rooted
+inline constexpr std::array<double, 12> kMajorKeyProfile = {
+    6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88
+};
+inline constexpr std::array<double, 12> kMinorKeyProfile = {
+    6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17
+};
+
+// Every score findBestScale needs for one histogram, from a single pass
+struct ScaleScores {
+    // Rows: 12 major keys, 12 minor keys, then every template at every root
+    static constexpr size_t kKeyRows = 24;
+    static constexpr size_t kRows = kKeyRows + kScaleTypeCount * 12;
+
+    std::array<double, kRows> values;
+
+    // Pearson correlation with the Krumhansl profile rotated to root
+    double majorCorrelation(int root) const { return values[static_cast<size_t>(root)]; }
+    double minorCorrelation(int root) const { return values[12 + static_cast<size_t>(root)]; }
+
+    // Mean histogram weight over the template's notes at root
+    double templateMatch(ScaleType type, int root) const {
+        return values[kKeyRows + static_cast<size_t>(type) * 12 + static_cast<size_t>(root)];
+    }
+};
+
+// Scores a pitch-class histogram against all 24 keys and all scale
+// templates at all 12 roots as one matrix-vector product. The matrix of
+// rotated, centred profiles and normalised template masks is built once;
+// the product runs on the widest SIMD kernel the CPU supports.
+class ScaleScorer {
+public:
+    ScaleScorer();
+
+    // Krumhansl-style key profiles, C-rooted
+    void setProfiles(const std::array<double, 12>& majorProfile,
+                     const std::array<double, 12>& minorProfile);
+
+    void score(const std::array<double, 12>& histogram, ScaleScores& scores) const;
+
+    // Only the 24 key correlations, same values as score()'s first rows.
+    // A 24 x 12 product, cheap enough to run per audio block.
+    void scoreKeys(const std::array<double, 12>& histogram,
+                   std::array<double, ScaleScores::kKeyRows>& keyScores) const;
+
+    // The k best of the 24 major/minor keys, by correlation, best first.
+    // Confidence is the correlation mapped to 0-1.
+    void topKeys(const ScaleScores& scores, size_t k, std::vector<Scale>& keys) const;
+
+    // Force a kernel (e.g. Scalar for comparison). False if the CPU lacks it.
+    bool setKernel(ScoringKernel kernel);
+    ScoringKernel getKernel() const { return kernel; }
+
+    static bool isSupported(ScoringKernel kernel);
+    static ScoringKernel bestKernel();
+
+private:
+    // Column-major: weights[j * kRows + row] multiplies histogram[j]
+    std::vector<double> weights;
+    ScoringKernel kernel;
+};
+
+} // namespace MIDIScaleDetector
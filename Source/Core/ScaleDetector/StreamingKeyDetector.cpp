@@ -0,0 +1,108 @@
+#include "StreamingKeyDetector.h"
+#include <algorithm>
+#include <cmath>
+
+namespace MIDIScaleDetector {
+
+StreamingKeyDetector::StreamingKeyDetector()
+    : totalWeight(0.0),
+      lastTime(0.0),
+      decayRate(std::log(2.0) / 4.0),
+      switchMargin(0.05),
+      minimumWeight(4.0),
+      weightByVelocity(true),
+      changed(false),
+      currentRow(-1),
+      published(0) {
+    scorer.setProfiles(kMajorKeyProfile, kMinorKeyProfile);
+    histogram.fill(0.0);
+    keyScores.fill(0.0);
+}
+
+void StreamingKeyDetector::setHalfLife(double seconds) {
+    if (seconds > 0.0) {
+        decayRate = std::log(2.0) / seconds;
+    }
+}
+
+void StreamingKeyDetector::reset() {
+    histogram.fill(0.0);
+    totalWeight = 0.0;
+    lastTime = 0.0;
+    changed = false;
+    currentRow = -1;
+    published.store(0, std::memory_order_relaxed);
+}
+
+void StreamingKeyDetector::noteOn(int pitch, int velocity, double time) {
+    if (pitch < 0 || pitch > 127 || velocity <= 0) {
+        return;
+    }
+
+    // Bring every bin to this note's time, then add it
+    if (time > lastTime) {
+        double decay = std::exp(-decayRate * (time - lastTime));
+        for (double& weight : histogram) {
+            weight *= decay;
+        }
+        totalWeight *= decay;
+        lastTime = time;
+    }
+    double weight = weightByVelocity ? std::min(velocity, 127) / 127.0 : 1.0;
+    histogram[static_cast<size_t>(pitch % 12)] += weight;
+    totalWeight += weight;
+    changed = true;
+}
+
+void StreamingKeyDetector::update() {
+    if (!changed) {
+        return;
+    }
+    changed = false;
+    if (totalWeight < minimumWeight) {
+        return;
+    }
+
+    // Best of the 24 keys; ties keep root order, major before minor
+    scorer.scoreKeys(histogram, keyScores);
+    int best = 0;
+    for (int row = 1; row < static_cast<int>(ScaleScores::kKeyRows); ++row) {
+        double score = keyScores[static_cast<size_t>(row)];
+        double bestScore = keyScores[static_cast<size_t>(best)];
+        if (score > bestScore ||
+            (score == bestScore && (row % 12) * 2 + row / 12 < (best % 12) * 2 + best / 12)) {
+            best = row;
+        }
+    }
+
+    // Hold the current key unless the new one clearly wins
+    if (currentRow >= 0 && best != currentRow &&
+        keyScores[static_cast<size_t>(best)] <
+            keyScores[static_cast<size_t>(currentRow)] + switchMargin) {
+        best = currentRow;
+    }
+    publish(best);
+}
+
+void StreamingKeyDetector::publish(int row) {
+    currentRow = row;
+    ScaleType type = row < 12 ? ScaleType::Ionian : ScaleType::Aeolian;
+    double confidence = std::clamp((keyScores[static_cast<size_t>(row)] + 1.0) / 2.0, 0.0, 1.0);
+    uint32_t packed = 0x80000000u |
+                      static_cast<uint32_t>(row % 12) |
+                      (static_cast<uint32_t>(type) << 4) |
+                      (static_cast<uint32_t>(std::lround(confidence * 65535.0)) << 12);
+    published.store(packed, std::memory_order_relaxed);
+}
+
+Scale StreamingKeyDetector::getKey() const {
+    uint32_t packed = published.load(std::memory_order_relaxed);
+    if (packed == 0) {
+        return Scale();
+    }
+    return Scale(static_cast<NoteName>(packed & 0x0F),
+                 static_cast<ScaleType>((packed >> 4) & 0xFF),
+                 static_cast<double>((packed >> 12) & 0xFFFF) / 65535.0);
+}
+
+} // namespace MIDIScaleDetector
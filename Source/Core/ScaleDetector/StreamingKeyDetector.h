@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include "ScaleScoring.h"
+
+namespace MIDIScaleDetector {
+
+// Running key estimate for live MIDI input.
+//
+// Each note adds its weight to a pitch-class histogram whose bins decay
+// exponentially with age, so the estimate follows what was played
+// recently. A note costs one decay of the twelve bins and one add;
+// update() correlates the histogram with the 24 keys (ScaleScorer::scoreKeys,
+// no scale templates) at most once per call. Nothing locks or
+// allocates after construction, so noteOn() and update() are safe on the
+// audio thread. The key is published through an atomic and can be read
+// from any thread.
+class StreamingKeyDetector {
+public:
+    StreamingKeyDetector();
+
+    // Seconds for a note's weight to halve (default 4)
+    void setHalfLife(double seconds);
+
+    // A different key replaces the current one only when its correlation
+    // is higher by this much (default 0.05)
+    void setSwitchMargin(double margin) { switchMargin = margin; }
+
+    // Decayed weight needed before a key is published; one note at full
+    // velocity weighs 1 (default 4)
+    void setMinimumWeight(double weight) { minimumWeight = weight; }
+
+    void setWeightByVelocity(bool enabled) { weightByVelocity = enabled; }
+
+    // Audio thread. Times are in seconds and should not go backwards.
+    void noteOn(int pitch, int velocity, double time);
+    void update();
+    void reset();
+
+    // Any thread
+    bool hasKey() const { return published.load(std::memory_order_relaxed) != 0; }
+    Scale getKey() const;   // Default Scale (type Unknown) until hasKey()
+
+    // Histogram decayed to the last note, unnormalised
+    const std::array<double, 12>& getHistogram() const { return histogram; }
+
+private:
+    ScaleScorer scorer;
+    std::array<double, ScaleScores::kKeyRows> keyScores;
+    std::array<double, 12> histogram;
+    double totalWeight;
+    double lastTime;
+    double decayRate;       // Natural-log decay per second
+    double switchMargin;
+    double minimumWeight;
+    bool weightByVelocity;
+    bool changed;
+    int currentRow;         // Key row of the last published key, -1 if none
+
+    // Bit 31 set when valid; root, type and confidence below it
+    std::atomic<uint32_t> published;
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Key must publish without locks");
+
+    void publish(int row);
+};
+
+} // namespace MIDIScaleDetector
@@ -23,6 +23,9 @@ MIDIScalePlugin::MIDIScalePlugin()
         "scale", "Scale Type",
         juce::StringArray("Major", "Minor", "Dorian", "Phrygian", "Lydian", "Mixolydian", "Locrian"),
         0));
+
+    addParameter(followLiveInput = new juce::AudioParameterBool(
+        "followLive", "Follow Live Key", false));
 }
 
 MIDIScalePlugin::~MIDIScalePlugin() {}
@@ -30,6 +33,9 @@ MIDIScalePlugin::~MIDIScalePlugin() {}
 void MIDIScalePlugin::prepareToPlay(double sampleRate, int samplesPerBlock) {
     currentSampleRate = sampleRate;
     currentBlockSize = samplesPerBlock;
+
+    liveKeyDetector.reset();
+    liveSamplePosition = 0;
 }
 
 void MIDIScalePlugin::releaseResources() {
@@ -49,6 +55,18 @@ void MIDIScalePlugin::clearMidiQueue() {
 void MIDIScalePlugin::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiBuffer& midiMessages) {
     buffer.clear();
 
+    // Feed the player's notes to the live key detector before file playback
+    // and editor messages are mixed in. Raw bytes, so nothing is copied.
+    for (const auto metadata : midiMessages) {
+        const juce::uint8* data = metadata.data;
+        if (metadata.numBytes >= 3 && (data[0] & 0xF0) == 0x90 && data[2] > 0) {
+            double time = static_cast<double>(liveSamplePosition + metadata.samplePosition) / currentSampleRate;
+            liveKeyDetector.noteOn(data[1], data[2], time);
+        }
+    }
+    liveKeyDetector.update();
+    liveSamplePosition += buffer.getNumSamples();
+
     // Check if we need to send note-offs (from pause/stop/seek)
     if (playbackState.pendingNoteOffs.exchange(false)) {
         sendActiveNoteOffsImmediate(midiMessages);
@@ -121,6 +139,12 @@ void MIDIScalePlugin::processBlock(juce::AudioBuffer<float>& buffer, juce::MidiB
         return; // Pass through with any queued messages
     }
 
+    // Follow the player's key once the live detector has one
+    transformScale = currentScale;
+    if (followLiveInput->get() && liveKeyDetector.hasKey()) {
+        transformScale = liveKeyDetector.getKey();
+    }
+
     juce::MidiBuffer processedMidi;
 
     for (const auto metadata : midiMessages) {
@@ -189,6 +213,7 @@ void MIDIScalePlugin::getStateInformation(juce::MemoryBlock& destData) {
 
     // Save selected file path
     stream.writeString(playbackState.currentFilePath);
+    stream.writeBool(followLiveInput->get());
 }
 
 void MIDIScalePlugin::setStateInformation(const void* data, int sizeInBytes) {
@@ -204,11 +229,16 @@ void MIDIScalePlugin::setStateInformation(const void* data, int sizeInBytes) {
     if (!stream.isExhausted()) {
         playbackState.currentFilePath = stream.readString();
     }
+    if (!stream.isExhausted()) {
+        followLiveInput->setValueNotifyingHost(stream.readBool() ? 1.0f : 0.0f);
+    }
 }
 
 void MIDIScalePlugin::loadMIDIFile(const juce::File& file) {
     MIDIFile midiFile;
     MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    parser.setParseOptions(ParseNotesOnly);
 
     if (parser.parse(file.getFullPathName().toStdString(), midiFile)) {
         HarmonicAnalysis analysis = detector.analyze(midiFile);
@@ -220,35 +250,43 @@ void MIDIScalePlugin::loadMIDIFile(const juce::File& file) {
 }
 
 int MIDIScalePlugin::constrainNoteToScale(int midiNote) {
-    if (currentScale.intervals.empty()) {
+    if (transformScale.mask == 0) {
         return midiNote;
     }
 
     int octave = midiNote / 12;
     int pitchClass = midiNote % 12;
-    int rootPitch = static_cast<int>(currentScale.root);
+    int rootPitch = static_cast<int>(transformScale.root);
+    PitchClassMask pitchClasses = transformScale.getPitchClasses();
 
-    int minDist = 12;
-    int closestNote = midiNote;
-
-    for (int interval : currentScale.intervals) {
-        int scaleNote = (rootPitch + interval) % 12;
-        int dist = std::abs(pitchClass - scaleNote);
+    if ((pitchClasses >> pitchClass) & 1) {
+        return midiNote;
+    }
 
-        if (dist < minDist) {
-            minDist = dist;
-            closestNote = octave * 12 + scaleNote;
+    // Nearest scale note within the octave; on a tie, the one closer above the root
+    for (int distance = 1; distance < 12; ++distance) {
+        int below = pitchClass - distance;
+        int above = pitchClass + distance;
+        bool hasBelow = below >= 0 && ((pitchClasses >> below) & 1);
+        bool hasAbove = above < 12 && ((pitchClasses >> above) & 1);
+        if (hasBelow && hasAbove) {
+            int belowInterval = (below - rootPitch + 12) % 12;
+            int aboveInterval = (above - rootPitch + 12) % 12;
+            return octave * 12 + (belowInterval < aboveInterval ? below : above);
+        }
+        if (hasBelow || hasAbove) {
+            return octave * 12 + (hasBelow ? below : above);
         }
     }
 
-    return closestNote;
+    return midiNote;
 }
 
 std::vector<int> MIDIScalePlugin::harmonizeNote(int midiNote) {
     std::vector<int> notes;
     notes.push_back(midiNote);
 
-    if (currentScale.intervals.size() >= 3) {
+    if (transformScale.noteCount() >= 3) {
         int third = constrainNoteToScale(midiNote + 4);
         if (third != midiNote) {
             notes.push_back(third);
@@ -266,17 +304,19 @@ std::vector<int> MIDIScalePlugin::harmonizeNote(int midiNote) {
 std::vector<int> MIDIScalePlugin::arpeggiateNote(int midiNote) {
     std::vector<int> notes;
 
-    if (currentScale.intervals.empty()) {
+    if (transformScale.mask == 0) {
         notes.push_back(midiNote);
         return notes;
     }
 
     int octave = midiNote / 12;
-    int rootPitch = static_cast<int>(currentScale.root);
+    int rootPitch = static_cast<int>(transformScale.root);
 
-    for (size_t i = 0; i < std::min(size_t(4), currentScale.intervals.size()); ++i) {
-        int note = octave * 12 + (rootPitch + currentScale.intervals[i]) % 12;
-        notes.push_back(note);
+    // First four scale degrees, ascending from the root
+    for (int interval = 0; interval < 12 && notes.size() < 4; ++interval) {
+        if ((transformScale.mask >> interval) & 1) {
+            notes.push_back(octave * 12 + (rootPitch + interval) % 12);
+        }
     }
 
     return notes;
@@ -4,6 +4,7 @@
 #include <juce_audio_utils/juce_audio_utils.h>
 #include "../Core/MIDIParser/MIDIParser.h"
 #include "../Core/ScaleDetector/ScaleDetector.h"
+#include "../Core/ScaleDetector/StreamingKeyDetector.h"
 #include "../Core/Database/Database.h"
 #include <mutex>
 #include <atomic>
@@ -60,6 +61,13 @@ public:
     void setTransformMode(TransformMode mode) { transformMode = mode; }
     TransformMode getTransformMode() const { return transformMode; }
 
+    // Key follow - the transform modes use the key of what is being played
+    // into the plugin instead of the loaded file's, once there is one
+    void setFollowLiveInput(bool follow) { followLiveInput->setValueNotifyingHost(follow ? 1.0f : 0.0f); }
+    bool isFollowingLiveInput() const { return followLiveInput->get(); }
+    bool hasLiveScale() const { return liveKeyDetector.hasKey(); }
+    Scale getLiveScale() const { return liveKeyDetector.getKey(); }
+
     // MIDI playback from editor - thread-safe queue
     void addMidiMessage(const juce::MidiMessage& msg);
     void clearMidiQueue();
@@ -152,6 +160,11 @@ private:
     ScaleDetector detector;
     Scale currentScale;
 
+    // Live input key - fed and updated in processBlock only
+    StreamingKeyDetector liveKeyDetector;
+    int64_t liveSamplePosition = 0;
+    Scale transformScale;   // Scale the transform modes use for the current block
+
     bool constrainToScale;
     TransformMode transformMode;
     double currentSampleRate = 44100.0;
@@ -175,6 +188,7 @@ private:
     juce::AudioParameterFloat* scaleConfidence;
     juce::AudioParameterChoice* rootNote;
     juce::AudioParameterChoice* scaleType;
+    juce::AudioParameterBool* followLiveInput;
 
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(MIDIScalePlugin)
 };
@@ -101,6 +101,92 @@ namespace {
         }
         return 0;  // Not a preset - will show custom text
     }
+
+    // General MIDI program names, indexed by program number
+    const char* const kGMInstruments[] = {
+        "Acoustic Grand Piano", "Bright Acoustic Piano", "Electric Grand Piano", "Honky-tonk Piano",
+        "Electric Piano 1", "Electric Piano 2", "Harpsichord", "Clavinet",
+        "Celesta", "Glockenspiel", "Music Box", "Vibraphone",
+        "Marimba", "Xylophone", "Tubular Bells", "Dulcimer",
+        "Drawbar Organ", "Percussive Organ", "Rock Organ", "Church Organ",
+        "Reed Organ", "Accordion", "Harmonica", "Tango Accordion",
+        "Acoustic Guitar (nylon)", "Acoustic Guitar (steel)", "Electric Guitar (jazz)", "Electric Guitar (clean)",
+        "Electric Guitar (muted)", "Overdriven Guitar", "Distortion Guitar", "Guitar Harmonics",
+        "Acoustic Bass", "Electric Bass (finger)", "Electric Bass (pick)", "Fretless Bass",
+        "Slap Bass 1", "Slap Bass 2", "Synth Bass 1", "Synth Bass 2",
+        "Violin", "Viola", "Cello", "Contrabass",
+        "Tremolo Strings", "Pizzicato Strings", "Orchestral Harp", "Timpani",
+        "String Ensemble 1", "String Ensemble 2", "Synth Strings 1", "Synth Strings 2",
+        "Choir Aahs", "Voice Oohs", "Synth Voice", "Orchestra Hit",
+        "Trumpet", "Trombone", "Tuba", "Muted Trumpet",
+        "French Horn", "Brass Section", "Synth Brass 1", "Synth Brass 2",
+        "Soprano Sax", "Alto Sax", "Tenor Sax", "Baritone Sax",
+        "Oboe", "English Horn", "Bassoon", "Clarinet",
+        "Piccolo", "Flute", "Recorder", "Pan Flute",
+        "Blown Bottle", "Shakuhachi", "Whistle", "Ocarina",
+        "Lead 1 (square)", "Lead 2 (sawtooth)", "Lead 3 (calliope)", "Lead 4 (chiff)",
+        "Lead 5 (charang)", "Lead 6 (voice)", "Lead 7 (fifths)", "Lead 8 (bass + lead)",
+        "Pad 1 (new age)", "Pad 2 (warm)", "Pad 3 (polysynth)", "Pad 4 (choir)",
+        "Pad 5 (bowed)", "Pad 6 (metallic)", "Pad 7 (halo)", "Pad 8 (sweep)",
+        "FX 1 (rain)", "FX 2 (soundtrack)", "FX 3 (crystal)", "FX 4 (atmosphere)",
+        "FX 5 (brightness)", "FX 6 (goblins)", "FX 7 (echoes)", "FX 8 (sci-fi)",
+        "Sitar", "Banjo", "Shamisen", "Koto",
+        "Kalimba", "Bagpipe", "Fiddle", "Shanai",
+        "Tinkle Bell", "Agogo", "Steel Drums", "Woodblock",
+        "Taiko Drum", "Melodic Tom", "Synth Drum", "Reverse Cymbal",
+        "Guitar Fret Noise", "Breath Noise", "Seashore", "Bird Tweet",
+        "Telephone Ring", "Helicopter", "Applause", "Gunshot"
+    };
+
+    // filecache.json rows from an older version are analyzed again
+    constexpr int kFileCacheVersion = 5;
+
+    juce::String getGMInstrumentName(int program) {
+        if (program < 0 || program >= 128)
+            return "---";
+        return kGMInstruments[program];
+    }
+
+    // Round a length up to whole 4/4 bars so previews loop cleanly
+    double roundBeatsToBars(double seconds, double bpm) {
+        double beatsPerSecond = (bpm > 0 ? bpm : 120.0) / 60.0;
+        double bars = std::ceil(seconds * beatsPerSecond / 4.0);
+        if (bars < 1.0) bars = 1.0;
+        return bars * 4.0;
+    }
+
+    // MIDI packs are browsed in place: an entry inside a zip is addressed as
+    // "pack.zip!/inner/file.mid" (same scheme as the Core scanner's database)
+    bool isMidiFileName(const juce::String& name) {
+        auto ext = name.fromLastOccurrenceOf(".", true, false).toLowerCase();
+        return ext == ".mid" || ext == ".midi";
+    }
+
+    bool midiFileExists(const juce::String& path) {
+        std::string archivePath, entryName;
+        if (MIDIScaleDetector::ZipArchive::splitPath(path.toStdString(), archivePath, entryName)) {
+            return juce::File(juce::String(archivePath)).existsAsFile();
+        }
+        return juce::File(path).existsAsFile();
+    }
+
+    // Zip entries change with their archive
+    juce::int64 midiFileModifiedTime(const juce::String& path) {
+        std::string archivePath, entryName;
+        juce::File file = MIDIScaleDetector::ZipArchive::splitPath(path.toStdString(), archivePath, entryName)
+            ? juce::File(juce::String(archivePath)) : juce::File(path);
+        return file.getLastModificationTime().toMilliseconds();
+    }
+
+    // Read a MIDI file from disk or from inside a zip archive
+    bool readMidiFile(const juce::String& path, juce::MidiFile& midi, juce::int64* fileSize = nullptr) {
+        std::string error;
+        auto source = MIDIScaleDetector::MappedFile::open(path.toStdString(), error);
+        if (!source) return false;
+        if (fileSize) *fileSize = static_cast<juce::int64>(source->size());
+        juce::MemoryInputStream stream(source->data(), source->size(), false);
+        return midi.readFrom(stream);
+    }
 }
 
 MIDIXplorerEditor::MIDIXplorerEditor(juce::AudioProcessor& p)
@@ -109,6 +195,15 @@ MIDIXplorerEditor::MIDIXplorerEditor(juce::AudioProcessor& p)
     pluginProcessor = dynamic_cast<MIDIScaleDetector::MIDIScalePlugin*>(&p);
     setWantsKeyboardFocus(true);
 
+    // Background analysis reads notes, tempo and the first program change
+    analysisParser.setParseOptions(MIDIScaleDetector::ParseNotesAndPrograms);
+    analysisParser.setBuildNoteTable(true);
+    analysisDetector.setUseDeclaredKey(true);
+    analysisDetector.setAnalysisLevel(MIDIScaleDetector::AnalysisLevel::KeyOnly);
+    noteCache.setDirectory(juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+                               .getChildFile("MIDIXplorer").getChildFile("notecache")
+                               .getFullPathName().toStdString());
+
     // Setup library sidebar
     librariesLabel.setText("Libraries", juce::dontSendNotification);
     librariesLabel.setFont(juce::FontOptions(14.0f).withStyle("Bold"));
@@ -297,14 +392,10 @@ MIDIXplorerEditor::MIDIXplorerEditor(juce::AudioProcessor& p)
             auto& selectedFile = filteredFiles[static_cast<size_t>(selectedRow)];
             if (pluginProcessor) {
                 // Load and queue MIDI data to be inserted at playhead
-                juce::File midiFile(selectedFile.fullPath);
-                if (midiFile.existsAsFile()) {
-                    juce::MidiFile midi;
-                    juce::FileInputStream fis(midiFile);
-                    if (fis.openedOk() && midi.readFrom(fis)) {
-                        // Queue MIDI for insertion at current playhead
-                        pluginProcessor->queueMidiForInsertion(midi);
-                    }
+                juce::MidiFile midi;
+                if (readMidiFile(selectedFile.fullPath, midi)) {
+                    // Queue MIDI for insertion at current playhead
+                    pluginProcessor->queueMidiForInsertion(midi);
                 }
             }
         }
@@ -548,7 +639,7 @@ void MIDIXplorerEditor::saveFileCache() {
         filesArray.add(juce::var(fileObj.get()));
     }
     root->setProperty("files", filesArray);
-    root->setProperty("cacheVersion", 4);  // Bump version to force tag re-extraction
+    root->setProperty("cacheVersion", kFileCacheVersion);
 
     juce::var jsonVar(root.get());
     auto jsonStr = juce::JSON::toString(jsonVar);
@@ -563,6 +654,8 @@ void MIDIXplorerEditor::loadFileCache() {
     auto jsonVar = juce::JSON::parse(jsonStr);
 
     if (auto* obj = jsonVar.getDynamicObject()) {
+        // Rows written by an older analyzer are shown but analyzed again
+        const bool currentVersion = (int)obj->getProperty("cacheVersion") >= kFileCacheVersion;
         auto filesVar = obj->getProperty("files");
         if (auto* filesArray = filesVar.getArray()) {
             for (const auto& fileVar : *filesArray) {
@@ -582,6 +675,9 @@ void MIDIXplorerEditor::loadFileCache() {
                     info.analyzed = (bool)fileObj->getProperty("analyzed");
                     info.containsChords = (bool)fileObj->getProperty("containsChords");
                     info.containsSingleNotes = (bool)fileObj->getProperty("containsSingleNotes");
+                    if (!currentVersion) {
+                        info.analyzed = false;
+                    }
 
                     // If key is not set or is "---", try to extract from filename
                     if (info.key.isEmpty() || info.key == "---") {
@@ -595,7 +691,7 @@ void MIDIXplorerEditor::loadFileCache() {
                     info.tags = extractTagsFromFilename(info.fileName);
 
                     // Only add if file still exists
-                    if (juce::File(info.fullPath).existsAsFile()) {
+                    if (midiFileExists(info.fullPath)) {
                         allFiles.push_back(info);
 
                         // Queue unanalyzed files for analysis to continue progress
@@ -871,43 +967,52 @@ void MIDIXplorerEditor::timerCallback() {
     // Process background file scanning (non-blocking, incremental)
     if (isScanningFiles && currentDirIterator) {
         int filesFound = 0;
+        bool directoryDone = false;
         static constexpr int FILES_PER_SCAN_TICK = 50;  // Discover 50 files per tick
 
-        while (filesFound < FILES_PER_SCAN_TICK && currentDirIterator->next()) {
-            auto file = currentDirIterator->getFile();
-            auto ext = file.getFileExtension().toLowerCase();
-            if (ext == ".mid" || ext == ".midi") {
-                // Always count the file for this library's file count
-                libraries[currentScanLibraryIndex].fileCount++;
+        while (filesFound < FILES_PER_SCAN_TICK) {
+            // A pack stays open while its entries are added, under the same
+            // per-tick cap as loose files. Each entry is inflated once and
+            // probed from memory.
+            if (scanArchive.isOpen()) {
+                const auto& entries = scanArchive.getEntries();
+                if (scanArchiveEntry >= entries.size()) {
+                    scanArchive.close();
+                    continue;
+                }
+                const auto& entry = entries[scanArchiveEntry++];
+                if (!isMidiFileName(juce::String(entry.name))) {
+                    continue;
+                }
+                MIDIScaleDetector::MIDIProbe probe;
+                bool probed = scanArchive.extract(entry, scanBuffer)
+                           && scanParser.probe(scanBuffer.data(), scanBuffer.size(), probe);
+                addScannedFile(juce::String(MIDIScaleDetector::ZipArchive::makePath(scanArchive.getPath(), entry.name)),
+                               static_cast<juce::int64>(entry.uncompressedSize), probed ? &probe : nullptr);
                 filesFound++;
+                continue;
+            }
 
-                // Check for duplicates - only add to allFiles if not already present
-                bool isDuplicate = false;
-                for (const auto& existingFile : allFiles) {
-                    if (existingFile.fullPath == file.getFullPathName()) {
-                        isDuplicate = true;
-                        break;
-                    }
-                }
-                if (!isDuplicate) {
-                    MIDIFileInfo info;
-                    info.fileName = file.getFileName();
-                    info.fullPath = file.getFullPathName();
-                    info.libraryName = libraries[currentScanLibraryIndex].name;
-                    // Try to extract key from filename first
-                    juce::String extractedKey = extractKeyFromFilename(info.fileName);
-                    info.key = extractedKey.isNotEmpty() ? extractedKey : "---";
-                    info.tags = extractTagsFromFilename(info.fileName);
-                    allFiles.push_back(info);
+            if (!currentDirIterator->next()) {
+                directoryDone = true;
+                break;
+            }
+            auto file = currentDirIterator->getFile();
+            auto ext = file.getFileExtension().toLowerCase();
 
-                    // Queue for analysis
-                    analysisQueue.push_back(allFiles.size() - 1);
-                }
+            if (ext == ".zip") {
+                scanArchive.open(file.getFullPathName().toStdString());
+                scanArchiveEntry = 0;
+            } else if (ext == ".mid" || ext == ".midi") {
+                MIDIScaleDetector::MIDIProbe probe;
+                bool probed = scanParser.probe(file.getFullPathName().toStdString(), probe);
+                addScannedFile(file.getFullPathName(), file.getSize(), probed ? &probe : nullptr);
+                filesFound++;
             }
         }
 
         // Check if current directory scan is complete
-        if (!currentDirIterator->next()) {
+        if (directoryDone) {
             currentDirIterator.reset();
             libraries[currentScanLibraryIndex].isScanning = false;
 
@@ -918,7 +1023,7 @@ void MIDIXplorerEditor::timerCallback() {
                 libraries[currentScanLibraryIndex].isScanning = true;
                 juce::File dir(libraries[currentScanLibraryIndex].path);
                 if (dir.isDirectory()) {
-                    currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi");
+                    currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi;*.zip");
                 }
             } else {
                 isScanningFiles = false;
@@ -927,7 +1032,6 @@ void MIDIXplorerEditor::timerCallback() {
             filterFiles();
             libraryListBox.repaint();
         } else {
-            // Re-position iterator (we moved past one file checking if done)
             // Update UI periodically during scanning
             if (filesFound > 0) {
                 filterFiles();
@@ -964,6 +1068,11 @@ void MIDIXplorerEditor::timerCallback() {
             saveFileCache();
             analysisSaveCounter = 0;
         }
+
+        // Don't hold a pack mapped once its entries are done
+        if (analysisQueue.empty()) {
+            analysisArchive.close();
+        }
     }
 
     bool synced = syncToHostToggle.getToggleState();
@@ -1299,16 +1408,12 @@ void MIDIXplorerEditor::loadSelectedFile() {
     if (selectedFileIndex < 0 || selectedFileIndex >= (int)filteredFiles.size()) return;
 
     auto& info = filteredFiles[(size_t)selectedFileIndex];
-    juce::File file(info.fullPath);
-
-    if (!file.existsAsFile()) return;
 
     // Note: allNotesOff is handled by selectAndPreview before calling this
 
-    juce::FileInputStream stream(file);
-    if (!stream.openedOk()) return;
-
-    currentMidiFile.readFrom(stream);
+    // Plain files and zip entries ("pack.zip!/file.mid") load the same way
+    currentMidiFile.clear();
+    if (!readMidiFile(info.fullPath, currentMidiFile)) return;
     currentMidiFile.convertTimestampTicksToSeconds();
 
     // Extract tempo from MIDI file
@@ -1573,7 +1678,8 @@ void MIDIXplorerEditor::scanLibraries() {
         libraries[currentScanLibraryIndex].isScanning = true;
         juce::File dir(libraries[currentScanLibraryIndex].path);
         if (dir.isDirectory()) {
-            currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi");
+            scanArchive.close();
+            currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi;*.zip");
             isScanningFiles = true;
         }
     }
@@ -1608,7 +1714,8 @@ void MIDIXplorerEditor::scanLibrary(size_t index) {
     if (!isScanningFiles) {
         // Start scanning immediately
         currentScanLibraryIndex = index;
-        currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi");
+        scanArchive.close();
+        currentDirIterator = std::make_unique<juce::DirectoryIterator>(dir, true, "*.mid;*.midi;*.zip");
         isScanningFiles = true;
     } else {
         // Queue for later
@@ -1701,420 +1808,145 @@ void MIDIXplorerEditor::refreshLibrary(size_t index) {
     libraryListBox.repaint();
 }
 
-void MIDIXplorerEditor::analyzeFile(size_t index) {
-    if (index >= allFiles.size()) return;
+void MIDIXplorerEditor::addScannedFile(const juce::String& fullPath, juce::int64 fileSize,
+                                       const MIDIScaleDetector::MIDIProbe* probe) {
+    // Always count the file for this library's file count
+    libraries[currentScanLibraryIndex].fileCount++;
 
-    auto& info = allFiles[index];
-    juce::File file(info.fullPath);
-
-    if (!file.existsAsFile()) {
-        info.analyzed = true;  // Mark as analyzed to avoid retrying
-        return;
+    // Check for duplicates - only add to allFiles if not already present
+    for (const auto& existingFile : allFiles) {
+        if (existingFile.fullPath == fullPath) {
+            return;
+        }
     }
 
-    // Capture file size
-    info.fileSize = file.getSize();
+    MIDIFileInfo info;
+    info.fileName = fullPath.fromLastOccurrenceOf("/", false, false);
+    info.fullPath = fullPath;
+    info.libraryName = libraries[currentScanLibraryIndex].name;
+    // Try to extract key from filename first
+    juce::String extractedKey = extractKeyFromFilename(info.fileName);
+    info.key = extractedKey.isNotEmpty() ? extractedKey : "---";
+    info.tags = extractTagsFromFilename(info.fileName);
+
+    // Header-level probe so tempo, length and instrument show up
+    // immediately; key and chords wait for analyzeFile()
+    if (probe != nullptr) {
+        info.bpm = probe->tempo;
+        info.durationBeats = roundBeatsToBars(probe->duration, probe->tempo);
+        info.duration = info.durationBeats * 60.0 / probe->tempo;
+        info.instrument = getGMInstrumentName(probe->firstProgram);
+        info.fileSize = fileSize;
+    }
+    allFiles.push_back(info);
+
+    // Queue for analysis
+    analysisQueue.push_back(allFiles.size() - 1);
+}
 
-    juce::FileInputStream stream(file);
-    if (!stream.openedOk()) {
-        info.analyzed = true;
-        return;
+bool MIDIXplorerEditor::parseForAnalysis(const std::string& path, MIDIScaleDetector::MIDIFile& midiFile) {
+    std::string archivePath, entryName;
+    if (!MIDIScaleDetector::ZipArchive::splitPath(path, archivePath, entryName)) {
+        return analysisParser.parse(path, midiFile);
     }
 
-    juce::MidiFile midiFile;
-    if (!midiFile.readFrom(stream)) {
-        info.analyzed = true;
-        return;
+    // A pack's entries are queued together, so the last archive read is
+    // kept open for the next one
+    if (analysisArchive.getPath() != archivePath && !analysisArchive.open(archivePath)) {
+        return false;
     }
-
-    // Count notes per pitch class
-    std::array<int, 12> noteHistogram = {0};
-
-    for (int track = 0; track < midiFile.getNumTracks(); track++) {
-        auto* sequence = midiFile.getTrack(track);
-        if (sequence) {
-            for (int i = 0; i < sequence->getNumEvents(); i++) {
-                auto& msg = sequence->getEventPointer(i)->message;
-                if (msg.isNoteOn() && msg.getVelocity() > 0) {
-                    int pitchClass = msg.getNoteNumber() % 12;
-                    noteHistogram[(size_t)pitchClass]++;
-                }
-            }
-        }
+    const auto* entry = analysisArchive.findEntry(entryName);
+    std::vector<uint8_t> buffer;
+    if (entry == nullptr || !analysisArchive.extract(*entry, buffer)) {
+        return false;
     }
-
-    // Initialize chord detection flags (will be set after timestamp conversion)
-    info.containsChords = false;
-    info.containsSingleNotes = false;
-
-    // Comprehensive scale templates (intervals from root)
-    struct ScaleTemplate {
-        const char* name;
-        int intervals[12];
-    };
-
-    static const ScaleTemplate scales[] = {
-        // Major modes
-        {"Major",           {1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1}},
-        {"Dorian",          {1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 1, 0}},
-        {"Phrygian",        {1, 1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0}},
-        {"Lydian",          {1, 0, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1}},
-        {"Mixolydian",      {1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1, 0}},
-        {"Minor",           {1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 1, 0}},  // Natural minor/Aeolian
-        {"Locrian",         {1, 1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 0}},
-
-        // Other minor variants
-        {"Harmonic Min",    {1, 0, 1, 1, 0, 1, 0, 1, 1, 0, 0, 1}},
-        {"Melodic Min",     {1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0, 1}},
-
-        // Pentatonic
-        {"Major Pent",      {1, 0, 1, 0, 1, 0, 0, 1, 0, 1, 0, 0}},
-        {"Minor Pent",      {1, 0, 0, 1, 0, 1, 0, 1, 0, 0, 1, 0}},
-
-        // Blues
-        {"Blues",           {1, 0, 0, 1, 0, 1, 1, 1, 0, 0, 1, 0}},
-        {"Major Blues",     {1, 0, 1, 1, 1, 0, 0, 1, 0, 1, 0, 0}},
-
-        // Exotic/World scales
-        {"Hungarian Min",   {1, 0, 1, 1, 0, 0, 1, 1, 1, 0, 0, 1}},
-        {"Spanish",         {1, 1, 0, 0, 1, 1, 0, 1, 1, 0, 1, 0}},
-        {"Arabic",          {1, 0, 1, 0, 1, 1, 1, 1, 0, 1, 0, 0}},
-        {"Japanese",        {1, 1, 0, 0, 0, 1, 0, 1, 1, 0, 0, 0}},
-        {"Egyptian",        {1, 0, 1, 0, 0, 1, 0, 1, 0, 0, 1, 0}},
-        {"Persian",         {1, 1, 0, 0, 1, 1, 1, 1, 0, 0, 1, 0}},
-
-        // Jazz/Bebop
-        {"Bebop Dom",       {1, 0, 1, 0, 1, 1, 0, 1, 0, 1, 1, 1}},
-        {"Bebop Major",     {1, 0, 1, 0, 1, 1, 0, 1, 1, 1, 0, 1}},
-        {"Altered",         {1, 1, 0, 1, 1, 0, 1, 0, 1, 0, 1, 0}},
-
-        // Symmetric
-        {"Whole Tone",      {1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0}},
-        {"Diminished",      {1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0, 1}},
-        {"Aug",             {1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1}},
-        {"Chromatic",       {1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1}},
-    };
-
-    const char* noteNames[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
-    const int numScales = sizeof(scales) / sizeof(scales[0]);
-
-    int bestKey = 0;
-    int bestScaleIdx = 0;
-    int bestScore = -1;
-
-    for (int root = 0; root < 12; root++) {
-        for (int s = 0; s < numScales; s++) {
-            int score = 0;
-            int templateNotes = 0;
-            int matchedNotes = 0;
-
-            for (int i = 0; i < 12; i++) {
-                int idx = (i + root) % 12;
-                if (scales[s].intervals[i] == 1) {
-                    templateNotes++;
-                    score += noteHistogram[(size_t)idx] * 2;  // Bonus for matching scale notes
-                    if (noteHistogram[(size_t)idx] > 0) matchedNotes++;
-                } else {
-                    score -= noteHistogram[(size_t)idx];  // Penalty for non-scale notes
-                }
-            }
-
-            // Prefer scales where more template notes are actually used
-            if (templateNotes > 0) {
-                score += (matchedNotes * 10) / templateNotes;
-            }
-
-            if (score > bestScore) {
-                bestScore = score;
-                bestKey = root;
-                bestScaleIdx = s;
-            }
-        }
-    }
-
-    // Get mode degree string (e.g., "2nd", "4th", etc.)
-    juce::String scaleName = scales[bestScaleIdx].name;
-    juce::String modeInfo;
-
-    if (scaleName == "Dorian") {
-        modeInfo = " (Maj 2nd)";
-    } else if (scaleName == "Phrygian") {
-        modeInfo = " (Maj 3rd)";
-    } else if (scaleName == "Lydian") {
-        modeInfo = " (Maj 4th)";
-    } else if (scaleName == "Mixolydian") {
-        modeInfo = " (Maj 5th)";
-    } else if (scaleName == "Minor") {
-        modeInfo = " (Maj 6th)";
-    } else if (scaleName == "Locrian") {
-        modeInfo = " (Maj 7th)";
-    } else if (scaleName == "Harmonic Min") {
-        modeInfo = "";
-    } else if (scaleName == "Melodic Min") {
-        modeInfo = "";
-    }
-
-    info.key = juce::String(noteNames[bestKey]) + " " + scales[bestScaleIdx].name + modeInfo;
-
-    // Calculate Circle of Fifths - show parent major key and relative minor
-    // Each mode has a specific relationship to its parent major scale
-    int parentMajorRoot = bestKey;  // Default: same as detected root
-
-    // Calculate parent major key based on mode (semitones from mode root to parent major)
-    if (scaleName == "Major" || scaleName == "Major Pent" || scaleName == "Major Blues") {
-        parentMajorRoot = bestKey;  // Ionian - root IS the parent major
-    } else if (scaleName == "Dorian") {
-        parentMajorRoot = (bestKey + 10) % 12;  // 2nd mode: go down 2 semitones (or +10)
-    } else if (scaleName == "Phrygian") {
-        parentMajorRoot = (bestKey + 8) % 12;   // 3rd mode: go down 4 semitones (or +8)
-    } else if (scaleName == "Lydian") {
-        parentMajorRoot = (bestKey + 7) % 12;   // 4th mode: go down 5 semitones (or +7)
-    } else if (scaleName == "Mixolydian") {
-        parentMajorRoot = (bestKey + 5) % 12;   // 5th mode: go down 7 semitones (or +5)
-    } else if (scaleName == "Minor" || scaleName == "Minor Pent" || scaleName.containsIgnoreCase("Harmonic") || scaleName.containsIgnoreCase("Melodic")) {
-        parentMajorRoot = (bestKey + 3) % 12;   // 6th mode (Aeolian): go up 3 semitones
-    } else if (scaleName == "Locrian") {
-        parentMajorRoot = (bestKey + 1) % 12;   // 7th mode: go up 1 semitone
-    } else if (scaleName == "Blues") {
-        parentMajorRoot = (bestKey + 3) % 12;   // Blues is based on minor pentatonic
-    } else {
-        // For exotic scales, show parallel major/minor relationship
-        parentMajorRoot = bestKey;
+    if (!analysisParser.parse(MIDIScaleDetector::MappedFile::fromBuffer(std::move(buffer)), midiFile)) {
+        return false;
     }
+    midiFile.filePath = path;
+    return true;
+}
 
-    // Relative minor is always 3 semitones below the parent major (or +9)
-    int relativeMinorRoot = (parentMajorRoot + 9) % 12;
+void MIDIXplorerEditor::analyzeFile(size_t index) {
+    if (index >= allFiles.size()) return;
 
-    // Format: "Parent Maj / Rel m" e.g., "G Maj / Em"
-    info.relativeKey = juce::String(noteNames[parentMajorRoot]) + "/" + juce::String(noteNames[relativeMinorRoot]) + "m";
+    auto& info = allFiles[index];
 
-    // Extract tempo from MIDI file
-    info.bpm = 120.0;  // Default
-    for (int track = 0; track < midiFile.getNumTracks(); track++) {
-        auto* trackSeq = midiFile.getTrack(track);
-        if (trackSeq) {
-            for (int i = 0; i < trackSeq->getNumEvents(); i++) {
-                auto& msg = trackSeq->getEventPointer(i)->message;
-                if (msg.isTempoMetaEvent()) {
-                    info.bpm = 60.0 / msg.getTempoSecondsPerQuarterNote();
-                    break;
-                }
-            }
+    // Files seen before come from the note cache; the rest are parsed once
+    // with the Core parser (plain paths and zip entries alike) and cached
+    auto& cached = cachedNotes;
+    const std::string path = info.fullPath.toStdString();
+    const juce::int64 modifiedTime = midiFileModifiedTime(info.fullPath);
+    if (!noteCache.load(path, modifiedTime, cached)) {
+        auto& midiFile = analysisFile;
+        if (!parseForAnalysis(path, midiFile)) {
+            info.analyzed = true;  // Mark as analyzed to avoid retrying
+            return;
         }
-    }
 
-    // Calculate duration
-    midiFile.convertTimestampTicksToSeconds();
-    double maxTime = 0.0;
-    for (int track = 0; track < midiFile.getNumTracks(); track++) {
-        auto* sequence = midiFile.getTrack(track);
-        if (sequence) {
-            for (int i = 0; i < sequence->getNumEvents(); i++) {
-                auto* event = sequence->getEventPointer(i);
-                double eventTime = event->message.getTimeStamp();
-                if (eventTime > maxTime) maxTime = eventTime;
-                // For note-on, also check note-off time
-                if (event->message.isNoteOn() && event->noteOffObject) {
-                    double offTime = event->noteOffObject->message.getTimeStamp();
-                    if (offTime > maxTime) maxTime = offTime;
-                }
-            }
-        }
+        // Zip entries report their inflated size
+        cached.assign(midiFile, modifiedTime, static_cast<int64_t>(midiFile.source->size()));
+    } else {
+        cached.restore(analysisFile);
     }
 
-    // Round duration to nearest bar (4 beats) for clean looping
-    double bpm = info.bpm > 0 ? info.bpm : 120.0;
-    double beatsPerSecond = bpm / 60.0;
-    double totalBeats = maxTime * beatsPerSecond;
-    double bars = std::ceil(totalBeats / 4.0);  // Round up to nearest bar
-    if (bars < 1.0) bars = 1.0;
-    double roundedBeats = bars * 4.0;
-    info.duration = roundedBeats / beatsPerSecond;
-    info.durationBeats = roundedBeats;
-
-    // Chord detection: analyze simultaneous notes (timestamps are now in seconds)
-    // A chord is 2+ notes starting within a small time window (20ms)
-    const double chordTimeWindow = 0.020;  // 20ms window for chord detection
-    std::vector<std::pair<double, int>> noteEvents;  // timestamp, noteNumber
-
-    for (int track = 0; track < midiFile.getNumTracks(); track++) {
-        auto* sequence = midiFile.getTrack(track);
-        if (sequence) {
-            for (int i = 0; i < sequence->getNumEvents(); i++) {
-                auto& msg = sequence->getEventPointer(i)->message;
-                if (msg.isNoteOn() && msg.getVelocity() > 0) {
-                    noteEvents.push_back({msg.getTimeStamp(), msg.getNoteNumber()});
-                }
-            }
-        }
-    }
+    info.fileSize = static_cast<juce::int64>(cached.fileSize);
 
-    std::cerr << "[ANALYSIS DEBUG] File: " << info.fileName << " noteEvents.size()=" << noteEvents.size() << std::endl;
-    for (const auto& ev : noteEvents) {
-        std::cerr << "  timestamp=" << ev.first << " noteNumber=" << ev.second << std::endl;
+    // One Core call gives the key, texture, tempo, program and mood, with
+    // the same detector settings as the FileScanner. A cached analysis is
+    // reused; otherwise the new one is stored with the notes.
+    auto& summary = analysisSummary;
+    if (cached.hasAnalysis) {
+        analysisDetector.summarize(analysisFile, cached.duration, cached.analysis, analysisContext, summary);
+    } else {
+        analysisDetector.summarize(analysisFile, cached.duration, analysisContext, summary);
+        cached.analysis = summary.analysis;
+        cached.hasAnalysis = true;
+        noteCache.store(cached);
     }
 
-    if (!noteEvents.empty()) {
-        // Sort by timestamp
-        std::sort(noteEvents.begin(), noteEvents.end(),
-            [](const auto& a, const auto& b) { return a.first < b.first; });
-
-        std::cerr << "[CHORD DEBUG] File: " << info.fileName << " has " << noteEvents.size() << " note events" << std::endl;
-
-        int chordCount = 0;
-        int singleNoteCount = 0;
-        size_t i = 0;
-
-        while (i < noteEvents.size()) {
-            // Count notes within the time window
-            double windowStart = noteEvents[i].first;
-            size_t j = i;
-            std::set<int> simultaneousNotes;  // Use set to avoid duplicate pitches
-
-            while (j < noteEvents.size() && noteEvents[j].first - windowStart <= chordTimeWindow) {
-                simultaneousNotes.insert(noteEvents[j].second);
-                j++;
-            }
+    // Release the file; the parsed storage is kept for the next analysis
+    analysisFile.releaseSource();
 
-            if (simultaneousNotes.size() >= 2) {
-                chordCount++;  // 2+ notes = chord (interval or chord)
-            } else {
-                singleNoteCount++;  // Single notes = melodic content
-            }
+    static const char* const noteNames[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    const auto& scale = summary.analysis.primaryScale;
 
-            // Move to next group
-            i = j;
+    if (scale.type == MIDIScaleDetector::ScaleType::Unknown) {
+        info.key = "---";
+        info.relativeKey = "";
+    } else {
+        // Modes show which degree of their parent major they start on
+        juce::String modeInfo;
+        switch (scale.type) {
+            case MIDIScaleDetector::ScaleType::Dorian:     modeInfo = " (Maj 2nd)"; break;
+            case MIDIScaleDetector::ScaleType::Phrygian:   modeInfo = " (Maj 3rd)"; break;
+            case MIDIScaleDetector::ScaleType::Lydian:     modeInfo = " (Maj 4th)"; break;
+            case MIDIScaleDetector::ScaleType::Mixolydian: modeInfo = " (Maj 5th)"; break;
+            case MIDIScaleDetector::ScaleType::Aeolian:    modeInfo = " (Maj 6th)"; break;
+            case MIDIScaleDetector::ScaleType::Locrian:    modeInfo = " (Maj 7th)"; break;
+            default: break;
         }
+        const auto scaleName = MIDIScaleDetector::scaleTypeName(scale.type);
+        info.key = juce::String(noteNames[static_cast<int>(scale.root)]) + " "
+                 + juce::String(scaleName.data(), scaleName.size()) + modeInfo;
 
-        std::cerr << "[CHORD DEBUG] chordCount=" << chordCount << " singleNoteCount=" << singleNoteCount << std::endl;
-
-        // Consider it a chord file if it has at least 1 chord event
-        info.containsChords = (chordCount >= 1);
-        // Consider it a single-note file if it has any single notes (melodic content)
-        info.containsSingleNotes = (singleNoteCount >= 1);
-
-        std::cerr << "[CHORD DEBUG] containsChords=" << info.containsChords << " containsSingleNotes=" << info.containsSingleNotes << std::endl;
-
-        // Debug output
-        std::cerr << "[ChordDetect] " << info.fileName << ": events=" << noteEvents.size()
-                  << " chords=" << chordCount << " singles=" << singleNoteCount
-                  << " containsChords=" << info.containsChords
-                  << " containsSingleNotes=" << info.containsSingleNotes << std::endl;
+        // Format: "Parent Maj / Rel m" e.g., "G/Em"
+        info.relativeKey = juce::String(noteNames[static_cast<int>(summary.parentMajor)]) + "/"
+                         + juce::String(noteNames[static_cast<int>(summary.relativeMinor)]) + "m";
     }
 
-    // Extract instrument from first program change
-    static const char* gmInstruments[] = {
-        "Acoustic Grand Piano", "Bright Acoustic Piano", "Electric Grand Piano", "Honky-tonk Piano",
-        "Electric Piano 1", "Electric Piano 2", "Harpsichord", "Clavinet",
-        "Celesta", "Glockenspiel", "Music Box", "Vibraphone",
-        "Marimba", "Xylophone", "Tubular Bells", "Dulcimer",
-        "Drawbar Organ", "Percussive Organ", "Rock Organ", "Church Organ",
-        "Reed Organ", "Accordion", "Harmonica", "Tango Accordion",
-        "Acoustic Guitar (nylon)", "Acoustic Guitar (steel)", "Electric Guitar (jazz)", "Electric Guitar (clean)",
-        "Electric Guitar (muted)", "Overdriven Guitar", "Distortion Guitar", "Guitar Harmonics",
-        "Acoustic Bass", "Electric Bass (finger)", "Electric Bass (pick)", "Fretless Bass",
-        "Slap Bass 1", "Slap Bass 2", "Synth Bass 1", "Synth Bass 2",
-        "Violin", "Viola", "Cello", "Contrabass",
-        "Tremolo Strings", "Pizzicato Strings", "Orchestral Harp", "Timpani",
-        "String Ensemble 1", "String Ensemble 2", "Synth Strings 1", "Synth Strings 2",
-        "Choir Aahs", "Voice Oohs", "Synth Voice", "Orchestra Hit",
-        "Trumpet", "Trombone", "Tuba", "Muted Trumpet",
-        "French Horn", "Brass Section", "Synth Brass 1", "Synth Brass 2",
-        "Soprano Sax", "Alto Sax", "Tenor Sax", "Baritone Sax",
-        "Oboe", "English Horn", "Bassoon", "Clarinet",
-        "Piccolo", "Flute", "Recorder", "Pan Flute",
-        "Blown Bottle", "Shakuhachi", "Whistle", "Ocarina",
-        "Lead 1 (square)", "Lead 2 (sawtooth)", "Lead 3 (calliope)", "Lead 4 (chiff)",
-        "Lead 5 (charang)", "Lead 6 (voice)", "Lead 7 (fifths)", "Lead 8 (bass + lead)",
-        "Pad 1 (new age)", "Pad 2 (warm)", "Pad 3 (polysynth)", "Pad 4 (choir)",
-        "Pad 5 (bowed)", "Pad 6 (metallic)", "Pad 7 (halo)", "Pad 8 (sweep)",
-        "FX 1 (rain)", "FX 2 (soundtrack)", "FX 3 (crystal)", "FX 4 (atmosphere)",
-        "FX 5 (brightness)", "FX 6 (goblins)", "FX 7 (echoes)", "FX 8 (sci-fi)",
-        "Sitar", "Banjo", "Shamisen", "Koto",
-        "Kalimba", "Bagpipe", "Fiddle", "Shanai",
-        "Tinkle Bell", "Agogo", "Steel Drums", "Woodblock",
-        "Taiko Drum", "Melodic Tom", "Synth Drum", "Reverse Cymbal",
-        "Guitar Fret Noise", "Breath Noise", "Seashore", "Bird Tweet",
-        "Telephone Ring", "Helicopter", "Applause", "Gunshot"
-    };
+    // Tempo at the start of the file (120 BPM when none is declared)
+    info.bpm = summary.tempo;
 
-    info.instrument = "---";
-    for (int track = 0; track < midiFile.getNumTracks(); track++) {
-        auto* trackSeq = midiFile.getTrack(track);
-        if (trackSeq) {
-            for (int i = 0; i < trackSeq->getNumEvents(); i++) {
-                auto& msg = trackSeq->getEventPointer(i)->message;
-                if (msg.isProgramChange()) {
-                    int program = msg.getProgramChangeNumber();
-                    if (program >= 0 && program < 128) {
-                        info.instrument = gmInstruments[program];
-                    }
-                    break;
-                }
-            }
-        }
-        if (info.instrument != "---") break;
-    }
-
-    // Detect mood based on key/scale, tempo, and velocity
-    juce::String detectedMood = "Neutral";
-    juce::String keyString = info.key;
-
-    // Extract scale characteristics
-    bool isMajor = keyString.contains("Major") || keyString.contains("Lydian") || keyString.contains("Mixolydian");
-    bool isMinor = keyString.contains("Minor") || keyString.contains("Phrygian") || keyString.contains("Locrian") ||
-                   keyString.contains("Harmonic") || keyString.contains("Melodic");
-    bool isDorian = keyString.contains("Dorian");
-    bool isBlues = keyString.contains("Blues");
-    bool isPentatonic = keyString.contains("Pentatonic");
-    bool isLydian = keyString.contains("Lydian");
-    bool isPhrygian = keyString.contains("Phrygian");
-
-    // Enhanced mood classification based on scale, tempo, and other factors
-    double tempo = info.bpm;
-    bool isSlow = tempo < 80;
-    bool isMedium = tempo >= 80 && tempo < 120;
-    bool isFast = tempo >= 120;
-
-    if (isMajor) {
-        if (isFast) {
-            detectedMood = "Joyful";
-        } else if (isSlow) {
-            detectedMood = "Peaceful";
-        } else {
-            detectedMood = "Happy";
-        }
-    } else if (isMinor) {
-        if (isFast) {
-            detectedMood = "Intense";
-        } else if (isSlow) {
-            detectedMood = "Melancholic";
-        } else {
-            detectedMood = "Emotional";
-        }
-    } else if (isDorian) {
-        if (isFast) {
-            detectedMood = "Funky";
-        } else {
-            detectedMood = "Soulful";
-        }
-    } else if (isBlues) {
-        if (isSlow) {
-            detectedMood = "Sorrowful";
-        } else {
-            detectedMood = "Bluesy";
-        }
-    } else if (isLydian) {
-        detectedMood = "Dreamy";
-    } else if (isPhrygian) {
-        detectedMood = "Exotic";
-    } else if (isPentatonic) {
-        detectedMood = "Ethereal";
-    } else {
-        detectedMood = "Mysterious";
-    }
+    // Round duration to nearest bar (4 beats) for clean looping
+    double bpm = info.bpm > 0 ? info.bpm : 120.0;
+    info.durationBeats = roundBeatsToBars(summary.duration, bpm);
+    info.duration = info.durationBeats * 60.0 / bpm;
 
-    info.mood = detectedMood;
+    info.containsChords = summary.containsChords;
+    info.containsSingleNotes = summary.containsSingleNotes;
+    info.instrument = getGMInstrumentName(summary.program);
+    info.mood = MIDIScaleDetector::moodName(summary.mood);
 
     info.analyzed = true;
 }
@@ -6,6 +6,10 @@
 #include <juce_gui_basics/juce_gui_basics.h>
 #include <juce_gui_extra/juce_gui_extra.h>
 #include <juce_audio_formats/juce_audio_formats.h>
+#include "../Core/MIDIParser/MIDIParser.h"
+#include "../Core/MIDIParser/ZipArchive.h"
+#include "../Core/Database/NoteCache.h"
+#include "../Core/ScaleDetector/ScaleDetector.h"
 #include "../Standalone/LicenseManager.h"
 #include "../Version.h"
 
@@ -337,6 +341,10 @@ private:
             cacheDir.deleteRecursively();
         }
 
+        // Per-file note cache (.mxn sidecars)
+        juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
+            .getChildFile("MIDIXplorer").getChildFile("notecache").deleteRecursively();
+
         // Also clear the analysis cache file
         auto analysisCache = juce::File::getSpecialLocation(juce::File::userApplicationDataDirectory)
                                  .getChildFile("MIDI Xplorer").getChildFile("analysis_cache.json");
@@ -747,6 +755,14 @@ private:
     size_t analysisIndex = 0;
     int analysisSaveCounter = 0;  // Counter for periodic cache saving
     static constexpr int FILES_PER_TICK = 5;  // Analyze 5 files per timer tick
+    MIDIScaleDetector::MIDIParser analysisParser;  // Same Core parser as the FileScanner
+    MIDIScaleDetector::MIDIFile analysisFile;      // Reused so event storage is recycled
+    MIDIScaleDetector::NoteCache noteCache;         // .mxn sidecars: re-analysis skips the decode
+    MIDIScaleDetector::NoteCacheEntry cachedNotes;
+    MIDIScaleDetector::ZipArchive analysisArchive;  // Last pack analyzed from, kept open
+    MIDIScaleDetector::ScaleDetector analysisDetector;
+    MIDIScaleDetector::AnalysisContext analysisContext;
+    MIDIScaleDetector::FileSummary analysisSummary;
     int spinnerFrame = 0;  // Animation frame for loading spinners
 
     // Background file scanning
@@ -754,6 +770,10 @@ private:
     std::unique_ptr<juce::DirectoryIterator> currentDirIterator;
     size_t currentScanLibraryIndex = 0;
     bool isScanningFiles = false;
+    MIDIScaleDetector::ZipArchive scanArchive;  // Pack whose entries are being added
+    size_t scanArchiveEntry = 0;                // Next entry of scanArchive
+    MIDIScaleDetector::MIDIParser scanParser;   // Header probes while scanning
+    std::vector<uint8_t> scanBuffer;            // Inflated pack entry being probed
 
     juce::MidiFile currentMidiFile;
     juce::MidiMessageSequence playbackSequence;
@@ -780,6 +800,9 @@ private:
     void scanLibraries();
     void scanLibrary(size_t index);
     void refreshLibrary(size_t index);
+    void addScannedFile(const juce::String& fullPath, juce::int64 fileSize,
+                        const MIDIScaleDetector::MIDIProbe* probe);
+    bool parseForAnalysis(const std::string& path, MIDIScaleDetector::MIDIFile& midiFile);
     void analyzeFile(size_t index);
     void filterFiles();
     void sortFiles();
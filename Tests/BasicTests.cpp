@@ -1,11 +1,235 @@
-#include <cassert>
 #include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <initializer_list>
+#include <cmath>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <zlib.h>
 #include "../Source/Core/MIDIParser/MIDIParser.h"
+#include "../Source/Core/MIDIParser/MergedEventCursor.h"
+#include "../Source/Core/MIDIParser/MIDIWriter.h"
+#include "../Source/Core/MIDIParser/StreamingParser.h"
+#include "../Source/Core/MIDIParser/ZipArchive.h"
 #include "../Source/Core/ScaleDetector/ScaleDetector.h"
+#include "../Source/Core/ScaleDetector/ScaleScoring.h"
+#include "../Source/Core/ScaleDetector/PitchClassTimeline.h"
+#include "../Source/Core/ScaleDetector/ChordDetector.h"
+#include "../Source/Core/ScaleDetector/StreamingKeyDetector.h"
 #include "../Source/Core/Database/Database.h"
+#include "../Source/Core/Database/NoteCache.h"
+#include "../Source/Core/FileScanner/FileScanner.h"
 
 using namespace MIDIScaleDetector;
 
+// Like assert(), but evaluated in every build type: the tests run from
+// Release builds, and many checks wrap the call under test
+#define CHECK(condition)                                                              \
+    do {                                                                              \
+        if (!(condition)) {                                                           \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #condition \
+                      << std::endl;                                                   \
+            std::exit(1);                                                             \
+        }                                                                             \
+    } while (false)
+
+// Counts heap allocations so tests can check that hot paths make none.
+// Every replaceable form is routed to malloc/free so they stay paired.
+static std::atomic<size_t> allocationCount{0};
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void* operator new(size_t size) {
+    if (void* block = operator new(size, std::nothrow)) {
+        return block;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return operator new(size, std::nothrow);
+}
+
+// Out of line so the compiler doesn't pair free() with new at call sites
+__attribute__((noinline)) void operator delete(void* block) noexcept {
+    std::free(block);
+}
+
+void operator delete(void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete(void* block, const std::nothrow_t&) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, size_t) noexcept {
+    operator delete(block);
+}
+
+void operator delete[](void* block, const std::nothrow_t&) noexcept {
+    operator delete(block);
+}
+
+// Builds a single MTrk chunk in memory for parser tests
+struct TestTrack {
+    std::vector<uint8_t> bytes;
+    uint32_t endDelta = 0;     // Rest before End of Track
+
+    TestTrack& delta(uint32_t ticks) {
+        uint8_t buffer[4];
+        int count = 0;
+        buffer[count++] = ticks & 0x7F;
+        while ((ticks >>= 7) > 0) {
+            buffer[count++] = 0x80 | (ticks & 0x7F);
+        }
+        while (count > 0) {
+            bytes.push_back(buffer[--count]);
+        }
+        return *this;
+    }
+
+    TestTrack& event(uint32_t ticks, std::initializer_list<uint8_t> data) {
+        delta(ticks);
+        bytes.insert(bytes.end(), data.begin(), data.end());
+        return *this;
+    }
+
+    TestTrack& meta(uint32_t ticks, uint8_t type, const std::string& payload) {
+        event(ticks, {0xFF, type});
+        delta(static_cast<uint32_t>(payload.size()));
+        bytes.insert(bytes.end(), payload.begin(), payload.end());
+        return *this;
+    }
+
+    TestTrack& tempo(uint32_t ticks, uint32_t microsecondsPerQuarter) {
+        return event(ticks, {0xFF, 0x51, 0x03,
+                             static_cast<uint8_t>(microsecondsPerQuarter >> 16),
+                             static_cast<uint8_t>(microsecondsPerQuarter >> 8),
+                             static_cast<uint8_t>(microsecondsPerQuarter)});
+    }
+
+    TestTrack& note(uint32_t ticks, uint8_t note, uint32_t length, uint8_t velocity = 100) {
+        event(ticks, {0x90, note, velocity});
+        return event(length, {0x80, note, 0});
+    }
+
+    TestTrack& rest(uint32_t ticks) {
+        endDelta += ticks;
+        return *this;
+    }
+};
+
+// Wraps tracks into a complete Standard MIDI File
+std::vector<uint8_t> buildTestMIDI(uint16_t format, uint16_t division,
+                                   const std::vector<TestTrack>& tracks) {
+    std::vector<uint8_t> data = {'M', 'T', 'h', 'd', 0, 0, 0, 6,
+                                 0, static_cast<uint8_t>(format),
+                                 static_cast<uint8_t>(tracks.size() >> 8),
+                                 static_cast<uint8_t>(tracks.size()),
+                                 static_cast<uint8_t>(division >> 8),
+                                 static_cast<uint8_t>(division)};
+
+    for (auto track : tracks) {
+        track.event(track.endDelta, {0xFF, 0x2F, 0x00});
+        uint32_t length = static_cast<uint32_t>(track.bytes.size());
+        data.insert(data.end(), {'M', 'T', 'r', 'k',
+                                 static_cast<uint8_t>(length >> 24),
+                                 static_cast<uint8_t>(length >> 16),
+                                 static_cast<uint8_t>(length >> 8),
+                                 static_cast<uint8_t>(length)});
+        data.insert(data.end(), track.bytes.begin(), track.bytes.end());
+    }
+
+    return data;
+}
+
+std::string writeTestFile(const std::string& name, const std::vector<uint8_t>& data) {
+    auto path = (std::filesystem::temp_directory_path() / name).string();
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    return path;
+}
+
+// Minimal zip writer: stored or raw-deflated entries plus a central directory
+struct TestZipEntry {
+    std::string name;
+    std::vector<uint8_t> data;
+    bool deflate;
+};
+
+std::vector<uint8_t> buildTestZip(const std::vector<TestZipEntry>& entries) {
+    std::vector<uint8_t> zip;
+    std::vector<uint8_t> directory;
+    auto put16 = [](std::vector<uint8_t>& out, uint32_t v) {
+        out.push_back(v & 0xFF);
+        out.push_back((v >> 8) & 0xFF);
+    };
+    auto put32 = [&](std::vector<uint8_t>& out, uint32_t v) {
+        put16(out, v & 0xFFFF);
+        put16(out, v >> 16);
+    };
+
+    for (const auto& entry : entries) {
+        std::vector<uint8_t> payload = entry.data;
+        if (entry.deflate) {
+            z_stream stream = {};
+            deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            payload.resize(deflateBound(&stream, entry.data.size()));
+            stream.next_in = const_cast<Bytef*>(entry.data.data());
+            stream.avail_in = static_cast<uInt>(entry.data.size());
+            stream.next_out = payload.data();
+            stream.avail_out = static_cast<uInt>(payload.size());
+            deflate(&stream, Z_FINISH);
+            payload.resize(stream.total_out);
+            deflateEnd(&stream);
+        }
+        uint32_t crc = static_cast<uint32_t>(crc32(0L, entry.data.data(), static_cast<uInt>(entry.data.size())));
+        uint32_t localOffset = static_cast<uint32_t>(zip.size());
+        uint16_t method = entry.deflate ? 8 : 0;
+
+        put32(zip, 0x04034b50);
+        put16(zip, 20); put16(zip, 0); put16(zip, method); put16(zip, 0); put16(zip, 0);
+        put32(zip, crc); put32(zip, static_cast<uint32_t>(payload.size()));
+        put32(zip, static_cast<uint32_t>(entry.data.size()));
+        put16(zip, static_cast<uint32_t>(entry.name.size())); put16(zip, 0);
+        zip.insert(zip.end(), entry.name.begin(), entry.name.end());
+        zip.insert(zip.end(), payload.begin(), payload.end());
+
+        put32(directory, 0x02014b50);
+        put16(directory, 20); put16(directory, 20); put16(directory, 0); put16(directory, method);
+        put16(directory, 0); put16(directory, 0);
+        put32(directory, crc); put32(directory, static_cast<uint32_t>(payload.size()));
+        put32(directory, static_cast<uint32_t>(entry.data.size()));
+        put16(directory, static_cast<uint32_t>(entry.name.size()));
+        put16(directory, 0); put16(directory, 0); put16(directory, 0); put16(directory, 0);
+        put32(directory, 0); put32(directory, localOffset);
+        directory.insert(directory.end(), entry.name.begin(), entry.name.end());
+    }
+
+    uint32_t directoryOffset = static_cast<uint32_t>(zip.size());
+    zip.insert(zip.end(), directory.begin(), directory.end());
+    put32(zip, 0x06054b50);
+    put16(zip, 0); put16(zip, 0);
+    put16(zip, static_cast<uint32_t>(entries.size())); put16(zip, static_cast<uint32_t>(entries.size()));
+    put32(zip, static_cast<uint32_t>(directory.size())); put32(zip, directoryOffset);
+    put16(zip, 0);
+    return zip;
+}
+
 void testMIDIParser() {
     std::cout << "Testing MIDI Parser..." << std::endl;
 
@@ -18,6 +242,922 @@ void testMIDIParser() {
     std::cout << "  ✓ MIDI Parser initialized" << std::endl;
 }
 
+void testMappedParse() {
+    std::cout << "Testing Zero-Copy Parsing..." << std::endl;
+
+    TestTrack track;
+    track.meta(0, 0x03, "Piano").note(0, 60, 480).note(0, 64, 480);
+    auto data = buildTestMIDI(0, 480, {track});
+
+    // Caller-supplied buffer: views point straight into it
+    MIDIParser parser;
+    MIDIFile fromBuffer;
+    CHECK(parser.parse(data.data(), data.size(), fromBuffer));
+    CHECK(fromBuffer.tracks.size() == 1);
+    CHECK(fromBuffer.tracks[0].name == "Piano");
+    CHECK(reinterpret_cast<const uint8_t*>(fromBuffer.tracks[0].name.data()) >= data.data());
+    CHECK(reinterpret_cast<const uint8_t*>(fromBuffer.tracks[0].name.data()) < data.data() + data.size());
+    CHECK(fromBuffer.source == nullptr);
+
+    std::cout << "  ✓ Buffer parse keeps names as views" << std::endl;
+
+    // File on disk: the mapping is owned by the MIDIFile and outlives the parser
+    auto path = writeTestFile("midixplorer_mapped.mid", data);
+    MIDIFile fromFile;
+    {
+        MIDIParser fileParser;
+        CHECK(fileParser.parse(path, fromFile));
+    }
+    CHECK(fromFile.source != nullptr);
+    CHECK(fromFile.source->size() == data.size());
+    CHECK(fromFile.tracks[0].name == "Piano");
+    CHECK(fromFile.tracks[0].metaEvents.size() == 1);
+    CHECK(fromFile.tracks[0].events.size() == 4);
+
+    // Copies share the mapping, so views stay valid
+    MIDIFile copy = fromFile;
+    fromFile = MIDIFile();
+    CHECK(copy.tracks[0].name == "Piano");
+
+    std::filesystem::remove(path);
+
+    // Missing files report an error instead of throwing
+    MIDIFile missing;
+    CHECK(!parser.parse(std::string("/nonexistent/missing.mid"), missing));
+    CHECK(!parser.getLastError().empty());
+
+    std::cout << "  ✓ Mapped file owned by MIDIFile" << std::endl;
+}
+
+void testTempoMap() {
+    std::cout << "Testing Tempo Map..." << std::endl;
+
+    // Format 1: conductor track changes tempo, notes live in track 1
+    TestTrack conductor;
+    conductor.tempo(0, 500000).tempo(480, 250000);
+    TestTrack notes;
+    notes.note(960, 60, 480);
+    auto data = buildTestMIDI(1, 480, {conductor, notes});
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.tempo == 120.0);
+    CHECK(midiFile.tempoMap.changes.size() == 2);
+
+    // 480 ticks at 120 BPM + 480 ticks at 240 BPM
+    const auto& noteOn = midiFile.tracks[1].events[0];
+    CHECK(std::abs(noteOn.timestamp - 0.75) < 1e-9);
+    CHECK(std::abs(midiFile.tempoMap.ticksToSeconds(1440) - 1.0) < 1e-9);
+    CHECK(std::abs(midiFile.getDuration() - 1.0) < 1e-9);
+
+    std::cout << "  ✓ Conductor tempo applied to all tracks" << std::endl;
+
+    // Non-integer tempo is not truncated
+    TestTrack exact;
+    exact.tempo(0, 600000).note(0, 60, 480);
+    data = buildTestMIDI(0, 480, {exact});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(std::abs(midiFile.tempo - 100.0) < 1e-9);
+
+    // SMPTE: 25 fps x 40 ticks per frame = 1000 ticks per second
+    TestTrack smpte;
+    smpte.tempo(0, 250000).note(500, 60, 250);
+    data = buildTestMIDI(0, static_cast<uint16_t>((0xE7 << 8) | 40), {smpte});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.header.isSMPTE());
+    CHECK(std::abs(midiFile.tracks[0].events[0].timestamp - 0.5) < 1e-9);
+    CHECK(std::abs(midiFile.tracks[0].events[1].timestamp - 0.75) < 1e-9);
+
+    std::cout << "  ✓ Exact BPM and SMPTE timing" << std::endl;
+}
+
+void testNoteTable() {
+    std::cout << "Testing Note Table..." << std::endl;
+
+    // Two tracks whose notes interleave, a retriggered note and one never released
+    TestTrack melody;
+    melody.note(0, 64, 480, 90).note(480, 67, 480);
+    TestTrack bass;
+    bass.event(240, {0x91, 48, 80})
+        .event(240, {0x91, 48, 70})   // Retrigger closes the first note
+        .event(480, {0x81, 48, 0})
+        .event(0, {0x91, 36, 60});    // Never released
+    auto data = buildTestMIDI(1, 480, {melody, bass});
+
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    const NoteTable& notes = midiFile.notes;
+    CHECK(notes.size() == 5);
+    for (size_t i = 1; i < notes.size(); ++i) {
+        CHECK(notes.startTick[i - 1] <= notes.startTick[i]);
+    }
+    CHECK(notes.pitch[0] == 64 && notes.velocity[0] == 90 && notes.endTick[0] == 480);
+    CHECK(notes.pitch[1] == 48 && notes.channel[1] == 1 && notes.endTick[1] == 480);
+    CHECK(notes.pitch[2] == 48 && notes.startTick[2] == 480 && notes.endTick[2] == 960);
+    CHECK(notes.pitch[4] == 36 && notes.endTick[4] == 960);
+    CHECK(notes.pitch[3] == 67 && std::abs(notes.endTime[3] - 1.5) < 1e-9);
+    CHECK(notes.lowerBound(0.5) == 2);
+
+    std::cout << "  ✓ Notes paired across tracks and sorted by start" << std::endl;
+
+    // Analysis gives the same result with or without a prebuilt table
+    ScaleDetector detector;
+    HarmonicAnalysis withTable = detector.analyze(midiFile);
+    midiFile.notes.clear();
+    HarmonicAnalysis withoutTable = detector.analyze(midiFile);
+    CHECK(withTable.totalNotes == 5);
+    CHECK(withoutTable.totalNotes == 5);
+    CHECK(withTable.primaryScale.root == withoutTable.primaryScale.root);
+    CHECK(withTable.primaryScale.type == withoutTable.primaryScale.type);
+    CHECK(std::abs(withTable.averagePitch - (64 + 48 + 48 + 67 + 36) / 5.0) < 1e-9);
+
+    std::cout << "  ✓ Scale detection runs over the table" << std::endl;
+}
+
+void testProbe() {
+    std::cout << "Testing Metadata Probe..." << std::endl;
+
+    TestTrack conductor;
+    conductor.meta(0, 0x03, {'S', 'o', 'n', 'g'})
+             .meta(0, 0x58, {3, 2, 24, 8})
+             .tempo(0, 600000);
+    TestTrack lead;
+    lead.meta(0, 0x03, {'L', 'e', 'a', 'd'})
+        .event(0, {0xC0, 33})
+        .note(0, 60, 480)
+        .note(0, 64, 960)
+        .event(0, {0x90, 67, 0});  // Velocity 0 is a note-off
+    auto data = buildTestMIDI(1, 480, {conductor, lead});
+
+    MIDIParser parser;
+    MIDIProbe probe;
+    CHECK(parser.probe(data.data(), data.size(), probe));
+    CHECK(probe.header.trackCount == 2);
+    CHECK(std::abs(probe.tempo - 100.0) < 1e-9);
+    CHECK(probe.timeSignatureNumerator == 3);
+    CHECK(probe.timeSignatureDenominator == 4);
+    CHECK(probe.firstProgram == 33);
+    CHECK(probe.trackNames.size() == 2);
+    CHECK(probe.trackNames[0] == "Song" && probe.trackNames[1] == "Lead");
+    CHECK(probe.noteCount == 2);
+
+    std::cout << "  ✓ Header, tempo, time signature and program" << std::endl;
+
+    // Duration agrees with a full parse
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(std::abs(probe.duration - midiFile.getDuration()) < 1e-9);
+
+    std::string path = writeTestFile("probe_test.mid", data);
+    MIDIProbe fromDisk;
+    CHECK(parser.probe(path, fromDisk));
+    CHECK(fromDisk.noteCount == probe.noteCount);
+    std::filesystem::remove(path);
+
+    // Truncated header is rejected
+    CHECK(!parser.probe(data.data(), 10, probe));
+
+    std::cout << "  ✓ Duration matches full parse" << std::endl;
+
+    // A deferred scan stores probe info; analyzePending() fills in the key,
+    // also after an earlier stopScan()
+    auto directory = std::filesystem::temp_directory_path() / "probe_deferred";
+    std::filesystem::create_directories(directory);
+    std::string deferredPath = writeTestFile("probe_deferred/deferred.mid", data);
+
+    Database db;
+    CHECK(db.initialize(":memory:"));
+    FileScanner scanner(db);
+    ScannerConfig config;
+    config.searchPaths = {directory.string()};
+    config.deferAnalysis = true;
+    CHECK(scanner.startScan(config));
+    CHECK(db.getUnanalyzedFiles().size() == 1);
+
+    scanner.stopScan();
+    CHECK(scanner.analyzePending());
+    CHECK(db.getUnanalyzedFiles().empty());
+    CHECK(db.getFile(deferredPath).totalNotes == 2);
+    CHECK(!scanner.isScanning());
+    std::filesystem::remove_all(directory);
+
+    std::cout << "  ✓ Deferred analysis runs after a stopped scan" << std::endl;
+}
+
+void testParseOptions() {
+    std::cout << "Testing Parse Options..." << std::endl;
+
+    TestTrack track;
+    track.meta(0, 0x03, "Keys")
+         .meta(0, 0x01, "text")
+         .event(0, {0xC0, 5})
+         .event(0, {0xB0, 64, 127})
+         .note(0, 60, 480)
+         .event(0, {0xB0, 64, 0});
+    auto data = buildTestMIDI(0, 480, {track});
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    const auto& all = midiFile.tracks[0].events;
+    CHECK(all.size() == 5);
+    CHECK(all[0].type == EventType::ProgramChange && all[0].program() == 5);
+    CHECK(all[1].type == EventType::ControlChange);
+    CHECK(all[1].controller() == 64 && all[1].value() == 127);
+    CHECK(midiFile.tracks[0].metaEvents.size() == 2);
+
+    std::cout << "  ✓ Everything stored by default" << std::endl;
+
+    parser.setParseOptions(ParseNotesAndPrograms);
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.tracks[0].events.size() == 3);
+    CHECK(midiFile.tracks[0].metaEvents.empty());
+
+    parser.setParseOptions(ParseNotesOnly);
+    parser.setBuildNoteTable(true);
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.tracks[0].events.size() == 2);
+    CHECK(midiFile.tracks[0].name == "Keys");
+    CHECK(midiFile.notes.size() == 1);
+    CHECK(std::abs(midiFile.getDuration() - 0.5) < 1e-9);
+
+    std::cout << "  ✓ Filtered parses keep notes, names and timing" << std::endl;
+}
+
+void testParseBatch() {
+    std::cout << "Testing Batch Parsing..." << std::endl;
+
+    TestTrack large;
+    for (int i = 0; i < 64; ++i) {
+        large.note(0, static_cast<uint8_t>(36 + i), 120);
+    }
+    TestTrack small;
+    small.note(0, 60, 480);
+
+    std::vector<std::string> paths = {
+        writeTestFile("batch_large.mid", buildTestMIDI(0, 480, {large})),
+        writeTestFile("batch_missing.mid", {}),
+        writeTestFile("batch_small.mid", buildTestMIDI(0, 480, {small}))
+    };
+    std::filesystem::remove(paths[1]);
+
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    std::vector<size_t> noteCounts;
+    std::vector<bool> results;
+    size_t parsedCount = parser.parseBatch(paths, [&](size_t index, const MIDIFile& midiFile, bool parsed) {
+        CHECK(index == results.size());
+        results.push_back(parsed);
+        noteCounts.push_back(parsed ? midiFile.notes.size() : 0);
+        return true;
+    });
+
+    CHECK(parsedCount == 2);
+    CHECK(results.size() == 3);
+    CHECK(results[0] && !results[1] && results[2]);
+    CHECK(noteCounts[0] == 64 && noteCounts[2] == 1);
+
+    std::cout << "  ✓ Batch reports every file" << std::endl;
+
+    // Re-parsing into the same MIDIFile reuses event storage
+    MIDIFile midiFile;
+    CHECK(parser.parse(paths[0], midiFile));
+    const MIDIEvent* storage = midiFile.tracks[0].events.data();
+    CHECK(parser.parse(paths[2], midiFile));
+    CHECK(midiFile.tracks[0].events.data() == storage);
+    CHECK(midiFile.tracks[0].events.size() == 2);
+    CHECK(midiFile.notes.size() == 1);
+
+    // Returning false stops the batch
+    size_t calls = 0;
+    parser.parseBatch(paths, [&](size_t, const MIDIFile&, bool) {
+        calls++;
+        return false;
+    });
+    CHECK(calls == 1);
+
+    std::filesystem::remove(paths[0]);
+    std::filesystem::remove(paths[2]);
+
+    std::cout << "  ✓ Capacity recycled between files" << std::endl;
+}
+
+void testMergedCursor() {
+    std::cout << "Testing Merged Event Cursor..." << std::endl;
+
+    // Interleaved tracks: 0, 240, 480, ... alternate between them
+    TestTrack first;
+    first.event(0, {0xB0, 7, 100}).note(0, 60, 240).note(240, 62, 240);
+    TestTrack second;
+    second.note(240, 72, 240).note(240, 74, 240);
+    auto data = buildTestMIDI(1, 480, {first, second});
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    std::vector<uint32_t> ticks;
+    size_t eventCount = 0;
+    for (MergedEventCursor cursor(midiFile); !cursor.atEnd(); cursor.next()) {
+        ticks.push_back(cursor.current().tick);
+        eventCount++;
+    }
+    CHECK(eventCount == 9);
+    CHECK(std::is_sorted(ticks.begin(), ticks.end()));
+
+    auto noteEvents = midiFile.getAllNoteEvents();
+    CHECK(noteEvents.size() == 8);
+    CHECK(noteEvents[0].note == 60);
+    for (size_t i = 1; i < noteEvents.size(); ++i) {
+        CHECK(noteEvents[i - 1].tick <= noteEvents[i].tick);
+    }
+
+    std::cout << "  ✓ Tracks merged in time order" << std::endl;
+
+    // 480 ticks = 0.5s at 120 BPM
+    MergedEventCursor cursor(midiFile, true);
+    cursor.seek(0.5);
+    CHECK(!cursor.atEnd());
+    CHECK(cursor.current().tick == 480);
+
+    auto range = midiFile.getNoteEventsInRange(0.25, 0.5);
+    CHECK(range.size() == 4);
+    CHECK(range.front().tick == 240 && range.back().tick == 480);
+
+    cursor.seek(10.0);
+    CHECK(cursor.atEnd());
+    CHECK(!cursor.next());
+
+    std::cout << "  ✓ Seek and range queries" << std::endl;
+}
+
+void testContentHash() {
+    std::cout << "Testing Content Hash..." << std::endl;
+
+    // Reference XXH64 values (seed 0)
+    auto hashText = [](const std::string& text) {
+        return hashContent(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    };
+    CHECK(hashText("") == 0xEF46DB3751D8E999ULL);
+    CHECK(hashText("a") == 0xD24EC4F1A98C6E5BULL);
+    CHECK(hashText("abc") == 0x44BC2CF5AD770999ULL);
+    CHECK(hashText("Nobody inspects the spammish repetition") == 0xFBCEA83C8A378BF1ULL);
+
+    TestTrack track;
+    track.note(0, 60, 480).note(0, 64, 480);
+    auto data = buildTestMIDI(0, 480, {track});
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    MIDIProbe probe;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(parser.probe(data.data(), data.size(), probe));
+    CHECK(midiFile.contentHash == hashContent(data.data(), data.size()));
+    CHECK(probe.contentHash == midiFile.contentHash);
+
+    std::cout << "  ✓ XXH64 reference values" << std::endl;
+
+    // Identical copies share one analysis
+    std::string original = writeTestFile("hash_original.mid", data);
+    std::string copy = writeTestFile("hash_copy.mid", data);
+
+    Database db;
+    CHECK(db.initialize(":memory:"));
+    FileScanner scanner(db);
+    CHECK(scanner.scanFile(original));
+
+    MIDIFileEntry found;
+    CHECK(db.findByContentHash(midiFile.contentHash, found));
+    CHECK(found.filePath == original);
+
+    CHECK(scanner.scanFile(copy));
+    MIDIFileEntry first = db.getFile(original);
+    MIDIFileEntry second = db.getFile(copy);
+    CHECK(second.contentHash == first.contentHash);
+    CHECK(second.detectedKey == first.detectedKey);
+    CHECK(second.totalNotes == first.totalNotes);
+    CHECK(second.fileName == "hash_copy.mid");
+
+    std::filesystem::remove(original);
+    std::filesystem::remove(copy);
+
+    std::cout << "  ✓ Duplicate content reuses stored analysis" << std::endl;
+
+    // Databases from before content hashing gain the column on open
+    std::string dbPath = writeTestFile("legacy.db", {});
+    std::filesystem::remove(dbPath);
+    sqlite3* legacy = nullptr;
+    CHECK(sqlite3_open(dbPath.c_str(), &legacy) == SQLITE_OK);
+    CHECK(sqlite3_exec(legacy,
+        "CREATE TABLE midi_files (id INTEGER PRIMARY KEY AUTOINCREMENT, file_path TEXT UNIQUE NOT NULL, "
+        "file_name TEXT NOT NULL, file_size INTEGER, last_modified INTEGER, detected_key TEXT, "
+        "detected_scale TEXT, confidence REAL, tempo REAL, duration REAL, total_notes INTEGER, "
+        "average_pitch REAL, chord_progression TEXT, date_added INTEGER, date_analyzed INTEGER)",
+        nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(legacy);
+
+    Database migrated;
+    CHECK(migrated.initialize(dbPath));
+    MIDIFileEntry entry;
+    entry.filePath = "/legacy/file.mid";
+    entry.fileName = "file.mid";
+    entry.contentHash = 0x8000000000000001ULL;
+    entry.dateAnalyzed = 1;
+    CHECK(migrated.addFile(entry));
+    CHECK(migrated.findByContentHash(0x8000000000000001ULL, found));
+    CHECK(found.contentHash == 0x8000000000000001ULL);
+    migrated.close();
+    std::filesystem::remove(dbPath);
+
+    std::cout << "  ✓ Existing databases migrated" << std::endl;
+}
+
+void testMalformedInput() {
+    std::cout << "Testing Malformed Input..." << std::endl;
+
+    TestTrack track;
+    track.meta(0, 0x03, "Piano").tempo(0, 500000).note(0, 60, 480).note(0, 64, 480);
+    auto data = buildTestMIDI(0, 480, {track});
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    MIDIProbe probe;
+
+    // Every truncation is rejected cleanly, never read past the end
+    for (size_t length = 0; length < data.size(); ++length) {
+        std::vector<uint8_t> truncated(data.begin(), data.begin() + length);
+        CHECK(!parser.parse(truncated.data(), truncated.size(), midiFile));
+        CHECK(!parser.getLastError().empty());
+        CHECK(!parser.probe(truncated.data(), truncated.size(), probe));
+    }
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    std::cout << "  ✓ Truncated files rejected" << std::endl;
+
+    // Meta length pointing past the end of the track
+    TestTrack overlong;
+    overlong.event(0, {0xFF, 0x01, 0x7F, 'x'});
+    data = buildTestMIDI(0, 480, {overlong});
+    CHECK(!parser.parse(data.data(), data.size(), midiFile));
+
+    // Variable-length quantity longer than four bytes
+    TestTrack badLength;
+    badLength.bytes = {0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0x90, 60, 100};
+    data = buildTestMIDI(0, 480, {badLength});
+    CHECK(!parser.parse(data.data(), data.size(), midiFile));
+
+    // Unknown chunks between tracks are skipped
+    TestTrack valid;
+    valid.note(0, 60, 480);
+    data = buildTestMIDI(0, 480, {valid});
+    std::vector<uint8_t> alien = {'X', 'Y', 'Z', 'W', 0, 0, 0, 2, 0xAA, 0xBB};
+    data.insert(data.begin() + 14, alien.begin(), alien.end());
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.tracks[0].events.size() == 2);
+
+    // Meta events cancel running status
+    TestTrack running;
+    running.event(0, {0x90, 60, 100}).meta(0, 0x01, "x").event(0, {62, 100});
+    data = buildTestMIDI(0, 480, {running});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.tracks[0].events.size() == 1);
+
+    std::cout << "  ✓ Bad lengths rejected, alien chunks skipped" << std::endl;
+}
+
+void testParallelDecode() {
+    std::cout << "Testing Parallel Track Decode..." << std::endl;
+
+    // Conflicting tempo changes on one tick in different tracks: the later
+    // track must still win after tracks are decoded out of order
+    std::vector<TestTrack> tracks(8);
+    tracks[0].tempo(0, 500000).tempo(960, 400000);
+    tracks[3].tempo(960, 300000).event(0, {0xFF, 0x59, 0x02, 0x01, 0x00});
+    for (size_t t = 1; t < tracks.size(); ++t) {
+        tracks[t].meta(0, 0x03, "Track " + std::to_string(t));
+        for (int i = 0; i < 100 * static_cast<int>(t); ++i) {
+            tracks[t].note(i % 3 == 0 ? 0 : 60, static_cast<uint8_t>(40 + (i * t) % 48), 90);
+        }
+    }
+    auto data = buildTestMIDI(1, 480, tracks);
+
+    MIDIParser serial;
+    serial.setParallelThreshold(SIZE_MAX);
+    MIDIFile expected;
+    CHECK(serial.parse(data.data(), data.size(), expected));
+
+    MIDIParser parallel;
+    parallel.setParallelThreshold(0);
+    parallel.setMaxDecodeThreads(4);
+    MIDIFile midiFile;
+    for (int pass = 0; pass < 3; ++pass) {
+        CHECK(parallel.parse(data.data(), data.size(), midiFile));
+        CHECK(midiFile.tracks.size() == expected.tracks.size());
+        for (size_t t = 0; t < expected.tracks.size(); ++t) {
+            const auto& a = midiFile.tracks[t];
+            const auto& b = expected.tracks[t];
+            CHECK(a.name == b.name);
+            CHECK(a.events.size() == b.events.size());
+            CHECK(a.metaEvents.size() == b.metaEvents.size());
+            for (size_t i = 0; i < a.events.size(); ++i) {
+                CHECK(a.events[i].tick == b.events[i].tick);
+                CHECK(a.events[i].note == b.events[i].note);
+                CHECK(a.events[i].timestamp == b.events[i].timestamp);
+            }
+        }
+        CHECK(midiFile.tempoMap.changes.size() == 2);
+        CHECK(midiFile.tempoMap.changes[1].microsecondsPerQuarter == 300000);
+        CHECK(midiFile.keySignatures.size() == 1);
+        CHECK(midiFile.getDuration() == expected.getDuration());
+    }
+
+    std::cout << "  ✓ Parallel decode matches serial decode" << std::endl;
+
+    // A bad track is reported by index in both modes
+    tracks[5].event(0, {0xFF, 0x01, 0x7F, 'x'});
+    data = buildTestMIDI(1, 480, tracks);
+    CHECK(!serial.parse(data.data(), data.size(), expected));
+    CHECK(!parallel.parse(data.data(), data.size(), midiFile));
+    CHECK(serial.getLastError() == "Failed to parse track 5");
+    CHECK(parallel.getLastError() == serial.getLastError());
+
+    std::cout << "  ✓ Track errors reported like a serial parse" << std::endl;
+}
+
+void testMIDIWriter() {
+    std::cout << "Testing MIDI Writer..." << std::endl;
+
+    TestTrack conductor;
+    conductor.meta(0, 0x03, "Conductor").tempo(0, 500000)
+             .event(0, {0xFF, 0x58, 0x04, 0x03, 0x02, 0x18, 0x08})
+             .event(0, {0xFF, 0x59, 0x02, 0xFE, 0x01})
+             .tempo(1920, 300000);
+    TestTrack piano;
+    piano.meta(0, 0x03, "Piano").event(0, {0xC0, 0x00}).event(0, {0xB0, 0x07, 0x64});
+    for (int i = 0; i < 32; ++i) {
+        piano.note(i == 0 ? 0 : 60, static_cast<uint8_t>(60 + i % 12), 180, static_cast<uint8_t>(70 + i));
+    }
+    TestTrack bass;
+    bass.meta(0, 0x03, "Bass").event(0, {0xC1, 0x21});
+    for (int i = 0; i < 16; ++i) {
+        bass.event(0, {0x91, 36, 100}).event(480, {0x81, 36, 64});
+    }
+    auto data = buildTestMIDI(1, 480, {conductor, piano, bass});
+
+    MIDIParser parser;
+    MIDIFile original;
+    CHECK(parser.parse(data.data(), data.size(), original));
+
+    auto sameEvents = [](const std::vector<MIDIEvent>& a, const std::vector<MIDIEvent>& b) {
+        if (a.size() != b.size()) return false;
+        for (size_t i = 0; i < a.size(); ++i) {
+            if (a[i].tick != b[i].tick || a[i].type != b[i].type || a[i].channel != b[i].channel ||
+                a[i].note != b[i].note || a[i].velocity != b[i].velocity) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    // Format 1 round trip keeps every track, meta event and channel event
+    MIDIWriter writer;
+    std::vector<uint8_t> buffer;
+    CHECK(writer.write(original, 1, buffer));
+    CHECK(buffer.size() <= data.size());   // Running status never makes it larger
+
+    MIDIFile reparsed;
+    CHECK(parser.parse(buffer.data(), buffer.size(), reparsed));
+    CHECK(reparsed.header.format == 1);
+    CHECK(reparsed.tracks.size() == 3);
+    for (size_t t = 0; t < 3; ++t) {
+        CHECK(reparsed.tracks[t].name == original.tracks[t].name);
+        CHECK(sameEvents(reparsed.tracks[t].events, original.tracks[t].events));
+        CHECK(reparsed.tracks[t].metaEvents.size() == original.tracks[t].metaEvents.size());
+    }
+    CHECK(reparsed.tempoMap.changes.size() == 2);
+    CHECK(reparsed.timeSignatures.size() == 1 && reparsed.timeSignatures[0].denominator == 4);
+    CHECK(reparsed.keySignatures.size() == 1 && reparsed.keySignatures[0].minor);
+    CHECK(reparsed.getDuration() == original.getDuration());
+
+    // The buffer is reused: a second write reproduces the same bytes in place
+    std::vector<uint8_t> first = buffer;
+    size_t capacity = buffer.capacity();
+    CHECK(writer.write(original, 1, buffer));
+    CHECK(buffer == first && buffer.capacity() == capacity);
+
+    std::cout << "  ✓ Format 1 round trip" << std::endl;
+
+    // Format 0 merges the tracks in time order
+    CHECK(writer.write(original, 0, buffer));
+    MIDIFile merged;
+    CHECK(parser.parse(buffer.data(), buffer.size(), merged));
+    CHECK(merged.header.format == 0 && merged.tracks.size() == 1);
+    CHECK(merged.tracks[0].name == "Conductor");
+    CHECK(sameEvents(merged.getAllNoteEvents(), original.getAllNoteEvents()));
+    CHECK(merged.tempoMap.changes.size() == 2);
+
+    // Without meta events the tempo map and signatures are rebuilt
+    parser.setParseOptions(ParseNotesOnly);
+    MIDIFile notesOnly;
+    CHECK(parser.parse(data.data(), data.size(), notesOnly));
+    CHECK(writer.write(notesOnly, 1, buffer));
+    parser.setParseOptions(ParseEverything);
+    CHECK(parser.parse(buffer.data(), buffer.size(), reparsed));
+    CHECK(reparsed.tempoMap.changes.size() == 2);
+    CHECK(reparsed.tempoMap.changes[1].tick == 1920);
+    CHECK(reparsed.keySignatures.size() == 1 && reparsed.keySignatures[0].sharpsFlats == -2);
+    CHECK(reparsed.timeSignatures.size() == 1 && reparsed.timeSignatures[0].numerator == 3);
+    CHECK(reparsed.getDuration() == original.getDuration());
+
+    std::cout << "  ✓ Format 0 merge and rebuilt conductor data" << std::endl;
+
+    // A trailing rest keeps the track length through both formats
+    TestTrack loop;
+    loop.meta(0, 0x03, "Loop").note(0, 60, 480).note(0, 64, 480).rest(960);
+    auto loopData = buildTestMIDI(1, 480, {conductor, loop});
+    MIDIFile looped;
+    CHECK(parser.parse(loopData.data(), loopData.size(), looped));
+    CHECK(looped.tracks[1].endTick == 1920 && looped.tracks[1].events.back().tick == 960);
+    CHECK(looped.tracks[0].endTick == 1920);   // Conductor ends on its last tempo change
+    for (uint16_t format = 0; format <= 1; ++format) {
+        CHECK(writer.write(looped, format, buffer));
+        CHECK(parser.parse(buffer.data(), buffer.size(), reparsed));
+        for (const auto& track : reparsed.tracks) {
+            CHECK(track.endTick == 1920);
+        }
+    }
+
+    // Without a source end tick, End of Track follows the last event
+    looped.tracks[1].endTick = 0;
+    looped.tracks[1].events.pop_back();
+    CHECK(writer.write(looped, 1, buffer));
+    CHECK(parser.parse(buffer.data(), buffer.size(), reparsed));
+    CHECK(reparsed.tracks[1].endTick == 480);
+
+    std::cout << "  ✓ End of Track tick round trip" << std::endl;
+
+    // Note table export pairs every note again
+    parser.setBuildNoteTable(true);
+    MIDIFile withNotes;
+    CHECK(parser.parse(data.data(), data.size(), withNotes));
+    CHECK(writer.write(withNotes.notes, withNotes.tempoMap, buffer));
+    CHECK(parser.parse(buffer.data(), buffer.size(), reparsed));
+    const NoteTable& a = withNotes.notes;
+    const NoteTable& b = reparsed.notes;
+    CHECK(a.size() == b.size() && a.size() == 48);
+    for (size_t i = 0; i < a.size(); ++i) {
+        CHECK(a.startTick[i] == b.startTick[i]);
+        CHECK(a.endTick[i] == b.endTick[i]);
+        CHECK(a.pitch[i] == b.pitch[i]);
+        CHECK(a.velocity[i] == b.velocity[i]);
+    }
+    CHECK(reparsed.getDuration() == withNotes.getDuration());
+
+    // Events out of tick order are rejected rather than written with bad deltas
+    MIDIFile unordered = original;
+    std::swap(unordered.tracks[1].events[3], unordered.tracks[1].events[10]);
+    CHECK(!writer.write(unordered, 1, buffer));
+    CHECK(!writer.getLastError().empty());
+
+    std::cout << "  ✓ Note table export and error handling" << std::endl;
+}
+
+void testDeclaredKey() {
+    std::cout << "Testing Declared Key Signatures..." << std::endl;
+
+    auto scaleTrack = [](std::initializer_list<uint8_t> pitches) {
+        TestTrack track;
+        for (int repeat = 0; repeat < 4; ++repeat) {
+            for (uint8_t pitch : pitches) {
+                track.note(0, pitch, 240);
+            }
+        }
+        return track;
+    };
+
+    // G major notes, G major signature (one sharp) and 3/4 time
+    TestTrack conductor;
+    conductor.meta(0, 0x59, {1, 0}).meta(0, 0x58, {3, 2, 24, 8}).meta(960, 0x58, {6, 3, 36, 8});
+    auto data = buildTestMIDI(1, 480, {conductor, scaleTrack({67, 69, 71, 72, 74, 76, 78, 79, 71, 74})});
+
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    CHECK(midiFile.keySignatures.size() == 1);
+    CHECK(midiFile.keySignatures[0].sharpsFlats == 1 && !midiFile.keySignatures[0].minor);
+    CHECK(midiFile.keySignatures[0].getTonicPitchClass() == 7);
+    CHECK(midiFile.timeSignatures.size() == 2);
+    CHECK(midiFile.timeSignatures[0].numerator == 3 && midiFile.timeSignatures[0].denominator == 4);
+    CHECK(midiFile.timeSignatures[1].denominator == 8);
+    CHECK(std::abs(midiFile.timeSignatures[1].time - 1.0) < 1e-9);
+
+    std::cout << "  ✓ Key and time signatures parsed" << std::endl;
+
+    ScaleDetector detector;
+    detector.setUseDeclaredKey(true);
+    HarmonicAnalysis analysis = detector.analyze(midiFile);
+    CHECK(analysis.usedDeclaredKey);
+    CHECK(analysis.primaryScale.root == NoteName::G);
+    CHECK(analysis.primaryScale.type == ScaleType::Ionian);
+
+    // A C major default signature over E major notes is not trusted
+    TestTrack mislabeled;
+    mislabeled.meta(0, 0x59, {0, 0});
+    data = buildTestMIDI(1, 480, {mislabeled, scaleTrack({64, 66, 68, 69, 71, 73, 75, 76, 68, 71})});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    analysis = detector.analyze(midiFile);
+    CHECK(!analysis.usedDeclaredKey);
+    CHECK(analysis.primaryScale.root == NoteName::E);
+
+    // Flats and minor: three flats minor is C minor
+    KeySignature cMinor;
+    cMinor.sharpsFlats = -3;
+    cMinor.minor = true;
+    CHECK(cMinor.getTonicPitchClass() == 0);
+
+    std::cout << "  ✓ Declared key used only when notes agree" << std::endl;
+}
+
+void testStreamingParser() {
+    std::cout << "Testing Streaming Parser..." << std::endl;
+
+    // Tempo change in the conductor track, long sysex and notes in track 1
+    TestTrack conductor;
+    conductor.tempo(0, 500000).tempo(960, 250000);
+    TestTrack notes;
+    notes.meta(0, 0x03, "Lead").event(0, {0xF0, 0x7F}).bytes.resize(notes.bytes.size() + 127, 0x00);
+    for (int i = 0; i < 200; ++i) {
+        notes.note(0, static_cast<uint8_t>(60 + (i % 7) * 2), 120, static_cast<uint8_t>(64 + i % 60));
+    }
+    auto data = buildTestMIDI(1, 480, {conductor, notes});
+    std::string path = writeTestFile("streaming_test.mid", data);
+
+    struct Collector : MIDIEventVisitor {
+        std::vector<MIDIEvent> events;
+        std::vector<std::string> names;
+        void visitEvent(size_t, const MIDIEvent& event) override { events.push_back(event); }
+        void visitMetaEvent(size_t, const MIDIMetaEvent& meta) override {
+            if (meta.type == 0x03) {
+                names.emplace_back(meta.data);
+            }
+        }
+    };
+
+    // A window smaller than the sysex payload forces refills and seeks
+    StreamingParser streaming(64);
+    Collector collector;
+    CHECK(streaming.parse(path, collector));
+
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(path, midiFile));
+
+    const auto& expected = midiFile.tracks[1].events;
+    CHECK(collector.events.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+        CHECK(collector.events[i].tick == expected[i].tick);
+        CHECK(collector.events[i].note == expected[i].note);
+        CHECK(collector.events[i].type == expected[i].type);
+        CHECK(collector.events[i].timestamp == expected[i].timestamp);
+    }
+    CHECK(collector.names.size() == 1 && collector.names[0] == "Lead");
+    CHECK(streaming.getTempo() == 120.0);
+    CHECK(std::abs(streaming.getDuration() - midiFile.getDuration()) < 1e-9);
+
+    std::cout << "  ✓ Windowed events match a full parse" << std::endl;
+
+    // Streaming analysis matches the in-memory histogram
+    ScaleDetector detector;
+    detector.setDetectKeyChanges(false);
+    HarmonicAnalysis loaded = detector.analyze(midiFile);
+    HarmonicAnalysis streamed;
+    CHECK(detector.analyzeStream(path, streaming, streamed));
+    CHECK(streamed.totalNotes == loaded.totalNotes);
+    CHECK(streamed.primaryScale.root == loaded.primaryScale.root);
+    CHECK(streamed.primaryScale.type == loaded.primaryScale.type);
+    CHECK(std::abs(streamed.averagePitch - loaded.averagePitch) < 1e-9);
+    CHECK(streamed.noteDistribution == loaded.noteDistribution);
+    for (int i = 0; i < 12; ++i) {
+        CHECK(std::abs(streamed.noteWeights[i] - loaded.noteWeights[i]) < 1e-4);
+    }
+
+    // Truncated stream is an error, not a crash
+    std::vector<uint8_t> truncated(data.begin(), data.end() - 20);
+    std::string truncatedPath = writeTestFile("streaming_truncated.mid", truncated);
+    CHECK(!streaming.parse(truncatedPath, collector));
+    CHECK(!streaming.getLastError().empty());
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(truncatedPath);
+
+    std::cout << "  ✓ Streaming analysis matches loaded analysis" << std::endl;
+}
+
+void testZipArchive() {
+    std::cout << "Testing Zip Archives..." << std::endl;
+
+    TestTrack lead;
+    lead.tempo(0, 500000);
+    for (uint8_t pitch : {60, 62, 64, 65, 67, 69, 71, 72}) {
+        lead.note(0, pitch, 480);
+    }
+    auto leadData = buildTestMIDI(0, 480, {lead});
+    TestTrack bass;
+    bass.note(0, 36, 960).note(0, 43, 960);
+    auto bassData = buildTestMIDI(0, 480, {bass});
+
+    auto zip = buildTestZip({
+        {"Pack/", {}, false},
+        {"Pack/Lead C.mid", leadData, true},
+        {"Pack/Bass.MID", bassData, false},
+        {"Pack/readme.txt", {'h', 'i'}, true},
+    });
+    std::string zipPath = writeTestFile("midixplorer_pack.zip", zip);
+
+    ZipArchive archive;
+    CHECK(archive.open(zipPath));
+    CHECK(archive.getEntries().size() == 3);   // Directory entry left out
+    const ZipEntry* entry = archive.findEntry("Pack/Lead C.mid");
+    CHECK(entry != nullptr && entry->method == 8);
+    std::vector<uint8_t> buffer;
+    CHECK(archive.extract(*entry, buffer));
+    CHECK(buffer == leadData);
+    CHECK(archive.extract(*archive.findEntry("Pack/Bass.MID"), buffer));
+    CHECK(buffer == bassData);
+
+    std::string archivePath, entryName;
+    std::string leadPath = ZipArchive::makePath(zipPath, "Pack/Lead C.mid");
+    CHECK(ZipArchive::splitPath(leadPath, archivePath, entryName));
+    CHECK(archivePath == zipPath && entryName == "Pack/Lead C.mid");
+    CHECK(!ZipArchive::splitPath("/music/Wow!/file.mid", archivePath, entryName));
+
+    std::cout << "  ✓ Stored and deflated entries extracted" << std::endl;
+
+    // Archive paths work anywhere a file path does
+    MIDIParser parser;
+    MIDIFile midiFile;
+    CHECK(parser.parse(leadPath, midiFile));
+    CHECK(midiFile.tracks[0].events.size() == 16);
+    CHECK(midiFile.contentHash == hashContent(leadData.data(), leadData.size()));
+    CHECK(!parser.parse(ZipArchive::makePath(zipPath, "Pack/Missing.mid"), midiFile));
+
+    // A directory holding the pack is scanned as if the entries were files
+    auto scanDir = std::filesystem::temp_directory_path() / "midixplorer_zipscan";
+    std::filesystem::create_directories(scanDir);
+    std::filesystem::copy_file(zipPath, scanDir / "pack.zip",
+                               std::filesystem::copy_options::overwrite_existing);
+
+    Database db;
+    CHECK(db.initialize(":memory:"));
+    FileScanner scanner(db);
+    ScannerConfig config;
+    config.searchPaths.push_back(scanDir.string());
+    CHECK(scanner.startScan(config));
+    CHECK(scanner.getLastScanStats().totalFiles == 2);
+    CHECK(scanner.getLastScanStats().failedFiles == 0);
+
+    std::string scannedLead = ZipArchive::makePath((scanDir / "pack.zip").string(), "Pack/Lead C.mid");
+    MIDIFileEntry stored = db.getFile(scannedLead);
+    CHECK(stored.fileName == "Lead C.mid");
+    CHECK(stored.totalNotes == 8);
+    CHECK(stored.fileSize == static_cast<int64_t>(leadData.size()));
+    CHECK(stored.detectedKey == "C");
+
+    std::cout << "  ✓ Scanner indexes archive entries in place" << std::endl;
+
+    // Corrupted payload is caught by the CRC, not handed to the parser
+    auto corrupt = buildTestZip({{"a.mid", leadData, false}});
+    corrupt[30 + 5 + 20] ^= 0x01;
+    std::string corruptPath = writeTestFile("midixplorer_corrupt.zip", corrupt);
+    CHECK(archive.open(corruptPath));
+    CHECK(!archive.extract(archive.getEntries()[0], buffer));
+    CHECK(!archive.getLastError().empty());
+
+    // Truncated archives are rejected without reading past the end
+    for (size_t length = 0; length < zip.size(); length += 7) {
+        std::vector<uint8_t> truncated(zip.begin(), zip.begin() + length);
+        std::string truncatedPath = writeTestFile("midixplorer_truncated.zip", truncated);
+        if (archive.open(truncatedPath)) {
+            for (const auto& e : archive.getEntries()) {
+                archive.extract(e, buffer);
+            }
+        }
+        std::filesystem::remove(truncatedPath);
+    }
+
+    std::filesystem::remove_all(scanDir);
+    std::filesystem::remove(zipPath);
+    std::filesystem::remove(corruptPath);
+
+    std::cout << "  ✓ Corrupt and truncated archives rejected" << std::endl;
+}
+
 void testScaleDetector() {
     std::cout << "Testing Scale Detector..." << std::endl;
 
@@ -34,14 +1174,25 @@ void testScaleTypes() {
     std::cout << "Testing Scale Type Conversions..." << std::endl;
 
     // Test note name conversion
-    assert(noteNameToString(NoteName::C) == "C");
-    assert(noteNameToString(NoteName::Db) == "Db");
-    assert(noteNameToString(NoteName::G) == "G");
+    CHECK(noteNameToString(NoteName::C) == "C");
+    CHECK(noteNameToString(NoteName::Db) == "Db");
+    CHECK(noteNameToString(NoteName::G) == "G");
 
     // Test scale type conversion
-    assert(scaleTypeToString(ScaleType::Ionian) == "Major");
-    assert(scaleTypeToString(ScaleType::Aeolian) == "Minor");
-    assert(scaleTypeToString(ScaleType::Dorian) == "Dorian");
+    CHECK(scaleTypeToString(ScaleType::Ionian) == "Major");
+    CHECK(scaleTypeToString(ScaleType::Aeolian) == "Minor");
+    CHECK(scaleTypeToString(ScaleType::Dorian) == "Dorian");
+    CHECK(scaleTypeName(ScaleType::PhrygianDominant) == "Phrygian Dominant");
+    CHECK(scaleTypeName(ScaleType::Unknown) == "Unknown");
+
+    // Every type has a template with the root and a name of its own
+    static_assert(scaleMask(ScaleType::Ionian) == 0xAB5, "C major is C D E F G A B");
+    static_assert(countPitchClasses(scaleMask(ScaleType::Chromatic)) == 12, "Chromatic has every note");
+    for (const auto& scaleTemplate : kScaleTemplates) {
+        CHECK(scaleTemplate.mask & 1);
+        CHECK(countPitchClasses(scaleTemplate.mask) >= 5);
+        CHECK(!scaleTemplate.name.empty() && scaleTemplate.name != "Unknown");
+    }
 
     std::cout << "  ✓ Note name conversions correct" << std::endl;
     std::cout << "  ✓ Scale type conversions correct" << std::endl;
@@ -50,26 +1201,825 @@ void testScaleTypes() {
 void testScale() {
     std::cout << "Testing Scale Structure..." << std::endl;
 
-    Scale scale;
-    scale.root = NoteName::C;
-    scale.type = ScaleType::Ionian;
-    scale.intervals = {0, 2, 4, 5, 7, 9, 11}; // C Major scale
-    scale.confidence = 0.95;
+    Scale scale(NoteName::C, ScaleType::Ionian, 0.95); // C Major scale
 
     // Test scale name
     std::string name = scale.getName();
-    assert(name == "C Major");
+    CHECK(name == "C Major");
 
     // Test note containment
-    assert(scale.containsNote(60) == true);  // C (middle C)
-    assert(scale.containsNote(62) == true);  // D
-    assert(scale.containsNote(64) == true);  // E
-    assert(scale.containsNote(61) == false); // C# (not in C Major)
+    CHECK(scale.containsNote(60) == true);  // C (middle C)
+    CHECK(scale.containsNote(62) == true);  // D
+    CHECK(scale.containsNote(64) == true);  // E
+    CHECK(scale.containsNote(61) == false); // C# (not in C Major)
+    CHECK(scale.noteCount() == 7);
+
+    // Intervals are relative to the root
+    Scale dMinor(NoteName::D, ScaleType::Aeolian, 0.9);
+    CHECK(dMinor.containsNote(62) && dMinor.containsNote(70) && dMinor.containsNote(48));
+    CHECK(!dMinor.containsNote(71) && !dMinor.containsNote(66));
+    CHECK(dMinor.getPitchClasses() == scale.getPitchClasses() - (1 << 11) + (1 << 10));
+    CHECK(transposePitchClassMask(scaleMask(ScaleType::Ionian), 12) == scaleMask(ScaleType::Ionian));
 
     std::cout << "  ✓ Scale name: " << name << std::endl;
     std::cout << "  ✓ Note containment checks correct" << std::endl;
 }
 
+void testScaleScoring() {
+    std::cout << "Testing Scale Scoring..." << std::endl;
+
+    const std::array<double, 12> major = {6.35, 2.23, 3.48, 2.33, 4.38, 4.09, 2.52, 5.19, 2.39, 3.66, 2.29, 2.88};
+    const std::array<double, 12> minor = {6.33, 2.68, 3.52, 5.38, 2.60, 3.53, 2.54, 4.75, 3.98, 2.69, 3.34, 3.17};
+    ScaleScorer scorer;
+    scorer.setProfiles(major, minor);
+
+    // Textbook Pearson correlation of the histogram rotated to root
+    auto pearson = [](const std::array<double, 12>& histogram, const std::array<double, 12>& profile, int root) {
+        double meanH = 0.0, meanP = 0.0;
+        for (int i = 0; i < 12; ++i) {
+            meanH += histogram[(i + root) % 12] / 12.0;
+            meanP += profile[i] / 12.0;
+        }
+        double numerator = 0.0, denomH = 0.0, denomP = 0.0;
+        for (int i = 0; i < 12; ++i) {
+            double h = histogram[(i + root) % 12] - meanH;
+            double p = profile[i] - meanP;
+            numerator += h * p;
+            denomH += h * h;
+            denomP += p * p;
+        }
+        return denomH == 0.0 ? 0.0 : numerator / std::sqrt(denomH * denomP);
+    };
+
+    uint32_t seed = 12345;
+    auto next = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) / 16777216.0;
+    };
+
+    ScaleScores scores, reference;
+    ScaleScorer scalar;
+    scalar.setProfiles(major, minor);
+    CHECK(scalar.setKernel(ScoringKernel::Scalar));
+
+    for (int trial = 0; trial < 50; ++trial) {
+        std::array<double, 12> histogram;
+        for (double& value : histogram) {
+            value = next() < 0.3 ? 0.0 : next();
+        }
+
+        scalar.score(histogram, reference);
+        for (int root = 0; root < 12; ++root) {
+            CHECK(std::abs(reference.majorCorrelation(root) - pearson(histogram, major, root)) < 1e-12);
+            CHECK(std::abs(reference.minorCorrelation(root) - pearson(histogram, minor, root)) < 1e-12);
+            for (const auto& scaleTemplate : kScaleTemplates) {
+                double sum = 0.0;
+                for (int interval = 0; interval < 12; ++interval) {
+                    if ((scaleTemplate.mask >> interval) & 1) {
+                        sum += histogram[(root + interval) % 12];
+                    }
+                }
+                double expected = sum / countPitchClasses(scaleTemplate.mask);
+                CHECK(std::abs(reference.templateMatch(scaleTemplate.type, root) - expected) < 1e-12);
+            }
+        }
+
+        // The key-only path matches the key rows
+        std::array<double, ScaleScores::kKeyRows> keyScores;
+        scalar.scoreKeys(histogram, keyScores);
+        for (size_t row = 0; row < ScaleScores::kKeyRows; ++row) {
+            CHECK(std::abs(keyScores[row] - reference.values[row]) < 1e-12);
+        }
+
+        // Every kernel this CPU has gives the same scores
+        for (ScoringKernel kernel : {ScoringKernel::SSE2, ScoringKernel::AVX2, ScoringKernel::NEON}) {
+            if (scorer.setKernel(kernel)) {
+                scorer.score(histogram, scores);
+                for (size_t row = 0; row < ScaleScores::kRows; ++row) {
+                    CHECK(std::abs(scores.values[row] - reference.values[row]) < 1e-12);
+                }
+            }
+        }
+    }
+    CHECK(ScaleScorer::isSupported(ScaleScorer::bestKernel()));
+
+    std::cout << "  ✓ Scores match the reference on the "
+              << scoringKernelName(ScaleScorer::bestKernel()) << " kernel" << std::endl;
+
+    // Flat histograms correlate with no key
+    std::array<double, 12> flat;
+    flat.fill(1.0 / 12.0);
+    scorer.score(flat, scores);
+    for (int root = 0; root < 12; ++root) {
+        CHECK(scores.majorCorrelation(root) == 0.0 && scores.minorCorrelation(root) == 0.0);
+    }
+
+    // A major profile shifted to G ranks G major first
+    std::array<double, 12> gMajor;
+    for (int i = 0; i < 12; ++i) {
+        gMajor[(i + 7) % 12] = major[i];
+    }
+    scorer.score(gMajor, scores);
+    std::vector<Scale> keys;
+    scorer.topKeys(scores, 3, keys);
+    CHECK(keys.size() == 3);
+    CHECK(keys[0].root == NoteName::G && keys[0].type == ScaleType::Ionian);
+    CHECK(std::abs(keys[0].confidence - 1.0) < 1e-12);
+    CHECK(keys[1].confidence >= keys[2].confidence);
+
+    std::cout << "  ✓ Top keys ranked by correlation" << std::endl;
+}
+
+void testKeyChanges() {
+    std::cout << "Testing Key Change Tracking..." << std::endl;
+
+    // Overlapping notes of random length on four tracks
+    uint32_t seed = 777;
+    auto next = [&seed](uint32_t range) {
+        seed = seed * 1664525u + 1013904223u;
+        return (seed >> 8) % range;
+    };
+    std::vector<TestTrack> tracks(4);
+    for (auto& track : tracks) {
+        for (int i = 0; i < 40; ++i) {
+            track.note(next(3) * 120, static_cast<uint8_t>(48 + next(24)), 1 + next(960),
+                       static_cast<uint8_t>(1 + next(127)));
+        }
+    }
+    auto data = buildTestMIDI(1, 480, tracks);
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    const NoteTable& notes = midiFile.notes;
+
+    // Window histograms equal the sum of each note's overlap with the window
+    PitchClassTimeline timeline;
+    timeline.build(notes, true, true);
+    PitchClassTimeline onsets;
+    onsets.build(notes, false, false);
+    double duration = midiFile.getDuration();
+    for (int trial = 0; trial < 200; ++trial) {
+        double start = duration * next(1000) / 1000.0;
+        double end = start + duration * next(1000) / 2000.0;
+        std::array<double, 12> expected, counts;
+        expected.fill(0.0);
+        counts.fill(0.0);
+        for (size_t i = 0; i < notes.size(); ++i) {
+            double overlap = std::min(notes.endTime[i], end) - std::max(notes.startTime[i], start);
+            expected[notes.pitch[i] % 12] += std::max(0.0, overlap) * notes.velocity[i] / 127.0;
+            if (notes.startTime[i] >= start && notes.startTime[i] < end) {
+                counts[notes.pitch[i] % 12] += 1.0;
+            }
+        }
+        std::array<double, 12> actual;
+        timeline.histogram(start, end, actual);
+        for (int pc = 0; pc < 12; ++pc) {
+            CHECK(std::abs(actual[pc] - expected[pc]) < 1e-9);
+        }
+        onsets.histogram(start, end, actual);
+        CHECK(actual == counts);
+    }
+
+    std::cout << "  ✓ Prefix histograms match a direct sum over notes" << std::endl;
+
+    // 24 s of C major, 24 s of F# major, at two notes per second
+    auto scaleRun = [](TestTrack& track, std::initializer_list<uint8_t> pitches, int seconds) {
+        for (int i = 0; i < seconds * 2; ++i) {
+            track.note(0, *(pitches.begin() + i % pitches.size()), 480);
+        }
+    };
+    TestTrack modulating;
+    scaleRun(modulating, {60, 62, 64, 65, 67, 69, 71, 72, 67, 64, 60, 55}, 24);
+    scaleRun(modulating, {66, 68, 70, 71, 73, 75, 77, 78, 73, 70, 66, 61}, 24);
+    data = buildTestMIDI(0, 480, {modulating});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    ScaleDetector detector;
+    HarmonicAnalysis analysis = detector.analyze(midiFile);
+    CHECK(!analysis.keyChanges.empty());
+    CHECK(analysis.keyChanges.back().first == 24.0);
+    CHECK(analysis.keyChanges.back().second.root == NoteName::Gb);
+    CHECK(analysis.keyChanges.back().second.type == ScaleType::Ionian);
+
+    // The window straddling the modulation may pick a passing key; two
+    // windows of hysteresis report only the modulation, from where it began
+    detector.setKeyChangeHysteresis(2);
+    analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.size() == 1);
+    CHECK(analysis.keyChanges[0].first >= 20.0 && analysis.keyChanges[0].first <= 24.0);
+    CHECK(analysis.keyChanges[0].second.root == NoteName::Gb);
+
+    // A wider window on finer hops agrees
+    detector.setKeyChangeHysteresis(3);
+    detector.setKeyChangeWindow(6.0, 1.0);
+    analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.size() == 1);
+    CHECK(analysis.keyChanges[0].first >= 18.0 && analysis.keyChanges[0].first <= 24.0);
+    CHECK(analysis.keyChanges[0].second.root == NoteName::Gb);
+
+    // A two-second excursion doesn't outlast the hysteresis
+    TestTrack excursion;
+    scaleRun(excursion, {60, 62, 64, 65, 67, 69, 71, 72, 67, 64, 60, 55}, 20);
+    scaleRun(excursion, {66, 68, 70, 71}, 2);
+    scaleRun(excursion, {60, 62, 64, 65, 67, 69, 71, 72, 67, 64, 60, 55}, 20);
+    data = buildTestMIDI(0, 480, {excursion});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    detector.setKeyChangeHysteresis(1);
+    analysis = detector.analyze(midiFile);
+    CHECK(!analysis.keyChanges.empty());
+    detector.setKeyChangeHysteresis(4);
+    analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.empty());
+
+    std::cout << "  ✓ Modulations reported once, brief excursions ignored" << std::endl;
+}
+
+void testKeySegmenter() {
+    std::cout << "Testing Viterbi Key Segmentation..." << std::endl;
+
+    auto scaleRun = [](TestTrack& track, std::initializer_list<uint8_t> pitches, int seconds) {
+        for (int i = 0; i < seconds * 2; ++i) {
+            track.note(0, *(pitches.begin() + i % pitches.size()), 480);
+        }
+    };
+    const std::initializer_list<uint8_t> cMajor = {60, 62, 64, 65, 67, 69, 71, 72, 67, 64, 60, 55};
+    const std::initializer_list<uint8_t> gbMajor = {66, 68, 70, 71, 73, 75, 77, 78, 73, 70, 66, 61};
+    const std::initializer_list<uint8_t> aMajor = {69, 71, 73, 74, 76, 78, 80, 81, 76, 73, 69, 64};
+
+    // 24 s of C major then 24 s of F# major, at 120 BPM
+    TestTrack modulating;
+    scaleRun(modulating, cMajor, 24);
+    scaleRun(modulating, gbMajor, 24);
+    auto data = buildTestMIDI(0, 480, {modulating});
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    // Segments tile the range on beat boundaries
+    PitchClassTimeline timeline;
+    timeline.build(midiFile.notes, true, true);
+    KeySegmenter segmenter;
+    std::vector<KeySegment> segments;
+    segmenter.segment(timeline, midiFile.tempoMap, 0.0, midiFile.getDuration(), segments);
+    CHECK(segments.size() == 2);
+    CHECK(segments[0].startTime == 0.0 && segments.back().endTime == midiFile.getDuration());
+    CHECK(segments[0].endTime == segments[1].startTime);
+    CHECK(segments[0].key == 0 && segments[1].key == 6);
+
+    ScaleDetector detector;
+    detector.setKeyChangeMethod(KeyChangeMethod::Viterbi);
+    HarmonicAnalysis analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.size() == 1);
+    CHECK(std::abs(analysis.keyChanges[0].first - 24.0) <= 0.5);
+    CHECK(analysis.keyChanges[0].second.root == NoteName::Gb);
+    CHECK(analysis.keyChanges[0].second.type == ScaleType::Ionian);
+    CHECK(analysis.keyChanges[0].second.confidence > 0.8);
+
+    std::cout << "  ✓ One change at the modulation, on a beat" << std::endl;
+
+    // A two-second excursion costs less than two switches
+    TestTrack excursion;
+    scaleRun(excursion, cMajor, 20);
+    scaleRun(excursion, {66, 68, 70, 71}, 2);
+    scaleRun(excursion, cMajor, 20);
+    data = buildTestMIDI(0, 480, {excursion});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.empty());
+    detector.setKeySwitchProbability(0.2);
+    analysis = detector.analyze(midiFile);
+    CHECK(analysis.keyChanges.size() == 2);
+    detector.setKeySwitchProbability(0.002);
+
+    std::cout << "  ✓ Brief excursions absorbed by the transition cost" << std::endl;
+
+    // Ten minutes in three keys, through a reused context
+    TestTrack song;
+    scaleRun(song, cMajor, 200);
+    scaleRun(song, gbMajor, 200);
+    scaleRun(song, aMajor, 200);
+    data = buildTestMIDI(0, 480, {song});
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+    AnalysisContext context;
+    detector.analyze(midiFile, context, analysis);
+    CHECK(analysis.keyChanges.size() == 2);
+    CHECK(std::abs(analysis.keyChanges[0].first - 200.0) <= 0.5);
+    CHECK(std::abs(analysis.keyChanges[1].first - 400.0) <= 0.5);
+    CHECK(analysis.keyChanges[1].second.root == NoteName::A);
+
+    size_t before = allocationCount.load();
+    detector.analyze(midiFile, context, analysis);
+    CHECK(allocationCount.load() == before);
+    CHECK(analysis.keyChanges.size() == 2);
+
+    std::cout << "  ✓ Long songs segmented without reallocating" << std::endl;
+}
+
+void testChordDetector() {
+    std::cout << "Testing Chord Detection..." << std::endl;
+
+    auto label = [](std::initializer_list<int> pitchClasses, int bass) {
+        PitchClassMask mask = 0;
+        for (int pc : pitchClasses) {
+            mask |= static_cast<PitchClassMask>(1u << pc);
+        }
+        Chord chord;
+        return ChordDetector::identify(mask, bass, chord) ? chord.getName() : std::string();
+    };
+    CHECK(label({0, 4, 7}, 0) == "C");
+    CHECK(label({9, 0, 4}, 9) == "Am");
+    CHECK(label({0, 4, 7, 10}, 4) == "C7/E");
+    CHECK(label({0, 4, 11}, 0) == "Cmaj7");         // Fifth omitted
+    CHECK(label({0, 4, 7, 9}, 0) == "C6");          // Same notes as Am7...
+    CHECK(label({0, 4, 7, 9}, 9) == "Am7");         // ...told apart by the bass
+    CHECK(label({11, 2, 5, 9}, 11) == "Bm7b5");
+    CHECK(label({2, 7, 9}, 2) == "Dsus4");
+    CHECK(label({4, 11}, 4) == "E5");
+    CHECK(label({0, 4}, 0).empty());
+    CHECK(label({0}, 0).empty());
+
+    Chord inverted;
+    ChordDetector::identify(makePitchClassMask({0, 4, 7}), 7, inverted);
+    CHECK(inverted.getInversion() == 2);
+    ChordDetector::identify(makePitchClassMask({0, 4, 7, 10}), 10, inverted);
+    CHECK(inverted.getInversion() == 3);
+    inverted.bass = NoteName::D;
+    CHECK(inverted.getInversion() == -1);
+
+    std::cout << "  ✓ Chord labels with quality and inversion" << std::endl;
+
+    // C - Am/C - F/A - G7, one bar each, under a melody of chord tones
+    // with short chromatic passing notes
+    TestTrack chords;
+    TestTrack melody;
+    const std::vector<std::vector<uint8_t>> voicings = {
+        {48, 52, 55}, {48, 57, 64}, {45, 53, 60}, {43, 53, 59, 62}};
+    uint32_t rest = 0;
+    for (const auto& voicing : voicings) {
+        for (size_t i = 0; i < voicing.size(); ++i) {
+            chords.event(0, {0x90, voicing[i], 80});
+        }
+        for (size_t i = 0; i < voicing.size(); ++i) {
+            chords.event(i == 0 ? 1920 : 0, {0x80, voicing[i], 0});
+        }
+        uint8_t top = static_cast<uint8_t>(voicing.back() + 12);
+        for (int step = 0; step < 4; ++step) {
+            melody.note(rest, top, 240).note(0, static_cast<uint8_t>(top + 1), 60);
+            rest = 180;
+        }
+    }
+    auto data = buildTestMIDI(1, 480, {chords, melody});
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    ChordDetector detector;
+    std::vector<Chord> timeline;
+    detector.setWindow(ChordWindow::Beats, 4.0);
+    detector.detect(midiFile.notes, midiFile.tempoMap, 0.0, midiFile.getDuration(), timeline);
+    std::vector<std::string> names;
+    for (const auto& chord : timeline) {
+        names.push_back(chord.getName());
+    }
+    CHECK((names == std::vector<std::string>{"C", "Am/C", "F/A", "G7"}));
+    for (size_t i = 0; i < timeline.size(); ++i) {
+        CHECK(std::abs(timeline[i].startTime - 2.0 * i) < 1e-9);
+        CHECK(std::abs(timeline[i].endTime - 2.0 * (i + 1)) < 1e-9);
+    }
+    CHECK(timeline[1].getInversion() == 1 && timeline[2].getInversion() == 1);
+
+    // Half-bar windows merge back to the same four spans
+    detector.setWindow(ChordWindow::Beats, 2.0);
+    std::vector<Chord> halfBars;
+    detector.detect(midiFile.notes, midiFile.tempoMap, 0.0, midiFile.getDuration(), halfBars);
+    CHECK(halfBars.size() == 4);
+    CHECK(halfBars[3].getName() == "G7" && std::abs(halfBars[3].startTime - 6.0) < 1e-9);
+
+    std::cout << "  ✓ Beat windows follow the bar" << std::endl;
+
+    // Event-driven spans change with every melody note; only the range is labelled
+    detector.setWindow(ChordWindow::Changes, 0.0);
+    detector.detect(midiFile.notes, midiFile.tempoMap, 2.0, 4.0, timeline);
+    CHECK(!timeline.empty());
+    CHECK(timeline.front().startTime >= 2.0 && timeline.back().endTime <= 4.0);
+    for (const auto& chord : timeline) {
+        CHECK(chord.root == NoteName::A || chord.root == NoteName::C);
+    }
+
+    // Whole-file analysis carries the timeline and the collapsed names
+    ScaleDetector scaleDetector;
+    HarmonicAnalysis analysis = scaleDetector.analyze(midiFile);
+    CHECK(analysis.chords.size() == 4);
+    CHECK((analysis.chordProgression == std::vector<std::string>{"C", "Am/C", "F/A", "G7"}));
+
+    std::cout << "  ✓ Event sweep and analysis timeline" << std::endl;
+}
+
+void testAnalysisContext() {
+    std::cout << "Testing Analysis Context..." << std::endl;
+
+    // Three files of different lengths, long enough for key tracking
+    std::vector<MIDIFile> files(3);
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    for (size_t f = 0; f < files.size(); ++f) {
+        TestTrack melody;
+        TestTrack bass;
+        int bars = 4 + static_cast<int>(f) * 4;
+        for (int bar = 0; bar < bars; ++bar) {
+            uint8_t root = static_cast<uint8_t>(bar < bars / 2 ? 60 : 67);
+            for (uint8_t step : {0, 4, 7, 12, 7, 4, 2, 11}) {
+                melody.note(0, static_cast<uint8_t>(root + step), 240);
+            }
+            bass.note(0, static_cast<uint8_t>(root - 24), 1920);
+        }
+        auto data = buildTestMIDI(1, 480, {melody, bass});
+        CHECK(parser.parse(data.data(), data.size(), files[f]));
+        files[f].source.reset();
+    }
+
+    ScaleDetector detector;
+    AnalysisContext context;
+    std::vector<HarmonicAnalysis> results(files.size());
+    detector.analyzeBatch(files.data(), files.size(), results.data(), context);
+    for (size_t f = 0; f < files.size(); ++f) {
+        HarmonicAnalysis expected = detector.analyze(files[f]);
+        CHECK(results[f].primaryScale.root == expected.primaryScale.root);
+        CHECK(results[f].primaryScale.type == expected.primaryScale.type);
+        CHECK(results[f].noteWeights == expected.noteWeights);
+        CHECK(results[f].chordProgression == expected.chordProgression);
+        CHECK(results[f].keyChanges.size() == expected.keyChanges.size());
+        CHECK(results[f].noteDistribution == expected.noteDistribution);
+        CHECK(results[f].totalNotes == static_cast<int>(files[f].notes.size()));
+    }
+    CHECK(!results[2].keyChanges.empty());
+    CHECK(results[0].noteDistribution[60] == 2 && results[0].noteDistribution[43] == 2);
+
+    std::cout << "  ✓ Batch results match single-file analysis" << std::endl;
+
+    // Once the buffers fit the largest file, another pass allocates nothing
+    size_t before = allocationCount.load();
+    detector.analyzeBatch(files.data(), files.size(), results.data(), context);
+    CHECK(allocationCount.load() == before);
+    CHECK(!results[2].keyChanges.empty() && !results[2].chords.empty());
+
+    // A reused result carries nothing over from the previous file
+    detector.analyze(files[0], context, results[2]);
+    CHECK(results[2].keyChanges.empty());
+    CHECK(results[2].totalNotes == results[0].totalNotes);
+
+    std::cout << "  ✓ Steady-state analysis makes no heap allocations" << std::endl;
+}
+
+void testAnalysisLevels() {
+    std::cout << "Testing Analysis Levels..." << std::endl;
+
+    TestTrack melody;
+    TestTrack bass;
+    for (int bar = 0; bar < 12; ++bar) {
+        uint8_t root = static_cast<uint8_t>(bar < 6 ? 60 : 67);
+        for (uint8_t step : {0, 4, 7, 12, 7, 4, 2, 11}) {
+            melody.note(0, static_cast<uint8_t>(root + step), 240);
+        }
+        bass.note(0, static_cast<uint8_t>(root - 24), 1920);
+    }
+    auto data = buildTestMIDI(1, 480, {melody, bass});
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(data.data(), data.size(), midiFile));
+
+    ScaleDetector detector;
+    AnalysisContext context;
+    HarmonicAnalysis full;
+    detector.analyze(midiFile, context, full);
+    CHECK(full.level == AnalysisLevel::Full);
+    CHECK(!full.alternativeScales.empty() && !full.chords.empty() && !full.keyChanges.empty());
+
+    // Lower levels keep the key and skip the rest
+    HarmonicAnalysis keyOnly;
+    detector.setAnalysisLevel(AnalysisLevel::KeyOnly);
+    detector.analyze(midiFile, context, keyOnly);
+    CHECK(keyOnly.level == AnalysisLevel::KeyOnly);
+    CHECK(keyOnly.primaryScale.getName() == full.primaryScale.getName());
+    CHECK(keyOnly.noteWeights == full.noteWeights && keyOnly.totalNotes == full.totalNotes);
+    CHECK(keyOnly.alternativeScales.empty() && keyOnly.chords.empty() && keyOnly.keyChanges.empty());
+
+    HarmonicAnalysis alternatives;
+    detector.setAnalysisLevel(AnalysisLevel::KeyAndAlternatives);
+    detector.analyze(midiFile, context, alternatives);
+    CHECK(alternatives.alternativeScales.size() == full.alternativeScales.size());
+    CHECK(alternatives.chords.empty() && alternatives.chordProgression.empty());
+
+    std::cout << "  ✓ Levels gate alternatives, chords and key changes" << std::endl;
+
+    // Upgrading fills in exactly what a Full analysis would have
+    detector.upgrade(midiFile, AnalysisLevel::Full, context, keyOnly);
+    CHECK(keyOnly.level == AnalysisLevel::Full);
+    CHECK(keyOnly.alternativeScales.size() == full.alternativeScales.size());
+    for (size_t i = 0; i < full.alternativeScales.size(); ++i) {
+        CHECK(keyOnly.alternativeScales[i].getName() == full.alternativeScales[i].getName());
+    }
+    CHECK(keyOnly.chordProgression == full.chordProgression);
+    CHECK(keyOnly.keyChanges.size() == full.keyChanges.size());
+
+    std::cout << "  ✓ Upgrade matches a Full analysis" << std::endl;
+
+    // Scans store everything chord filters need by default
+    std::string path = writeTestFile("levels.mid", data);
+    Database db;
+    CHECK(db.initialize(":memory:"));
+    FileScanner scanner(db);
+    CHECK(scanner.getAnalysisLevel() == AnalysisLevel::Full);
+    CHECK(scanner.scanFile(path));
+    CHECK(db.getFile(path).analysisLevel == AnalysisLevel::Full);
+    SearchCriteria criteria;
+    criteria.chordFilter = full.chordProgression.front();
+    CHECK(db.search(criteria).size() == 1);
+
+    // A key-only scan leaves chord filters to see the file once upgraded
+    scanner.setAnalysisLevel(AnalysisLevel::KeyOnly);
+    CHECK(db.removeFile(path));
+    CHECK(scanner.scanFile(path));
+    MIDIFileEntry entry = db.getFile(path);
+    CHECK(entry.analysisLevel == AnalysisLevel::KeyOnly && entry.chordProgression.empty());
+    CHECK(entry.detectedKey == full.primaryScale.getRootName());
+    CHECK(db.getFilesBelowLevel(AnalysisLevel::Full).size() == 1);
+    CHECK(db.search(criteria).empty());
+
+    // An earlier stopScan() doesn't leave upgrades switched off
+    scanner.stopScan();
+    scanner.queueUpgrade(path, AnalysisLevel::Full);
+    CHECK(scanner.analyzeUpgrades(AnalysisLevel::KeyOnly));
+    CHECK(!scanner.isScanning());
+    entry = db.getFile(path);
+    CHECK(entry.analysisLevel == AnalysisLevel::Full && !entry.chordProgression.empty());
+    CHECK(db.getFilesBelowLevel(AnalysisLevel::Full).empty());
+    CHECK(db.search(criteria).size() == 1);
+    criteria.chordFilter = "C#dim7";
+    CHECK(db.search(criteria).empty());
+    criteria.chordFilter = "%";
+    CHECK(db.search(criteria).empty());
+    criteria.chordFilter = "x' OR 1=1 OR '";
+    CHECK(db.search(criteria).empty());
+
+    // Streamed files stop at the deepest level streaming reaches and are not
+    // streamed again on later passes
+    std::string bigPath = writeTestFile("levels_streamed.mid", data);
+    scanner.setStreamingThreshold(1);
+    CHECK(scanner.scanFile(bigPath));
+    int streamed = 0;
+    auto countStreamed = [&](int, int, const std::string&) { ++streamed; };
+    CHECK(scanner.analyzeUpgrades(AnalysisLevel::Full, countStreamed));
+    CHECK(streamed == 1);
+    CHECK(db.getFile(bigPath).analysisLevel == AnalysisLevel::KeyAndAlternatives);
+    CHECK(scanner.analyzeUpgrades(AnalysisLevel::Full, countStreamed));
+    CHECK(streamed == 1);
+    CHECK(scanner.upgradeFile(bigPath, AnalysisLevel::Full));
+    std::filesystem::remove(bigPath);
+    std::filesystem::remove(path);
+
+    std::cout << "  ✓ Scanner queues upgrades and stores the level" << std::endl;
+
+    // Rows from before levels existed were analysed in full
+    std::string dbPath = writeTestFile("levels_legacy.db", {});
+    std::filesystem::remove(dbPath);
+    sqlite3* legacy = nullptr;
+    CHECK(sqlite3_open(dbPath.c_str(), &legacy) == SQLITE_OK);
+    CHECK(sqlite3_exec(legacy,
+        "CREATE TABLE midi_files (id INTEGER PRIMARY KEY AUTOINCREMENT, file_path TEXT UNIQUE NOT NULL, "
+        "file_name TEXT NOT NULL, file_size INTEGER, last_modified INTEGER, detected_key TEXT, "
+        "detected_scale TEXT, confidence REAL, tempo REAL, duration REAL, total_notes INTEGER, "
+        "average_pitch REAL, chord_progression TEXT, date_added INTEGER, date_analyzed INTEGER, "
+        "content_hash INTEGER DEFAULT 0);"
+        "INSERT INTO midi_files (file_path, file_name, date_analyzed) VALUES ('/old.mid', 'old.mid', 1)",
+        nullptr, nullptr, nullptr) == SQLITE_OK);
+    sqlite3_close(legacy);
+
+    Database migrated;
+    CHECK(migrated.initialize(dbPath));
+    CHECK(migrated.getFile("/old.mid").analysisLevel == AnalysisLevel::Full);
+    CHECK(migrated.getFilesBelowLevel(AnalysisLevel::Full).empty());
+    migrated.close();
+    std::filesystem::remove(dbPath);
+
+    std::cout << "  ✓ Existing rows migrated as Full" << std::endl;
+}
+
+void testStreamingKeyDetector() {
+    std::cout << "Testing Streaming Key Detector..." << std::endl;
+
+    StreamingKeyDetector live;
+    live.setHalfLife(2.0);
+    const int cMajor[] = {60, 62, 64, 65, 67, 69, 71, 72};
+    const int ebMajor[] = {63, 65, 67, 68, 70, 72, 74, 75};
+
+    // Nothing is published until enough weight has built up
+    double time = 0.0;
+    for (int i = 0; i < 3; ++i, time += 0.25) {
+        live.noteOn(cMajor[i], 127, time);
+    }
+    live.update();
+    CHECK(!live.hasKey() && live.getKey().type == ScaleType::Unknown);
+
+    for (int i = 3; i < 32; ++i, time += 0.25) {
+        live.noteOn(cMajor[i % 8], 100, time);
+        live.update();
+    }
+    CHECK(live.hasKey());
+    Scale key = live.getKey();
+    CHECK(key.root == NoteName::C && key.type == ScaleType::Ionian);
+    CHECK(key.confidence > 0.5 && key.confidence <= 1.0);
+
+    std::cout << "  ✓ Key from live notes" << std::endl;
+
+    // Old notes fade: after a few half-lives of Eb major the key follows
+    for (int i = 0; i < 48; ++i, time += 0.25) {
+        live.noteOn(ebMajor[i % 8], 100, time);
+        live.update();
+    }
+    key = live.getKey();
+    CHECK(key.root == NoteName::Eb && key.type == ScaleType::Ionian);
+    const auto& histogram = live.getHistogram();
+    CHECK(histogram[1] < 0.1 * histogram[3]);  // Db never played; E and B faded
+    CHECK(histogram[4] < 0.1 * histogram[3] && histogram[11] < 0.1 * histogram[3]);
+
+    std::cout << "  ✓ Estimate follows a change of key" << std::endl;
+
+    // A brief chromatic flourish doesn't flip the published key
+    live.noteOn(64, 100, time);
+    live.noteOn(66, 100, time + 0.05);
+    live.update();
+    CHECK(live.getKey().root == NoteName::Eb);
+
+    // Steady state: no allocation per note or per update
+    size_t before = allocationCount.load();
+    for (int i = 0; i < 1000; ++i) {
+        time += 0.01;
+        live.noteOn(cMajor[i % 8], 90, time);
+        live.update();
+    }
+    CHECK(allocationCount.load() == before);
+
+    live.reset();
+    CHECK(!live.hasKey());
+    for (double weight : live.getHistogram()) {
+        CHECK(weight == 0.0);
+    }
+
+    std::cout << "  ✓ Lock- and allocation-free updates" << std::endl;
+}
+
+void testFileSummary() {
+    std::cout << "Testing File Summary..." << std::endl;
+
+    // Scale relationships and moods
+    CHECK(parentMajorKey(Scale(NoteName::C, ScaleType::Ionian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::D, ScaleType::Dorian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::E, ScaleType::Phrygian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::G, ScaleType::Mixolydian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::A, ScaleType::Aeolian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::B, ScaleType::Locrian, 1.0)) == NoteName::C);
+    CHECK(parentMajorKey(Scale(NoteName::E, ScaleType::MinorPentatonic, 1.0)) == NoteName::G);
+    CHECK(parentMajorKey(Scale(NoteName::D, ScaleType::HungarianMinor, 1.0)) == NoteName::D);
+
+    CHECK(classifyMood(Scale(NoteName::C, ScaleType::Ionian, 1.0), 130.0) == Mood::Joyful);
+    CHECK(classifyMood(Scale(NoteName::C, ScaleType::MajorPentatonic, 1.0), 60.0) == Mood::Peaceful);
+    CHECK(classifyMood(Scale(NoteName::A, ScaleType::HarmonicMinor, 1.0), 100.0) == Mood::Emotional);
+    CHECK(classifyMood(Scale(NoteName::D, ScaleType::Dorian, 1.0), 130.0) == Mood::Funky);
+    CHECK(classifyMood(Scale(NoteName::D, ScaleType::Dorian, 1.0), 90.0) == Mood::Soulful);
+    CHECK(classifyMood(Scale(NoteName::A, ScaleType::Blues, 1.0), 70.0) == Mood::Sorrowful);
+    CHECK(classifyMood(Scale(NoteName::F, ScaleType::Lydian, 1.0), 100.0) == Mood::Dreamy);
+    CHECK(classifyMood(Scale(NoteName::E, ScaleType::Phrygian, 1.0), 100.0) == Mood::Exotic);
+    CHECK(classifyMood(Scale(NoteName::C, ScaleType::EgyptianPentatonic, 1.0), 100.0) == Mood::Ethereal);
+    CHECK(classifyMood(Scale(), 100.0) == Mood::Mysterious);
+    CHECK(std::string(moodName(Mood::Melancholic)) == "Melancholic");
+
+    std::cout << "  ✓ Parent keys and moods follow the scale" << std::endl;
+
+    // Block chords at 100 BPM; the earliest program change is on the
+    // second track
+    TestTrack chords;
+    chords.tempo(0, 600000);
+    chords.event(960, {0xC0, 40});
+    uint32_t gap = 0;
+    for (int repeat = 0; repeat < 2; ++repeat) {
+        for (auto triad : {std::array<uint8_t, 3>{60, 64, 67}, std::array<uint8_t, 3>{65, 69, 72},
+                           std::array<uint8_t, 3>{67, 71, 74}, std::array<uint8_t, 3>{60, 64, 67}}) {
+            chords.event(gap, {0x90, triad[0], 100}).event(0, {0x90, triad[1], 100}).event(0, {0x90, triad[2], 100});
+            chords.event(960, {0x80, triad[0], 0}).event(0, {0x80, triad[1], 0}).event(0, {0x80, triad[2], 0});
+            gap = 0;
+        }
+    }
+    TestTrack strings;
+    strings.event(0, {0xC1, 48});
+    auto chordData = buildTestMIDI(1, 480, {chords, strings});
+
+    // An A minor melody at 70 BPM, doubled in unison on a second track
+    TestTrack melody;
+    TestTrack unison;
+    melody.tempo(0, 857143);
+    for (int repeat = 0; repeat < 3; ++repeat) {
+        for (uint8_t pitch : {57, 60, 64, 69, 67, 65, 64, 62, 60, 59, 57, 64}) {
+            melody.note(0, pitch, 240);
+            unison.note(0, pitch, 240);
+        }
+    }
+    auto melodyData = buildTestMIDI(1, 480, {melody, unison});
+
+    MIDIParser parser;
+    parser.setParseOptions(ParseNotesAndPrograms);
+    parser.setBuildNoteTable(true);
+    MIDIFile chordFile;
+    MIDIFile melodyFile;
+    CHECK(parser.parse(chordData.data(), chordData.size(), chordFile));
+    CHECK(parser.parse(melodyData.data(), melodyData.size(), melodyFile));
+
+    ScaleDetector detector;
+    detector.setAnalysisLevel(AnalysisLevel::KeyOnly);
+    AnalysisContext context;
+    FileSummary summary;
+
+    detector.summarize(chordFile, chordFile.getDuration(), context, summary);
+    CHECK(summary.analysis.primaryScale.root == NoteName::C);
+    CHECK(summary.analysis.primaryScale.type == ScaleType::Ionian);
+    CHECK(summary.parentMajor == NoteName::C && summary.relativeMinor == NoteName::A);
+    CHECK(summary.containsChords && !summary.containsSingleNotes);
+    CHECK(summary.program == 48);
+    CHECK(std::abs(summary.tempo - 100.0) < 0.01);
+    CHECK(std::abs(summary.duration - 10.8) < 0.01);
+    CHECK(summary.mood == Mood::Happy);
+
+    detector.summarize(melodyFile, melodyFile.getDuration(), context, summary);
+    CHECK(summary.analysis.primaryScale.root == NoteName::A);
+    CHECK(summary.parentMajor == NoteName::C && summary.relativeMinor == NoteName::A);
+    CHECK(!summary.containsChords && summary.containsSingleNotes);
+    CHECK(summary.program == -1);
+    CHECK(summary.mood == Mood::Melancholic);
+
+    std::cout << "  ✓ Key, texture, program, tempo and mood from one call" << std::endl;
+
+    // A file rebuilt from its note cache entry summarizes the same
+    NoteCacheEntry entry;
+    entry.assign(chordFile, 0, static_cast<int64_t>(chordData.size()));
+    MIDIFile restored;
+    entry.restore(restored);
+    FileSummary expected;
+    FileSummary cached;
+    detector.summarize(chordFile, chordFile.getDuration(), context, expected);
+    detector.summarize(restored, entry.duration, context, cached);
+    CHECK(cached.analysis.primaryScale.root == expected.analysis.primaryScale.root);
+    CHECK(cached.analysis.primaryScale.type == expected.analysis.primaryScale.type);
+    CHECK(cached.analysis.noteWeights == expected.analysis.noteWeights);
+    CHECK(cached.parentMajor == expected.parentMajor);
+    CHECK(cached.containsChords == expected.containsChords);
+    CHECK(cached.containsSingleNotes == expected.containsSingleNotes);
+    CHECK(cached.program == expected.program);
+    CHECK(cached.tempo == expected.tempo && cached.duration == expected.duration);
+    CHECK(cached.mood == expected.mood);
+
+    std::cout << "  ✓ Cached and parsed files give the same summary" << std::endl;
+
+    // A stored analysis deep enough for the detector is used as is
+    HarmonicAnalysis stored = expected.analysis;
+    stored.primaryScale = Scale(NoteName::D, ScaleType::Dorian, 0.9);
+    detector.summarize(restored, entry.duration, stored, context, cached);
+    CHECK(cached.analysis.primaryScale.type == ScaleType::Dorian);
+    CHECK(cached.parentMajor == NoteName::C && cached.mood == Mood::Soulful);
+    CHECK(cached.containsChords && cached.program == 48);
+
+    detector.setAnalysisLevel(AnalysisLevel::Full);
+    detector.summarize(restored, entry.duration, stored, context, cached);
+    CHECK(cached.analysis.primaryScale.type == expected.analysis.primaryScale.type);
+    CHECK(cached.analysis.level == AnalysisLevel::Full);
+    detector.setAnalysisLevel(AnalysisLevel::KeyOnly);
+
+    // Releasing the source drops the views into it and keeps the notes
+    MIDIFile mapped;
+    std::string mappedPath = writeTestFile("summary_release.mid", chordData);
+    CHECK(parser.parse(mappedPath, mapped));
+    mapped.releaseSource();
+    CHECK(!mapped.source);
+    for (const auto& track : mapped.tracks) {
+        CHECK(track.name.empty() && track.metaEvents.empty());
+    }
+    detector.summarize(mapped, entry.duration, context, cached);
+    CHECK(cached.program == expected.program && cached.mood == expected.mood);
+    std::filesystem::remove(mappedPath);
+
+    std::cout << "  ✓ Stored analyses reused, released sources leave no views" << std::endl;
+
+    size_t before = allocationCount.load();
+    detector.summarize(chordFile, chordFile.getDuration(), context, summary);
+    detector.summarize(melodyFile, melodyFile.getDuration(), context, summary);
+    CHECK(allocationCount.load() == before);
+
+    std::cout << "  ✓ Repeat summaries make no heap allocations" << std::endl;
+}
+
 void testDatabase() {
     std::cout << "Testing Database..." << std::endl;
 
@@ -77,7 +2027,7 @@ void testDatabase() {
 
     // Test database initialization
     bool initialized = db.initialize(":memory:"); // Use in-memory database for testing
-    assert(initialized);
+    CHECK(initialized);
 
     std::cout << "  ✓ Database initialized" << std::endl;
 
@@ -95,13 +2045,13 @@ void testDatabase() {
     entry.dateAnalyzed = 1234567890;
 
     bool added = db.addFile(entry);
-    assert(added);
+    CHECK(added);
 
     std::cout << "  ✓ File entry added" << std::endl;
 
     // Test retrieval
     bool exists = db.fileExists("/test/file.mid");
-    assert(exists);
+    CHECK(exists);
 
     std::cout << "  ✓ File retrieval works" << std::endl;
 
@@ -109,13 +2059,123 @@ void testDatabase() {
     SearchCriteria criteria;
     criteria.keyFilter = "C";
     auto results = db.search(criteria);
-    assert(results.size() > 0);
+    CHECK(results.size() > 0);
 
     std::cout << "  ✓ Search functionality works" << std::endl;
 
     db.close();
 }
 
+void testNoteCache() {
+    std::cout << "Testing Note Cache..." << std::endl;
+
+    TestTrack conductor;
+    conductor.tempo(0, 500000).tempo(960, 400000)
+             .event(0, {0xFF, 0x58, 0x04, 0x06, 0x03, 0x18, 0x08})
+             .event(0, {0xFF, 0x59, 0x02, 0x02, 0x00});
+    TestTrack melody;
+    melody.event(0, {0xC0, 0x30}).event(0, {0xB0, 0x40, 0x7F});
+    const uint8_t dMajor[] = {62, 64, 66, 67, 69, 71, 73, 74};
+    for (int i = 0; i < 64; ++i) {
+        melody.note(i == 0 ? 0 : 20, dMajor[i % 8], 220, static_cast<uint8_t>(60 + i));
+    }
+    melody.event(0, {0xB0, 0x40, 0x00});
+    auto data = buildTestMIDI(1, 480, {conductor, melody});
+    std::string sourcePath = writeTestFile("note_cache_source.mid", data);
+
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+    MIDIFile midiFile;
+    CHECK(parser.parse(sourcePath, midiFile));
+
+    NoteCacheEntry entry;
+    entry.assign(midiFile, 1700000000, static_cast<int64_t>(data.size()));
+    CHECK(entry.controlEvents.size() == 3);
+
+    auto cacheDir = (std::filesystem::temp_directory_path() / "midixplorer_notecache").string();
+    std::filesystem::remove_all(cacheDir);
+    NoteCache cache;
+    CHECK(cache.setDirectory(cacheDir));
+    CHECK(cache.store(entry));
+
+    // A few bytes per note: well under the source file
+    auto entryPath = cache.getEntryPath(sourcePath);
+    CHECK(std::filesystem::file_size(entryPath) < data.size());
+
+    ScaleDetector detector;
+    entry.analysis = detector.analyze(midiFile);
+    entry.hasAnalysis = true;
+    CHECK(cache.store(entry));
+
+    NoteCacheEntry loaded;
+    CHECK(cache.load(sourcePath, 1700000000, loaded, midiFile.contentHash));
+    CHECK(loaded.filePath == sourcePath && loaded.fileSize == static_cast<int64_t>(data.size()));
+    CHECK(loaded.format == 1 && loaded.trackCount == 2);
+    CHECK(loaded.tempo == midiFile.tempo && loaded.duration == midiFile.getDuration());
+
+    const NoteTable& a = midiFile.notes;
+    const NoteTable& b = loaded.notes;
+    CHECK(a.size() == b.size() && b.size() == 64);
+    for (size_t i = 0; i < a.size(); ++i) {
+        CHECK(a.pitch[i] == b.pitch[i] && a.channel[i] == b.channel[i] && a.velocity[i] == b.velocity[i]);
+        CHECK(a.startTick[i] == b.startTick[i] && a.endTick[i] == b.endTick[i]);
+        CHECK(a.startTime[i] == b.startTime[i] && a.endTime[i] == b.endTime[i]);
+    }
+    CHECK(loaded.tempoMap.changes.size() == 2);
+    CHECK(loaded.tempoMap.ticksToSeconds(5000) == midiFile.tempoMap.ticksToSeconds(5000));
+    CHECK(loaded.keySignatures.size() == 1 && loaded.keySignatures[0].sharpsFlats == 2);
+    CHECK(loaded.timeSignatures.size() == 1 && loaded.timeSignatures[0].numerator == 6);
+    CHECK(loaded.controlEvents.size() == 3);
+    CHECK(loaded.controlEvents[0].type == EventType::ProgramChange && loaded.controlEvents[0].program() == 0x30);
+    CHECK(loaded.controlEvents[2].tick == midiFile.tracks[1].events.back().tick);
+
+    CHECK(loaded.hasAnalysis);
+    CHECK(loaded.analysis.primaryScale.getName() == entry.analysis.primaryScale.getName());
+    CHECK(loaded.analysis.primaryScale.confidence == entry.analysis.primaryScale.confidence);
+    CHECK(loaded.analysis.alternativeScales.size() == entry.analysis.alternativeScales.size());
+    CHECK(loaded.analysis.noteWeights == entry.analysis.noteWeights);
+    CHECK(loaded.analysis.noteDistribution == entry.analysis.noteDistribution);
+    CHECK(loaded.analysis.chordProgression == entry.analysis.chordProgression);
+    CHECK(loaded.analysis.chords.size() == entry.analysis.chords.size());
+    CHECK(loaded.analysis.totalNotes == 64);
+    CHECK(loaded.analysis.level == AnalysisLevel::Full);
+
+    std::cout << "  ✓ Entry round trip" << std::endl;
+
+    // Changed modification time or content means the entry no longer applies
+    CHECK(!cache.load(sourcePath, 1700000001, loaded));
+    CHECK(!cache.load(sourcePath, 1700000000, loaded, midiFile.contentHash + 1));
+    CHECK(!cache.load(sourcePath + ".other", 1700000000, loaded));
+
+    // Damaged sidecars are rejected, not half-loaded
+    std::vector<uint8_t> stored(std::filesystem::file_size(entryPath));
+    {
+        std::ifstream in(entryPath, std::ios::binary);
+        in.read(reinterpret_cast<char*>(stored.data()), static_cast<std::streamsize>(stored.size()));
+    }
+    auto corrupt = stored;
+    corrupt[corrupt.size() / 2] ^= 0x10;
+    std::ofstream(entryPath, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(corrupt.data()), static_cast<std::streamsize>(corrupt.size()));
+    CHECK(!cache.load(sourcePath, 1700000000, loaded));
+    std::ofstream(entryPath, std::ios::binary | std::ios::trunc)
+        .write(reinterpret_cast<const char*>(stored.data()), static_cast<std::streamsize>(stored.size() - 9));
+    CHECK(!cache.load(sourcePath, 1700000000, loaded));
+
+    // Entries without analysis, and clearing the directory
+    entry.hasAnalysis = false;
+    CHECK(cache.store(entry));
+    CHECK(cache.load(sourcePath, 1700000000, loaded) && !loaded.hasAnalysis);
+    cache.clear();
+    CHECK(!std::filesystem::exists(entryPath));
+    CHECK(!cache.load(sourcePath, 1700000000, loaded));
+
+    std::filesystem::remove_all(cacheDir);
+    std::filesystem::remove(sourcePath);
+
+    std::cout << "  ✓ Stale, corrupt and cleared entries" << std::endl;
+}
+
 int main() {
     std::cout << "========================================" << std::endl;
     std::cout << "MIDI Scale Detector - Unit Tests" << std::endl;
@@ -126,6 +2186,26 @@ int main() {
         testMIDIParser();
         std::cout << std::endl;
 
+        testMappedParse();
+        std::cout << std::endl;
+
+        testTempoMap();
+        std::cout << std::endl;
+
+        testNoteTable();
+        testProbe();
+        testParseOptions();
+        testParseBatch();
+        testMergedCursor();
+        testContentHash();
+        testMalformedInput();
+        testParallelDecode();
+        testMIDIWriter();
+        testDeclaredKey();
+        testStreamingParser();
+        testZipArchive();
+        std::cout << std::endl;
+
         testScaleDetector();
         std::cout << std::endl;
 
@@ -133,11 +2213,22 @@ int main() {
         std::cout << std::endl;
 
         testScale();
+        testScaleScoring();
+        testKeyChanges();
+        testKeySegmenter();
+        testChordDetector();
+        testAnalysisContext();
+        testAnalysisLevels();
+        testStreamingKeyDetector();
+        testFileSummary();
         std::cout << std::endl;
 
         testDatabase();
         std::cout << std::endl;
 
+        testNoteCache();
+        std::cout << std::endl;
+
         std::cout << "========================================" << std::endl;
         std::cout << "All tests passed! ✓" << std::endl;
         std::cout << "========================================" << std::endl;
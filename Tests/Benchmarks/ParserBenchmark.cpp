@@ -0,0 +1,184 @@
+// Parser throughput benchmark. Builds a synthetic multitrack file in memory
+// (or loads the files given on the command line) and reports MB/s for
+// parse(), probe() and MIDIWriter, so decoder changes can be measured.
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "../../Source/Core/MIDIParser/MIDIParser.h"
+#include "../../Source/Core/MIDIParser/MIDIWriter.h"
+
+using namespace MIDIScaleDetector;
+
+namespace {
+    void appendVariableLength(std::vector<uint8_t>& out, uint32_t value) {
+        uint8_t buffer[4];
+        int count = 0;
+        buffer[count++] = value & 0x7F;
+        while ((value >>= 7) > 0) {
+            buffer[count++] = 0x80 | (value & 0x7F);
+        }
+        while (count > 0) {
+            out.push_back(buffer[--count]);
+        }
+    }
+
+    void append32(std::vector<uint8_t>& out, uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8) {
+            out.push_back(static_cast<uint8_t>(value >> shift));
+        }
+    }
+
+    // Dense notes with running status, CCs and a tempo map on track 0
+    std::vector<uint8_t> buildSyntheticFile(int tracks, int notesPerTrack) {
+        std::vector<uint8_t> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1};
+        file.push_back(static_cast<uint8_t>(tracks >> 8));
+        file.push_back(static_cast<uint8_t>(tracks));
+        file.push_back(0x01);
+        file.push_back(0xE0);  // 480 PPQ
+
+        uint32_t seed = 12345;
+        auto random = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return seed >> 16;
+        };
+
+        for (int t = 0; t < tracks; ++t) {
+            std::vector<uint8_t> track;
+            uint8_t channel = static_cast<uint8_t>(t & 0x0F);
+
+            if (t == 0) {
+                for (int i = 0; i < 64; ++i) {
+                    appendVariableLength(track, 1920);
+                    track.insert(track.end(), {0xFF, 0x51, 0x03, 0x07, 0xA1, static_cast<uint8_t>(random())});
+                }
+            }
+
+            track.push_back(0x00);
+            track.insert(track.end(), {0xFF, 0x03, 0x05, 'T', 'r', 'a', 'c', 'k'});
+            track.push_back(0x00);
+            track.insert(track.end(), {static_cast<uint8_t>(0xC0 | channel), static_cast<uint8_t>(random() & 0x7F)});
+
+            for (int i = 0; i < notesPerTrack; ++i) {
+                uint8_t note = static_cast<uint8_t>(36 + random() % 48);
+                appendVariableLength(track, random() % 240);
+                track.insert(track.end(), {static_cast<uint8_t>(0x90 | channel), note, 100});
+                appendVariableLength(track, 60 + random() % 400);
+                track.insert(track.end(), {note, 0});  // Running status note-off
+                if (i % 16 == 0) {
+                    appendVariableLength(track, 0);
+                    track.insert(track.end(), {static_cast<uint8_t>(0xB0 | channel), 1, static_cast<uint8_t>(random() & 0x7F)});
+                }
+            }
+
+            track.insert(track.end(), {0x00, 0xFF, 0x2F, 0x00});
+
+            file.insert(file.end(), {'M', 'T', 'r', 'k'});
+            append32(file, static_cast<uint32_t>(track.size()));
+            file.insert(file.end(), track.begin(), track.end());
+        }
+
+        return file;
+    }
+
+    // Best of several rounds, to keep scheduler noise out of comparisons
+    template <typename Body>
+    double measureMBps(size_t bytesPerRun, int runs, Body body) {
+        double best = 0.0;
+        for (int round = 0; round < 5; ++round) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < runs; ++i) {
+                body();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            best = std::max(best, (static_cast<double>(bytesPerRun) * runs) / (1024.0 * 1024.0) / elapsed.count());
+        }
+        return best;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::vector<uint8_t>> inputs;
+
+    for (int i = 1; i < argc; ++i) {
+        std::ifstream stream(argv[i], std::ios::binary);
+        inputs.emplace_back(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+    if (inputs.empty()) {
+        inputs.push_back(buildSyntheticFile(16, 20000));
+    }
+
+    size_t totalBytes = 0;
+    for (const auto& input : inputs) {
+        totalBytes += input.size();
+    }
+
+    MIDIParser parser;
+    MIDIFile midiFile;
+    MIDIProbe probe;
+    const int runs = 10;
+
+    // Warm up once and make sure the inputs are valid
+    for (const auto& input : inputs) {
+        if (!parser.parse(input.data(), input.size(), midiFile)) {
+            std::cerr << "Parse failed: " << parser.getLastError() << std::endl;
+            return 1;
+        }
+    }
+
+    // Serial and multi-threaded track decoding, same options
+    parser.setParallelThreshold(SIZE_MAX);
+    double parseRate = measureMBps(totalBytes, runs, [&]() {
+        for (const auto& input : inputs) {
+            parser.parse(input.data(), input.size(), midiFile);
+        }
+    });
+
+    parser.setParallelThreshold(0);
+    double parallelRate = measureMBps(totalBytes, runs, [&]() {
+        for (const auto& input : inputs) {
+            parser.parse(input.data(), input.size(), midiFile);
+        }
+    });
+    parser.setParallelThreshold(MIDIParser::kDefaultParallelThreshold);
+
+    // Re-serialize parsed files; the output buffer is reused across writes
+    std::vector<MIDIFile> parsed(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        parser.parse(inputs[i].data(), inputs[i].size(), parsed[i]);
+    }
+    MIDIWriter writer;
+    std::vector<uint8_t> output;
+    double writeRate = measureMBps(totalBytes, runs, [&]() {
+        for (const auto& file : parsed) {
+            writer.write(file, 1, output);
+        }
+    });
+
+    parser.setParseOptions(ParseNotesOnly);
+    parser.setBuildNoteTable(true);
+    double notesRate = measureMBps(totalBytes, runs, [&]() {
+        for (const auto& input : inputs) {
+            parser.parse(input.data(), input.size(), midiFile);
+        }
+    });
+
+    double probeRate = measureMBps(totalBytes, runs, [&]() {
+        for (const auto& input : inputs) {
+            parser.probe(input.data(), input.size(), probe);
+        }
+    });
+
+    std::cout << "Input: " << inputs.size() << " file(s), " << totalBytes / 1024 << " KB" << std::endl;
+    std::cout << "parse (everything):        " << parseRate << " MB/s" << std::endl;
+    std::cout << "parse (parallel tracks):   " << parallelRate << " MB/s" << std::endl;
+    std::cout << "parse (notes + note table): " << notesRate << " MB/s" << std::endl;
+    std::cout << "write (format 1):          " << writeRate << " MB/s" << std::endl;
+    std::cout << "probe:                     " << probeRate << " MB/s" << std::endl;
+
+    return 0;
+}
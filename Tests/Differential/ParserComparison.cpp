@@ -0,0 +1,265 @@
+// Differential test: parses the same files with the Core MIDIParser and with
+// juce::MidiFile and checks that every note-on and note-off lands at the same
+// time in both. Runs over a built-in set of edge-case files, plus any .mid
+// files or directories given on the command line.
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <initializer_list>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <juce_audio_basics/juce_audio_basics.h>
+#include "../../Source/Core/MIDIParser/MIDIParser.h"
+
+using namespace MIDIScaleDetector;
+
+namespace {
+    struct NoteEdge {
+        double time;
+        int channel;        // 0-15
+        int pitch;
+        bool on;
+    };
+
+    bool operator<(const NoteEdge& a, const NoteEdge& b) {
+        return std::tie(a.time, a.channel, a.pitch, a.on) < std::tie(b.time, b.channel, b.pitch, b.on);
+    }
+
+    // Seconds agree to well under a sample at any sane length
+    bool sameTime(double a, double b) {
+        return std::abs(a - b) <= 1e-6 + 1e-9 * std::abs(b);
+    }
+
+    struct TrackBuilder {
+        std::vector<uint8_t> bytes;
+
+        TrackBuilder& event(uint32_t delta, std::initializer_list<uint8_t> data) {
+            uint8_t buffer[4];
+            int count = 0;
+            buffer[count++] = delta & 0x7F;
+            while ((delta >>= 7) > 0) {
+                buffer[count++] = 0x80 | (delta & 0x7F);
+            }
+            while (count > 0) {
+                bytes.push_back(buffer[--count]);
+            }
+            bytes.insert(bytes.end(), data.begin(), data.end());
+            return *this;
+        }
+
+        TrackBuilder& tempo(uint32_t delta, uint32_t microsecondsPerQuarter) {
+            return event(delta, {0xFF, 0x51, 0x03,
+                                 static_cast<uint8_t>(microsecondsPerQuarter >> 16),
+                                 static_cast<uint8_t>(microsecondsPerQuarter >> 8),
+                                 static_cast<uint8_t>(microsecondsPerQuarter)});
+        }
+    };
+
+    std::vector<uint8_t> buildFile(uint16_t format, uint16_t division, std::vector<TrackBuilder> tracks) {
+        std::vector<uint8_t> file = {'M', 'T', 'h', 'd', 0, 0, 0, 6,
+                                     0, static_cast<uint8_t>(format),
+                                     static_cast<uint8_t>(tracks.size() >> 8), static_cast<uint8_t>(tracks.size()),
+                                     static_cast<uint8_t>(division >> 8), static_cast<uint8_t>(division)};
+        for (auto& track : tracks) {
+            track.event(0, {0xFF, 0x2F, 0x00});
+            uint32_t length = static_cast<uint32_t>(track.bytes.size());
+            file.insert(file.end(), {'M', 'T', 'r', 'k',
+                                     static_cast<uint8_t>(length >> 24), static_cast<uint8_t>(length >> 16),
+                                     static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(length)});
+            file.insert(file.end(), track.bytes.begin(), track.bytes.end());
+        }
+        return file;
+    }
+
+    // Cases where the two parsers could plausibly disagree
+    std::vector<std::pair<std::string, std::vector<uint8_t>>> builtInCorpus() {
+        std::vector<std::pair<std::string, std::vector<uint8_t>>> corpus;
+
+        // Tempo changes split across tracks, running status, velocity-0 note-offs
+        {
+            TrackBuilder conductor;
+            conductor.tempo(0, 500000).tempo(960, 350000).tempo(1920, 750000);
+            TrackBuilder melody;
+            melody.event(0, {0xC0, 0x05});
+            for (int i = 0; i < 64; ++i) {
+                uint8_t pitch = static_cast<uint8_t>(60 + (i * 5) % 24);
+                melody.event(i == 0 ? 0 : 30, {0x90, pitch, 100}).event(210, {pitch, 0});
+            }
+            TrackBuilder late;
+            late.tempo(2400, 400000);
+            for (int i = 0; i < 32; ++i) {
+                late.event(120, {0x91, 40, 90}).event(360, {0x81, 40, 0});
+            }
+            corpus.emplace_back("multitrack tempo map", buildFile(1, 480, {conductor, melody, late}));
+        }
+
+        // Format 0 with SysEx, controllers and pitch bend between notes
+        {
+            TrackBuilder track;
+            track.tempo(0, 600000).event(0, {0xF0, 0x05, 0x7E, 0x7F, 0x09, 0x01, 0xF7});
+            for (int i = 0; i < 48; ++i) {
+                uint8_t channel = static_cast<uint8_t>(i % 3);
+                track.event(96, {static_cast<uint8_t>(0xB0 | channel), 7, 100})
+                     .event(0, {static_cast<uint8_t>(0xE0 | channel), 0x00, 0x40})
+                     .event(0, {static_cast<uint8_t>(0x90 | channel), static_cast<uint8_t>(48 + i), 80})
+                     .event(192, {static_cast<uint8_t>(0x80 | channel), static_cast<uint8_t>(48 + i), 64});
+            }
+            corpus.emplace_back("format 0 mixed events", buildFile(0, 96, {track}));
+        }
+
+        // SMPTE timing: 25 fps, 40 ticks per frame (millisecond resolution)
+        {
+            TrackBuilder track;
+            track.tempo(0, 300000);   // Ignored under SMPTE
+            for (int i = 0; i < 40; ++i) {
+                track.event(250, {0x90, 64, 100}).event(125, {0x80, 64, 0});
+            }
+            corpus.emplace_back("SMPTE division", buildFile(0, 0xE728, {track}));
+        }
+
+        // Overlapping same-pitch notes and a note that is never released
+        {
+            TrackBuilder track;
+            track.event(0, {0x90, 60, 100}).event(100, {0x90, 60, 90})
+                 .event(100, {0x80, 60, 0}).event(100, {0x80, 60, 0})
+                 .event(0, {0x90, 72, 100});
+            corpus.emplace_back("overlaps and hanging notes", buildFile(1, 480, {track}));
+        }
+
+        return corpus;
+    }
+
+    void collectFiles(const juce::File& location, std::vector<juce::File>& files) {
+        if (location.isDirectory()) {
+            for (const auto& entry : juce::RangedDirectoryIterator(location, true, "*.mid;*.midi")) {
+                files.push_back(entry.getFile());
+            }
+        } else if (location.existsAsFile()) {
+            files.push_back(location);
+        }
+    }
+
+    // Core side: ticks converted through the shared tempo map in double precision
+    bool coreEdges(const std::vector<uint8_t>& data, std::vector<std::vector<NoteEdge>>& tracks) {
+        MIDIParser parser;
+        parser.setParseOptions(ParseNotes);
+        MIDIFile midiFile;
+        if (!parser.parse(data.data(), data.size(), midiFile)) {
+            return false;
+        }
+
+        tracks.clear();
+        for (const auto& track : midiFile.tracks) {
+            std::vector<NoteEdge> edges;
+            for (const auto& event : track.events) {
+                edges.push_back({midiFile.tempoMap.ticksToSeconds(event.tick), event.channel,
+                                 event.note, event.type == EventType::NoteOn});
+            }
+            std::sort(edges.begin(), edges.end());
+            tracks.push_back(std::move(edges));
+        }
+        return true;
+    }
+
+    // JUCE side: raw events only, no synthesised note-offs for hanging notes
+    bool juceEdges(const std::vector<uint8_t>& data, std::vector<std::vector<NoteEdge>>& tracks) {
+        juce::MemoryInputStream stream(data.data(), data.size(), false);
+        juce::MidiFile midiFile;
+        if (!midiFile.readFrom(stream, false)) {
+            return false;
+        }
+        midiFile.convertTimestampTicksToSeconds();
+
+        tracks.clear();
+        for (int t = 0; t < midiFile.getNumTracks(); ++t) {
+            std::vector<NoteEdge> edges;
+            const auto* sequence = midiFile.getTrack(t);
+            for (int i = 0; i < sequence->getNumEvents(); ++i) {
+                const auto& message = sequence->getEventPointer(i)->message;
+                if (message.isNoteOn() || message.isNoteOff()) {
+                    edges.push_back({message.getTimeStamp(), message.getChannel() - 1,
+                                     message.getNoteNumber(), message.isNoteOn()});
+                }
+            }
+            std::sort(edges.begin(), edges.end());
+            tracks.push_back(std::move(edges));
+        }
+        return true;
+    }
+
+    // Empty string when the two parses agree
+    std::string compare(const std::vector<uint8_t>& data, bool& skipped) {
+        std::vector<std::vector<NoteEdge>> core, reference;
+        bool coreParsed = coreEdges(data, core);
+        bool juceParsed = juceEdges(data, reference);
+
+        skipped = !coreParsed && !juceParsed;
+        if (coreParsed != juceParsed) {
+            // Malformed files are rejected differently; not a timing disagreement
+            skipped = true;
+            return std::string("only ") + (coreParsed ? "Core" : "JUCE") + " parsed the file";
+        }
+        if (skipped) {
+            return {};
+        }
+
+        if (core.size() != reference.size()) {
+            return "track count " + std::to_string(core.size()) + " vs " + std::to_string(reference.size());
+        }
+        for (size_t t = 0; t < core.size(); ++t) {
+            if (core[t].size() != reference[t].size()) {
+                return "track " + std::to_string(t) + ": " + std::to_string(core[t].size()) +
+                       " note events vs " + std::to_string(reference[t].size());
+            }
+            for (size_t i = 0; i < core[t].size(); ++i) {
+                const NoteEdge& a = core[t][i];
+                const NoteEdge& b = reference[t][i];
+                if (a.channel != b.channel || a.pitch != b.pitch || a.on != b.on || !sameTime(a.time, b.time)) {
+                    return "track " + std::to_string(t) + " event " + std::to_string(i) + ": pitch " +
+                           std::to_string(a.pitch) + " at " + std::to_string(a.time) + "s vs pitch " +
+                           std::to_string(b.pitch) + " at " + std::to_string(b.time) + "s";
+                }
+            }
+        }
+        return {};
+    }
+}
+
+int main(int argc, char* argv[]) {
+    auto corpus = builtInCorpus();
+
+    std::vector<juce::File> files;
+    for (int i = 1; i < argc; ++i) {
+        collectFiles(juce::File::getCurrentWorkingDirectory().getChildFile(argv[i]), files);
+    }
+    for (const auto& file : files) {
+        juce::MemoryBlock block;
+        if (file.loadFileAsData(block)) {
+            auto* bytes = static_cast<const uint8_t*>(block.getData());
+            corpus.emplace_back(file.getFullPathName().toStdString(),
+                                std::vector<uint8_t>(bytes, bytes + block.getSize()));
+        }
+    }
+
+    int failures = 0;
+    int skippedCount = 0;
+    for (const auto& [name, data] : corpus) {
+        bool skipped = false;
+        std::string mismatch = compare(data, skipped);
+        if (skipped) {
+            ++skippedCount;
+            if (!mismatch.empty()) {
+                std::cout << "  - " << name << ": " << mismatch << std::endl;
+            }
+        } else if (!mismatch.empty()) {
+            ++failures;
+            std::cout << "  ✗ " << name << ": " << mismatch << std::endl;
+        }
+    }
+
+    std::cout << corpus.size() << " file(s), " << failures << " mismatch(es), "
+              << skippedCount << " skipped" << std::endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+// libFuzzer entry point for the MIDI parser. Every input must either parse
+// or be rejected with an error - never read outside the buffer.
+#include <cstdint>
+#include <cstddef>
+#include "../../Source/Core/MIDIParser/MIDIParser.h"
+#include "../../Source/Core/MIDIParser/MergedEventCursor.h"
+
+using namespace MIDIScaleDetector;
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    MIDIParser parser;
+    parser.setBuildNoteTable(true);
+
+    MIDIFile midiFile;
+    if (parser.parse(data, size, midiFile)) {
+        // Touch everything the parse produced
+        for (MergedEventCursor cursor(midiFile); !cursor.atEnd(); cursor.next()) {
+            (void)cursor.current();
+        }
+        for (const auto& track : midiFile.tracks) {
+            for (const auto& meta : track.metaEvents) {
+                for (char c : meta.data) {
+                    (void)c;
+                }
+            }
+        }
+        (void)midiFile.getDuration();
+    }
+
+    MIDIProbe probe;
+    parser.probe(data, size, probe);
+
+    return 0;
+}